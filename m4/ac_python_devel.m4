@@ -10,14 +10,14 @@ dnl $(PYTHON_EXTRA_LIBS) and $(PYTHON_EXTRA_LDFLAGS) for embedding
 dnl Python in your code.
 dnl
 dnl You can search for some particular version of Python by passing a
-dnl parameter to this macro, for example ">= '2.3.1'", or "== '2.4'".
+dnl parameter to this macro, for example ">= '3.8'", or "== '3.10'".
 dnl Please note that you *have* to pass also an operator along with the
 dnl version to match, and pay special attention to the single quotes
 dnl surrounding the version number. Don't use "PYTHON_VERSION" for
 dnl this: that environment variable is declared as precious and thus
 dnl reserved for the end-user.
 dnl
-dnl This macro should work for all versions of Python >= 2.1.0. As an
+dnl This macro should work for all versions of Python >= 3.2. As an
 dnl end user, you can disable the check for the python version by
 dnl setting the PYTHON_NOVERSIONCHECK environment variable to something
 dnl else than the empty string.
@@ -51,19 +51,18 @@ AC_DEFUN([AC_PYTHON_DEVEL],[
 	fi
 
 	#
-	# Check for a version of Python >= 2.1.0
+	# Check for a version of Python >= 3.2
 	#
-	AC_MSG_CHECKING([for a version of Python >= '2.1.0'])
-	ac_supports_python_ver=`$PYTHON -c "import sys, string; \
-		ver = string.split(sys.version)[[0]]; \
-		print ver >= '2.1.0'"`
+	AC_MSG_CHECKING([for a version of Python >= '3.2'])
+	ac_supports_python_ver=`$PYTHON -c "import sys; \
+		print(sys.version_info >= (3, 2))" 2>/dev/null`
 	if test "$ac_supports_python_ver" != "True"; then
 		if test -z "$PYTHON_NOVERSIONCHECK"; then
 			AC_MSG_RESULT([no])
 			AC_MSG_FAILURE([
 This version of the AC@&t@_PYTHON_DEVEL macro
 doesn't work properly with versions of Python before
-2.1.0. You may need to re-run configure, setting the
+3.2. You may need to re-run configure, setting the
 variables PYTHON_CPPFLAGS, PYTHON_LDFLAGS, PYTHON_SITE_PKG,
 PYTHON_EXTRA_LIBS and PYTHON_EXTRA_LDFLAGS by hand.
 Moreover, to disable this check, set PYTHON_NOVERSIONCHECK
@@ -81,9 +80,12 @@ to something else than an empty string.
 	#
 	if test -n "$1"; then
 		AC_MSG_CHECKING([for a version of Python $1])
-		ac_supports_python_ver=`$PYTHON -c "import sys, string; \
-			ver = string.split(sys.version)[[0]]; \
-			print ver $1"`
+		ac_supports_python_ver=`$PYTHON -c "import operator, sys; \
+			op, req = \"$1\".split(); \
+			req = tuple(int(x) for x in req.strip(\"'\").split('.')); \
+			ops = {'<': operator.lt, '<=': operator.le, '==': operator.eq, \
+			       '!=': operator.ne, '>=': operator.ge, '>': operator.gt}; \
+			print(ops[[op]](sys.version_info[[:len(req)]], req))"`
 		if test "$ac_supports_python_ver" = "True"; then
 	   	   AC_MSG_RESULT([yes])
 		else
@@ -98,17 +100,17 @@ variable to configure. See ``configure --help'' for reference.
 	fi
 
 	#
-	# Check if you have distutils, else fail
+	# Check if you have sysconfig, else fail
 	#
-	AC_MSG_CHECKING([for the distutils Python package])
-	ac_distutils_result=`$PYTHON -c "import distutils" 2>&1`
-	if test -z "$ac_distutils_result"; then
+	AC_MSG_CHECKING([for the sysconfig Python package])
+	ac_sysconfig_result=`$PYTHON -c "import sysconfig" 2>&1`
+	if test -z "$ac_sysconfig_result"; then
 		AC_MSG_RESULT([yes])
 	else
 		AC_MSG_RESULT([no])
-		AC_MSG_ERROR([cannot import Python module "distutils".
+		AC_MSG_ERROR([cannot import Python module "sysconfig".
 Please check your Python installation. The error was:
-$ac_distutils_result])
+$ac_sysconfig_result])
 		PYTHON_VERSION=""
 	fi
 
@@ -117,8 +119,8 @@ $ac_distutils_result])
 	#
 	AC_MSG_CHECKING([for Python include path])
 	if test -z "$PYTHON_CPPFLAGS"; then
-		python_path=`$PYTHON -c "import distutils.sysconfig; \
-           		print distutils.sysconfig.get_python_inc();"`
+		python_path=`$PYTHON -c "import sysconfig; \
+           		print(sysconfig.get_paths()[['include']])"`
 		if test -n "${python_path}"; then
 		   	python_path="-I$python_path"
 		fi
@@ -134,22 +136,21 @@ $ac_distutils_result])
 	if test -z "$PYTHON_LDFLAGS"; then
 		# (makes two attempts to ensure we've got a version number
 		# from the interpreter)
-		py_version=`$PYTHON -c "from distutils.sysconfig import *; \
-			from string import join; \
-			print join(get_config_vars('VERSION'))"`
-		if test "$py_version" == "[None]"; then
+		py_version=`$PYTHON -c "import sysconfig; \
+			conf = sysconfig.get_config_var; \
+			print((conf('LDVERSION') or conf('VERSION') or ''))"`
+		if test -z "$py_version"; then
 			if test -n "$PYTHON_VERSION"; then
 				py_version=$PYTHON_VERSION
 			else
 				py_version=`$PYTHON -c "import sys; \
-					print sys.version[[:3]]"`
+					print('%d.%d' % sys.version_info[[:2]])"`
 			fi
 		fi
 
-		PYTHON_LDFLAGS=`$PYTHON -c "from distutils.sysconfig import *; \
-			from string import join; \
-			print '-L' + get_python_lib(0,1), \
-		      	'-lpython';"`$py_version
+		PYTHON_LDFLAGS=`$PYTHON -c "import sysconfig; \
+			print('-L' + sysconfig.get_config_var('LIBDIR'), \
+			      '-lpython', end='')"`$py_version
 	fi
 	AC_MSG_RESULT([$PYTHON_LDFLAGS])
 	AC_SUBST([PYTHON_LDFLAGS])
@@ -159,8 +160,8 @@ $ac_distutils_result])
 	#
 	AC_MSG_CHECKING([for Python site-packages path])
 	if test -z "$PYTHON_SITE_PKG"; then
-		PYTHON_SITE_PKG=`$PYTHON -c "import distutils.sysconfig; \
-		        print distutils.sysconfig.get_python_lib(0,0);"`
+		PYTHON_SITE_PKG=`$PYTHON -c "import sysconfig; \
+		        print(sysconfig.get_paths()[['purelib']])"`
 	fi
 	AC_MSG_RESULT([$PYTHON_SITE_PKG])
 	AC_SUBST([PYTHON_SITE_PKG])
@@ -170,9 +171,9 @@ $ac_distutils_result])
 	#
 	AC_MSG_CHECKING(python extra libraries)
 	if test -z "$PYTHON_EXTRA_LIBS"; then
-	   PYTHON_EXTRA_LIBS=`$PYTHON -c "import distutils.sysconfig; \
-                conf = distutils.sysconfig.get_config_var; \
-                print conf('LOCALMODLIBS'), conf('LIBS')"`
+	   PYTHON_EXTRA_LIBS=`$PYTHON -c "import sysconfig; \
+                conf = sysconfig.get_config_var; \
+                print(conf('LOCALMODLIBS'), conf('LIBS'))"`
 	fi
 	AC_MSG_RESULT([$PYTHON_EXTRA_LIBS])
 	AC_SUBST(PYTHON_EXTRA_LIBS)
@@ -182,9 +183,9 @@ $ac_distutils_result])
 	#
 	AC_MSG_CHECKING(python extra linking flags)
 	if test -z "$PYTHON_EXTRA_LDFLAGS"; then
-		PYTHON_EXTRA_LDFLAGS=`$PYTHON -c "import distutils.sysconfig; \
-			conf = distutils.sysconfig.get_config_var; \
-			print conf('LINKFORSHARED')"`
+		PYTHON_EXTRA_LDFLAGS=`$PYTHON -c "import sysconfig; \
+			conf = sysconfig.get_config_var; \
+			print(conf('LINKFORSHARED'))"`
 	fi
 	AC_MSG_RESULT([$PYTHON_EXTRA_LDFLAGS])
 	AC_SUBST(PYTHON_EXTRA_LDFLAGS)
@@ -0,0 +1,74 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Sorts the states of an FST for locality of access.
+
+#include <unistd.h>
+
+#include <ctime>
+
+#include <memory>
+#include <string>
+
+#include <fst/compat.h>
+#include <fst/script/getters.h>
+#include <fst/script/statesort.h>
+
+DEFINE_string(order, "bfs",
+              "State order, one of: \"bfs\", \"dfs\", \"rcm\", \"hot_path\"");
+DEFINE_int32(npath, 1000, "Number of paths sampled for --order=hot_path");
+DEFINE_int32(max_length, 1000,
+             "Maximum length of the paths sampled for --order=hot_path");
+DEFINE_int32(seed, time(nullptr) + getpid(), "Random seed");
+DEFINE_string(select, "uniform",
+              "Selection type for --order=hot_path: one of: "
+              " \"uniform\", \"log_prob\" (when appropriate),"
+              " \"fast_log_prob\" (when appropriate)");
+
+int main(int argc, char **argv) {
+  namespace s = fst::script;
+  using fst::script::FstClass;
+  using fst::script::MutableFstClass;
+
+  string usage = "Sorts the states of an FST for locality of access.\n\n"
+                 "  Usage: ";
+  usage += argv[0];
+  usage += " [in.fst [out.fst]]\n";
+
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(usage.c_str(), &argc, &argv, true);
+
+  if (argc > 3) {
+    ShowUsage();
+    return 1;
+  }
+
+  string in_name = (argc > 1 && (strcmp(argv[1], "-") != 0)) ? argv[1] : "";
+  string out_name = argc > 2 ? argv[2] : "";
+
+  std::unique_ptr<MutableFstClass> fst(MutableFstClass::Read(in_name, true));
+  if (!fst) return 1;
+
+  fst::StateOrderType order_type;
+  if (!s::GetStateOrderType(FLAGS_order, &order_type)) {
+    LOG(ERROR) << argv[0] << ": Unknown or unsupported state order: "
+               << FLAGS_order;
+    return 1;
+  }
+
+  s::RandArcSelection ras;
+  if (!s::GetRandArcSelection(FLAGS_select, &ras)) {
+    LOG(ERROR) << argv[0] << ": Unknown or unsupported select type "
+               << FLAGS_select;
+    return 1;
+  }
+
+  VLOG(1) << argv[0] << ": Seed = " << FLAGS_seed;
+
+  s::StateSort(fst.get(), order_type, ras, FLAGS_npath, FLAGS_max_length,
+               FLAGS_seed);
+
+  fst->Write(out_name);
+
+  return 0;
+}
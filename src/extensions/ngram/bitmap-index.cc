@@ -4,36 +4,14 @@
 #include <fst/extensions/ngram/bitmap-index.h>
 
 #include <algorithm>
-#include <iterator>
 
 #include <fst/extensions/ngram/nthbit.h>
 
 namespace fst {
 namespace {
-const size_t kPrimaryBlockBits =
-    BitmapIndex::kStorageBitSize * BitmapIndex::kSecondaryBlockSize;
-
-// If [begin, begin+size) is a monotonically increasing running sum of
-// popcounts for a bitmap, this will return the index of the word that contains
-// the value'th zero.  If value is larger then the number of zeros in the
-// bitmap, size will be returned.  The idea is that the number of zerocounts
-// (i.e. the popcount of logical NOT of values) is offset * kStorageBitSize
-// minus the value for each element of the running sum.
-template <size_t BlockSize, typename Iter, typename T>
-Iter InvertedSearch(Iter first, Iter last, T value) {
-  const Iter begin = first;
-  while (first != last) {
-    // Invariant: [first, last) is the search range.
-    Iter mid = first + ((last - first) / 2);
-    size_t mid_value = BlockSize * (1 + (mid - begin)) - *mid;
-    if (mid_value < value) {
-      first = ++mid;
-    } else {
-      last = mid;
-    }
-  }
-  return first;
-}
+// Number of words scanned by Select0s() for the next clear bit before falling
+// back to a full select.
+const size_t kSelect0sScanWords = 8;
 }  // namespace
 
 size_t BitmapIndex::Rank1(size_t end) const {
@@ -53,43 +31,19 @@ size_t BitmapIndex::Rank1(size_t end) const {
 
 size_t BitmapIndex::Select1(size_t bit_index) const {
   if (bit_index >= GetOnesCount()) return Bits();
-  // search primary index for the relevant block
-  uint32 rembits = bit_index + 1;
-  const uint32 block = find_primary_block(bit_index + 1);
-  uint32 offset = 0;
-  if (block > 0) {
-    rembits -= primary_index_[block - 1];
-    offset += block * kSecondaryBlockSize;
-  }
-  // search the secondary index
-  uint32 word = find_secondary_block(offset, rembits);
-  if (word > 0) {
-    rembits -= secondary_index_[offset + word - 1];
-    offset += word;
-  }
-  int nth = nth_bit(bits_[offset], rembits);
-  return (offset << BitmapIndex::kStorageLogBitSize) + nth;
+  const size_t word = find_select1_word(bit_index);
+  const uint32 rembits = bit_index + 1 - get_index_ones_count(word);
+  return (word << BitmapIndex::kStorageLogBitSize) +
+         nth_bit(bits_[word], rembits);
 }
 
 size_t BitmapIndex::Select0(size_t bit_index) const {
   if (bit_index >= Bits() - GetOnesCount()) return Bits();
-  // search inverted primary index for relevant block
-  uint32 remzeros = bit_index + 1;
-  uint32 offset = 0;
-  const uint32 block = find_inverted_primary_block(bit_index + 1);
-  if (block > 0) {
-    remzeros -= kPrimaryBlockBits * block - primary_index_[block - 1];
-    offset += block * kSecondaryBlockSize;
-  }
-  // search the inverted secondary index
-  uint32 word = find_inverted_secondary_block(offset, remzeros);
-  if (word > 0) {
-    remzeros -= BitmapIndex::kStorageBitSize * word -
-                secondary_index_[offset + word - 1];
-    offset += word;
-  }
-  int nth = nth_bit(~bits_[offset], remzeros);
-  return (offset << BitmapIndex::kStorageLogBitSize) + nth;
+  const size_t word = find_select0_word(bit_index);
+  const uint32 remzeros = bit_index + 1 - (word << kStorageLogBitSize) +
+                          get_index_ones_count(word);
+  return (word << BitmapIndex::kStorageLogBitSize) +
+         nth_bit(~bits_[word], remzeros);
 }
 
 std::pair<size_t, size_t> BitmapIndex::Select0s(size_t bit_index) const {
@@ -97,58 +51,29 @@ std::pair<size_t, size_t> BitmapIndex::Select0s(size_t bit_index) const {
   const uint64 ones = ~zero;
   size_t zeros_count = Bits() - GetOnesCount();
   if (bit_index >= zeros_count) return std::make_pair(Bits(), Bits());
+  const size_t current_zero = Select0(bit_index);
   if (bit_index + 1 >= zeros_count) {
-    return std::make_pair(Select0(bit_index), Bits());
-  }
-  // search inverted primary index for relevant block
-  uint32 remzeros = bit_index + 1;
-  uint32 offset = 0;
-  const uint32 block = find_inverted_primary_block(bit_index + 1);
-  size_t num_zeros_in_block =
-      kPrimaryBlockBits * (1 + block) - primary_index_[block];
-  if (block > 0) {
-    size_t num_zeros_next =
-        kPrimaryBlockBits * block - primary_index_[block - 1];
-    num_zeros_in_block -= num_zeros_next;
-    remzeros -= num_zeros_next;
-    offset += block * kSecondaryBlockSize;
+    return std::make_pair(current_zero, Bits());
   }
-  // search the inverted secondary index
-  uint32 word = find_inverted_secondary_block(offset, remzeros);
-  uint32 sum_zeros_next_word = BitmapIndex::kStorageBitSize * (1 + word) -
-                               secondary_index_[offset + word];
-  uint32 sum_zeros_this_word = 0;
-  if (word > 0) {
-    sum_zeros_this_word = BitmapIndex::kStorageBitSize * word -
-                          secondary_index_[offset + word - 1];
-    remzeros -= sum_zeros_this_word;
-    offset += word;
+  // The next zero is most often in the same word, or in one shortly after.
+  size_t offset = current_zero >> BitmapIndex::kStorageLogBitSize;
+  const uint64 rest =
+      ~bits_[offset] & ((ones << (current_zero & kStorageBlockMask)) << 1);
+  if (rest != 0) {
+    return std::make_pair(
+        current_zero,
+        (offset << BitmapIndex::kStorageLogBitSize) + __builtin_ctzll(rest));
   }
-  int nth = nth_bit(~bits_[offset], remzeros);
-  size_t current_zero = (offset << BitmapIndex::kStorageLogBitSize) + nth;
-
-  size_t next_zero;
-  // Does the current block contain the next zero?
-  if (num_zeros_in_block > remzeros + 1) {
-    if (sum_zeros_next_word - sum_zeros_this_word >= remzeros + 1) {
-      // the next zero is in this word
-      next_zero = (offset << BitmapIndex::kStorageLogBitSize) +
-                  nth_bit(~bits_[offset], remzeros + 1);
-    } else {
-      // Find the first field that is not all ones by linear scan.
-      // In the worst case, this may scan 8Kbytes.  The alternative is
-      // to inspect secondary_index_ looking for a place to jump to, but
-      // that would probably use more cache.
-      while (bits_[++offset] == ones) {
-      }
-      next_zero = (offset << BitmapIndex::kStorageLogBitSize) +
-                  __builtin_ctzll(~bits_[offset]);
+  const size_t end = std::min(offset + 1 + kSelect0sScanWords, ArraySize());
+  while (++offset < end) {
+    if (bits_[offset] != ones) {
+      return std::make_pair(current_zero,
+                            (offset << BitmapIndex::kStorageLogBitSize) +
+                                __builtin_ctzll(~bits_[offset]));
     }
-  } else {
-    // the next zero is in a different block, a full search is required.
-    next_zero = Select0(bit_index + 1);
   }
-  return std::make_pair(current_zero, next_zero);
+  // A long run of ones: a full search is required.
+  return std::make_pair(current_zero, Select0(bit_index + 1));
 }
 
 size_t BitmapIndex::get_index_ones_count(size_t array_index) const {
@@ -185,41 +110,59 @@ void BitmapIndex::BuildIndex(const uint64 *bits, size_t size) {
     popcount += block_popcount;
     primary_index_[block] = popcount;
   }
+  BuildSelectHints();
 }
 
-size_t BitmapIndex::find_secondary_block(size_t block_begin,
-                                         size_t rem_bit_index) const {
-  size_t block_end = block_begin + kSecondaryBlockSize;
-  if (block_end > ArraySize()) block_end = ArraySize();
-  return std::distance(
-      secondary_index_.begin() + block_begin,
-      std::lower_bound(secondary_index_.begin() + block_begin,
-                       secondary_index_.begin() + block_end, rem_bit_index));
-}
-
-size_t BitmapIndex::find_inverted_secondary_block(size_t block_begin,
-                                                  size_t rem_bit_index) const {
-  size_t block_end = block_begin + kSecondaryBlockSize;
-  if (block_end > ArraySize()) block_end = ArraySize();
-  return std::distance(
-      secondary_index_.begin() + block_begin,
-      InvertedSearch<BitmapIndex::kStorageBitSize>(
-          secondary_index_.begin() + block_begin,
-          secondary_index_.begin() + block_end, rem_bit_index));
+void BitmapIndex::BuildSelectHints() {
+  select1_hints_.clear();
+  select0_hints_.clear();
+  if (ArraySize() == 0) return;
+  size_t next_one = 0;
+  size_t next_zero = 0;
+  for (size_t j = 0; j < ArraySize(); ++j) {
+    const size_t ones_end = get_index_ones_count(j + 1);
+    const size_t zeros_end =
+        std::min((j + 1) << kStorageLogBitSize, size_) - ones_end;
+    for (; next_one < ones_end; next_one += kSelectSample) {
+      select1_hints_.push_back(j);
+    }
+    for (; next_zero < zeros_end; next_zero += kSelectSample) {
+      select0_hints_.push_back(j);
+    }
+  }
+  select1_hints_.push_back(ArraySize() - 1);
+  select0_hints_.push_back(ArraySize() - 1);
 }
 
-inline size_t BitmapIndex::find_primary_block(size_t bit_index) const {
-  return std::distance(
-      primary_index_.begin(),
-      std::lower_bound(primary_index_.begin(),
-                       primary_index_.begin() + primary_index_size(),
-                       bit_index));
+size_t BitmapIndex::find_select1_word(size_t bit_index) const {
+  // The word lies between the words containing the sampled bits around it.
+  const size_t sample = bit_index / kSelectSample;
+  size_t lo = select1_hints_[sample];
+  size_t hi = select1_hints_[sample + 1];
+  // Finds the last word preceded by at most bit_index ones.
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo + 1) / 2;
+    if (get_index_ones_count(mid) <= bit_index) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
 }
 
-size_t BitmapIndex::find_inverted_primary_block(size_t bit_index) const {
-  return std::distance(
-      primary_index_.begin(),
-      InvertedSearch<kPrimaryBlockBits>(primary_index_.begin(),
-                                        primary_index_.end(), bit_index));
+size_t BitmapIndex::find_select0_word(size_t bit_index) const {
+  const size_t sample = bit_index / kSelectSample;
+  size_t lo = select0_hints_[sample];
+  size_t hi = select0_hints_[sample + 1];
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo + 1) / 2;
+    if ((mid << kStorageLogBitSize) - get_index_ones_count(mid) <= bit_index) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
 }
 }  // end namespace fst
@@ -13,6 +13,9 @@ DEFINE_string(pdt_parentheses, "", "PDT parenthesis label pairs.");
 DEFINE_bool(connect, true, "Trim output");
 DEFINE_bool(keep_parentheses, false, "Keep PDT parentheses in result.");
 DEFINE_string(weight, "", "Weight threshold");
+DEFINE_string(paren_index, "", "Paren index file of the PDT used when pruning");
+DEFINE_bool(write_paren_index, false,
+            "Compute the paren index and write it to --paren_index");
 
 int main(int argc, char **argv) {
   namespace s = fst::script;
@@ -49,7 +52,8 @@ int main(int argc, char **argv) {
   s::VectorFstClass ofst(ifst->ArcType());
   s::PdtExpand(*ifst, parens, &ofst,
                s::PdtExpandOptions(FLAGS_connect, FLAGS_keep_parentheses,
-                                   weight_threshold));
+                                   weight_threshold, FLAGS_paren_index,
+                                   FLAGS_write_paren_index));
 
   ofst.Write(out_name);
 
@@ -14,6 +14,8 @@ DEFINE_string(queue_type, "fifo",
               "Queue type: one of: "
               "\"fifo\", \"lifo\", \"state\"");
 DEFINE_bool(path_gc, true, "Garbage collect shortest path data");
+DEFINE_string(weight, "", "Weight threshold");
+DEFINE_int64(nstate, fst::kNoStateId, "Search state number threshold");
 DEFINE_string(pdt_parentheses, "", "PDT parenthesis label pairs.");
 
 int main(int argc, char **argv) {
@@ -59,7 +61,12 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  s::PdtShortestPathOptions opts(qt, FLAGS_keep_parentheses, FLAGS_path_gc);
+  s::WeightClass weight_threshold =
+      FLAGS_weight.empty() ? s::WeightClass::Zero(ifst->WeightType())
+                           : s::WeightClass(ifst->WeightType(), FLAGS_weight);
+
+  s::PdtShortestPathOptions opts(qt, FLAGS_keep_parentheses, FLAGS_path_gc,
+                                 weight_threshold, FLAGS_nstate);
   s::PdtShortestPath(*ifst, parens, &ofst, opts);
   ofst.Write(out_name);
 
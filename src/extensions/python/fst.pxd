@@ -482,6 +482,12 @@ cdef extern from "<fst/script/fstscript.h>" namespace "fst::script" nogil:
   cdef void Compose(FstClass &, FstClass &, MutableFstClass *,
                     const ComposeOptions &)
 
+  ctypedef pair[const FstClass *, const FstClass *] FstClassPair
+
+  cdef void Compose(const vector[FstClassPair] &,
+                    const vector[MutableFstClass *] &, const ComposeOptions &,
+                    int)
+
   cdef void Concat(MutableFstClass *, const FstClass &)
 
   cdef void Connect(MutableFstClass *)
@@ -620,6 +626,8 @@ cdef extern from "<fst/script/fstscript.h>" namespace "fst::script" nogil:
   cdef void ShortestDistance(const FstClass &, vector[WeightClass] *, bool,
                              float)
 
+  cdef bool ShortestDistance(const FstClass &, vector[double] *, bool, double)
+
   cdef cppclass ShortestPathOptions:
 
     ShortestPathOptions(QueueType, int32, bool, bool, float, bool,
@@ -636,8 +644,25 @@ cdef extern from "<fst/script/fstscript.h>" namespace "fst::script" nogil:
 
   cdef bool Verify(const FstClass &)
 
+  cdef cppclass ArcArray:
+
+    const char *data
+    size_t num_arcs
+    size_t arc_size
+    size_t ilabel_offset
+    size_t olabel_offset
+    size_t weight_offset
+    size_t nextstate_offset
+    size_t label_size
+    size_t weight_size
+    size_t stateid_size
+    bool float_weight
+    vector[size_t] state_offsets
+
+  cdef bool GetArcArray(const FstClass &, ArcArray *)
+
 
-cdef extern from "nlp/fst/script/getters.h" namespace "fst::script" nogil:
+cdef extern from "<fst/script/getters.h>" namespace "fst::script" nogil:
 
   cdef bool GetArcSortType(const string &, ArcSortType *)
 
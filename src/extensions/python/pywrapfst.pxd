@@ -405,6 +405,34 @@ cdef class StateIterator(object):
   cpdef int64 value(self)
 
 
+# Array views.
+
+cdef class _ArrayView(object):
+
+  cdef object _owner
+  cdef const char *_data
+  cdef Py_ssize_t _shape[1]
+  cdef Py_ssize_t _strides[1]
+  cdef Py_ssize_t _itemsize
+  cdef const char *_format
+
+
+cdef _ArrayView _init_ArrayView(object owner, const char *data, size_t size,
+                                size_t stride, size_t itemsize,
+                                const char *format)
+
+
+cdef class _ArcArray(object):
+
+  cdef shared_ptr[fst.FstClass] _fst
+  cdef fst.ArcArray _array
+
+
+cdef class _DistanceArray(object):
+
+  cdef vector[double] _distance
+
+
 # Constructive operations on Fst.
 
 
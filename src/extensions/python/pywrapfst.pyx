@@ -1,4 +1,4 @@
-#cython: nonecheck=True
+#cython: nonecheck=True, language_level=2
 # See www.openfst.org for extensive documentation on this weighted
 # finite-state transducer library.
 
@@ -40,6 +40,7 @@ normal `k` prefix.
 # * FST properties
 # * Arc, ArcIterator, and MutableArcIterator
 # * StateIterator
+# * Array views
 # * FST operations
 # * Compiler
 # * FarReader and FarWriter
@@ -66,6 +67,16 @@ normal `k` prefix.
 # Internal functions which may raise a Python error do not have a C++ return
 # type simply because this leads the C++ compiler to think that the resulting
 # value could be used before it is populated.
+#
+# The GIL is released around the C++ calls of potentially long-running
+# operations (e.g., composition, determinization, minimization, shortest path,
+# and binary I/O) so that other Python threads can run concurrently. Only C++
+# values may be used inside these `nogil` blocks, so the arguments are unpacked
+# into C++ locals beforehand. FSTs are not thread-safe, even when only read
+# (e.g., property bits are cached on first use), so an FST passed to one of
+# these operations must not be used by any other thread until it returns. The
+# batch operations (e.g., `compose_batch`) instead run on a C++ thread pool and
+# take care themselves of inputs shared between the items of one batch.
 
 
 ## Imports.
@@ -80,6 +91,12 @@ from libcpp cimport bool
 from libcpp.cast cimport const_cast
 from libcpp.cast cimport static_cast
 
+# Python/C API imports.
+from cpython.buffer cimport PyBUF_FORMAT
+from cpython.buffer cimport PyBUF_ND
+from cpython.buffer cimport PyBUF_STRIDES
+from cpython.buffer cimport PyBUF_WRITABLE
+
 # Our C++ imports.
 from ios cimport ofstream
 from memory cimport static_pointer_cast
@@ -1376,6 +1393,58 @@ cdef class _Fst(object):
     """
     return ArcIterator(self, state)
 
+  def arc_arrays(self):
+    """
+    arc_arrays(self)
+
+    Returns read-only views of the FST's arc storage without copying arcs.
+
+    This requires an immutable FST whose arcs are stored in a single array in
+    state order, such as a "const" FST; other FSTs, including mutable ones, can
+    be viewed after a conversion, e.g., `convert(f, "const")`. The views
+    support the buffer protocol, and so may be passed to `memoryview` or
+    `numpy.asarray`. Arcs leaving state s are found at indices
+    state_offsets[s] up to (but not including) state_offsets[s + 1]. The
+    weights must be single floating-point values, as in the "standard", "log"
+    and "log64" arc types.
+
+    Returns:
+      A tuple (state_offsets, ilabels, olabels, weights, nextstates) of
+      buffer-protocol objects; the weights are the underlying numeric values.
+
+    Raises:
+      FstOpError: Arcs are not stored in a single array, or weights are not
+          floating-point values.
+
+    See also: `arcs`, `convert`.
+    """
+    if self._fst.get().Properties(fst.kMutable, False):
+      raise FstOpError("Cannot view the arcs of a mutable FST")
+    cdef _ArcArray array = _ArcArray.__new__(_ArcArray)
+    array._fst = self._fst
+    if not fst.GetArcArray(deref(self._fst), addr(array._array)):
+      raise FstOpError("Arcs are not stored in a single array")
+    cdef fst.ArcArray *tarray = addr(array._array)
+    if not tarray.float_weight:
+      raise FstOpError("Weights are not floating-point values")
+    cdef size_t num_states = tarray.state_offsets.size()
+    # Formats are static strings, so may be held as C pointers.
+    cdef const char *label_format = _integer_format(tarray.label_size)
+    cdef const char *stateid_format = _integer_format(tarray.stateid_size)
+    state_offsets = _init_ArrayView(array,
+        <const char *> tarray.state_offsets.data(), num_states,
+        sizeof(size_t), sizeof(size_t), _unsigned_format(sizeof(size_t)))
+    ilabels = _init_ArrayView(array, tarray.data + tarray.ilabel_offset,
+        tarray.num_arcs, tarray.arc_size, tarray.label_size, label_format)
+    olabels = _init_ArrayView(array, tarray.data + tarray.olabel_offset,
+        tarray.num_arcs, tarray.arc_size, tarray.label_size, label_format)
+    weights = _init_ArrayView(array, tarray.data + tarray.weight_offset,
+        tarray.num_arcs, tarray.arc_size, tarray.weight_size,
+        _float_format(tarray.weight_size))
+    nextstates = _init_ArrayView(array, tarray.data + tarray.nextstate_offset,
+        tarray.num_arcs, tarray.arc_size, tarray.stateid_size, stateid_format)
+    return (state_offsets, ilabels, olabels, weights, nextstates)
+
   cpdef _Fst copy(self):
     """
     copy(self)
@@ -1658,7 +1727,12 @@ cdef class _Fst(object):
     Raises:
       FstIOError: Write failed.
     """
-    if not self._fst.get().Write(tostring(filename)):
+    cdef string filename_string = tostring(filename)
+    cdef fst.FstClass *tfst = self._fst.get()
+    cdef bool success
+    with nogil:
+      success = tfst.Write(filename_string)
+    if not success:
       raise FstIOError("Write failed: {!r}".format(filename))
 
 
@@ -1954,8 +2028,10 @@ cdef class _MutableFst(_Fst):
 
   cdef void _minimize(self, float delta=fst.kDelta,
                       bool allow_nondet=False) except *:
+    cdef fst.MutableFstClass *tfst = self._mfst.get()
     # This runs in-place when the second argument is null.
-    fst.Minimize(self._mfst.get(), NULL, delta, allow_nondet)
+    with nogil:
+      fst.Minimize(tfst, NULL, delta, allow_nondet)
     self._check_mutating_imethod()
 
   def minimize(self, float delta=fst.kDelta, bool allow_nondet=False):
@@ -2579,7 +2655,10 @@ cdef _MutableFst _create_Fst(arc_type=b"standard"):
 
 
 cdef _Fst _read_Fst(filename, fst_type=None):
-  cdef fst.FstClass *tfst = fst.FstClass.Read(tostring(filename))
+  cdef string filename_string = tostring(filename)
+  cdef fst.FstClass *tfst
+  with nogil:
+    tfst = fst.FstClass.Read(filename_string)
   if tfst == NULL:
     raise FstIOError("Read failed: {!r}".format(filename))
   # Converts if requested.
@@ -3136,6 +3215,108 @@ cdef class StateIterator(object):
     return self._siter.get().Value()
 
 
+## Array views.
+
+
+cdef const char *_integer_format(size_t size) except NULL:
+  if size == 4:
+    return b"i"
+  elif size == 8:
+    return b"q"
+  raise FstOpError("Unsupported integer size: {}".format(size))
+
+
+cdef const char *_unsigned_format(size_t size) except NULL:
+  if size == 4:
+    return b"I"
+  elif size == 8:
+    return b"Q"
+  raise FstOpError("Unsupported integer size: {}".format(size))
+
+
+cdef const char *_float_format(size_t size) except NULL:
+  if size == 4:
+    return b"f"
+  elif size == 8:
+    return b"d"
+  raise FstOpError("Unsupported weight size: {}".format(size))
+
+
+cdef class _ArrayView(object):
+
+  """
+  (No constructor.)
+
+  Read-only, one-dimensional buffer-protocol view over C++ storage.
+
+  The storage belongs to an owner object, which the view keeps alive; elements
+  may be strided, as when viewing one field of an array of arcs.
+  """
+
+  def __init__(self):
+    raise FstDeletedConstructorError(
+        "Cannot construct {}".format(self.__class__.__name__))
+
+  def __repr__(self):
+    return "<_ArrayView of {} elements at 0x{:x}>".format(self._shape[0],
+                                                          id(self))
+
+  def __len__(self):
+    return self._shape[0]
+
+  def __getbuffer__(self, Py_buffer *buffer, int flags):
+    if flags & PyBUF_WRITABLE:
+      raise BufferError("View is read-only")
+    if not (flags & PyBUF_STRIDES) and self._strides[0] != self._itemsize:
+      raise BufferError("View is not contiguous")
+    buffer.buf = <void *> self._data
+    buffer.obj = self
+    buffer.len = self._shape[0] * self._itemsize
+    buffer.readonly = 1
+    buffer.itemsize = self._itemsize
+    buffer.format = <char *> self._format if flags & PyBUF_FORMAT else NULL
+    buffer.ndim = 1
+    buffer.shape = NULL
+    if flags & PyBUF_ND:
+      buffer.shape = self._shape
+    buffer.strides = NULL
+    if flags & PyBUF_STRIDES:
+      buffer.strides = self._strides
+    buffer.suboffsets = NULL
+    buffer.internal = NULL
+
+  def __releasebuffer__(self, Py_buffer *buffer):
+    pass
+
+
+cdef _ArrayView _init_ArrayView(object owner, const char *data, size_t size,
+                                size_t stride, size_t itemsize,
+                                const char *format):
+  cdef _ArrayView view = _ArrayView.__new__(_ArrayView)
+  view._owner = owner
+  view._data = data
+  view._shape[0] = size
+  view._strides[0] = stride
+  view._itemsize = itemsize
+  view._format = format
+  return view
+
+
+cdef class _ArcArray(object):
+
+  # Owner of the arc array layout; holds a reference to the FST so that the
+  # arcs outlive any views of them.
+
+  pass
+
+
+cdef class _DistanceArray(object):
+
+  # Owner of a vector of shortest distances.
+
+  pass
+
+
 ## FST operations.
 
 
@@ -3254,10 +3435,101 @@ cpdef _MutableFst compose(_Fst ifst1,
   cdef VectorFstClass_ptr tfst = new fst.VectorFstClass(ifst1.arc_type())
   cdef unique_ptr[fst.ComposeOptions] opts
   opts.reset(new fst.ComposeOptions(connect, _get_compose_filter(tostring(cf))))
-  fst.Compose(deref(ifst1._fst), deref(ifst2._fst), tfst, deref(opts))
+  cdef fst.FstClass *tfst1 = ifst1._fst.get()
+  cdef fst.FstClass *tfst2 = ifst2._fst.get()
+  with nogil:
+    fst.Compose(deref(tfst1), deref(tfst2), tfst, deref(opts))
   return _init_MutableFst(tfst)
 
 
+def compose_batch(pairs, cf=b"auto", bool connect=True, int num_threads=0):
+  """
+  compose_batch(pairs, cf="auto", connect=True, num_threads=0)
+
+  Constructively composes each of a sequence of pairs of FSTs.
+
+  This operation is equivalent to calling `compose` on each pair, but the
+  compositions are performed by a single C++ call, with the GIL released, on a
+  pool of C++ threads. The same FST may appear in any number of pairs; for
+  instance, a batch of inputs can be composed with one shared grammar. As with
+  `compose`, other Python threads may run meanwhile but must not use any of the
+  input FSTs until it returns.
+
+  Args:
+    pairs: An iterable of (ifst1, ifst2) tuples of input FSTs.
+    cf: A string matching a known composition filter; one of: "alt_sequence",
+        "auto", "match", "null", "sequence", "trivial".
+    connect: Should output be trimmed?
+    num_threads: The number of threads to use; if zero or negative, one per
+        hardware thread.
+
+  Returns:
+    A list of composed FSTs, in the order of the input pairs.
+
+  Raises:
+    FstOpError: Operation failed.
+
+  See also: `compose`, `compose_far`.
+  """
+  cdef unique_ptr[fst.ComposeOptions] opts
+  opts.reset(new fst.ComposeOptions(connect, _get_compose_filter(tostring(cf))))
+  # Holds references to the inputs so they outlive the C++ call.
+  inputs = list(pairs)
+  cdef vector[fst.FstClassPair] tpairs
+  cdef vector[fst.MutableFstClass *] tofsts
+  cdef _Fst ifst1
+  cdef _Fst ifst2
+  cdef VectorFstClass_ptr tfst
+  # The outputs are owned by these objects, created before the C++ call so
+  # that none leaks if an exception is raised.
+  result = []
+  for (ifst1, ifst2) in inputs:
+    tpairs.push_back(fst.FstClassPair(ifst1._fst.get(), ifst2._fst.get()))
+    tfst = new fst.VectorFstClass(ifst1.arc_type())
+    tofsts.push_back(tfst)
+    result.append(_init_MutableFst(tfst))
+  with nogil:
+    fst.Compose(tpairs, tofsts, deref(opts), num_threads)
+  cdef size_t i
+  for i in range(tofsts.size()):
+    if tofsts[i].Properties(fst.kError, True):
+      raise FstOpError("Operation failed")
+  return result
+
+
+def compose_far(FarReader reader, _Fst ifst2, cf=b"auto", bool connect=True,
+                int num_threads=0):
+  """
+  compose_far(reader, ifst2, cf="auto", connect=True, num_threads=0)
+
+  Constructively composes each FST in a FAR with the same right-hand FST.
+
+  The remaining entries of the FAR are read, then composed with `ifst2` as by
+  `compose_batch`.
+
+  Args:
+    reader: A FarReader, positioned at the first entry to compose.
+    ifst2: The input FST composed with each entry.
+    cf: A string matching a known composition filter; one of: "alt_sequence",
+        "auto", "match", "null", "sequence", "trivial".
+    connect: Should output be trimmed?
+    num_threads: The number of threads to use; if zero or negative, one per
+        hardware thread.
+
+  Returns:
+    A list of (key, composed FST) tuples, in the order of the FAR.
+
+  Raises:
+    FstOpError: Operation failed.
+
+  See also: `compose_batch`.
+  """
+  entries = list(reader)
+  ofsts = compose_batch([(ifst1, ifst2) for (_, ifst1) in entries], cf,
+                        connect, num_threads)
+  return [(key, ofst) for ((key, _), ofst) in zip(entries, ofsts)]
+
+
 cpdef _Fst convert(_Fst ifst, fst_type=b""):
   """
   convert(ifst, fst_type="")
@@ -3335,7 +3607,9 @@ cpdef _MutableFst determinize(_Fst ifst,
   opts.reset(new fst.DeterminizeOptions(delta, wc, nstate, subsequential_label,
                                         determinize_type,
                                         increment_subsequential_label))
-  fst.Determinize(deref(ifst._fst), tfst, deref(opts))
+  cdef fst.FstClass *tifst = ifst._fst.get()
+  with nogil:
+    fst.Determinize(deref(tifst), tfst, deref(opts))
   return _init_MutableFst(tfst)
 
 
@@ -3938,6 +4212,48 @@ def shortestdistance(_Fst ifst,
   return result
 
 
+def shortestdistance_array(_Fst ifst,
+                           float delta=fst.kDelta,
+                           bool reverse=False):
+  """
+  shortestdistance_array(ifst, delta=0.0009765625, reverse=False)
+
+  Compute the shortest distance from the initial or final state as an array.
+
+  This operation is equivalent to `shortestdistance` with the default queue
+  type, but returns the distances as a read-only buffer-protocol object of
+  C doubles, suitable for `memoryview` or `numpy.asarray`, rather than as a
+  list of Weight objects. It requires a weight type with a numeric value, such
+  as those of the "standard", "log" and "log64" arc types.
+
+  Args:
+    ifst: The input FST.
+    delta: Comparison/quantization delta.
+    reverse: Should the reverse distance (from each state to the final state)
+        be computed?
+
+  Returns:
+    A buffer-protocol object holding the weight value of the shortest distance
+    for each state.
+
+  Raises:
+    FstOpError: Operation failed, e.g., on an unsupported arc type.
+
+  See also: `shortestdistance`.
+  """
+  cdef _DistanceArray result = _DistanceArray.__new__(_DistanceArray)
+  cdef fst.FstClass *tifst = ifst._fst.get()
+  cdef vector[double] *tdistance = addr(result._distance)
+  cdef bool success
+  with nogil:
+    success = fst.ShortestDistance(deref(tifst), tdistance, reverse, delta)
+  if not success:
+    raise FstOpError("Operation failed")
+  return _init_ArrayView(result, <const char *> tdistance.data(),
+                         tdistance.size(), sizeof(double), sizeof(double),
+                         b"d")
+
+
 cpdef _MutableFst shortestpath(_Fst ifst,
                                float delta=fst.kDelta,
                                int32 nshortest=1,
@@ -3984,7 +4300,10 @@ cpdef _MutableFst shortestpath(_Fst ifst,
   opts.reset(new fst.ShortestPathOptions(_get_queue_type(tostring(qt)),
                                          nshortest, unique, False, delta,
                                          False, wc, nstate))
-  fst.ShortestPath(deref(ifst._fst), tfst, distance.get(), deref(opts))
+  cdef fst.FstClass *tifst = ifst._fst.get()
+  cdef vector[fst.WeightClass] *tdistance = distance.get()
+  with nogil:
+    fst.ShortestPath(deref(tifst), tfst, tdistance, deref(opts))
   return _init_MutableFst(tfst)
 
 
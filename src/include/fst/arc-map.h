@@ -123,13 +123,14 @@ void ArcMap(MutableFst<A> *fst, C *mapper) {
     switch (final_action) {
       case MAP_NO_SUPERFINAL:
       default: {
-        A final_arc = (*mapper)(A(0, 0, fst->Final(s), kNoStateId));
+        const Weight final = fst->Final(s);
+        A final_arc = (*mapper)(A(0, 0, final, kNoStateId));
         if (final_arc.ilabel != 0 || final_arc.olabel != 0) {
           FSTERROR() << "ArcMap: Non-zero arc labels for superfinal arc";
           fst->SetProperties(kError, kError);
         }
 
-        fst->SetFinal(s, final_arc.weight);
+        if (final_arc.weight != final) fst->SetFinal(s, final_arc.weight);
         break;
       }
       case MAP_ALLOW_SUPERFINAL: {
@@ -206,7 +207,7 @@ void ArcMap(const Fst<A> &ifst, MutableFst<B> *ofst, C *mapper) {
   MapFinalAction final_action = mapper->FinalAction();
   if (ifst.Properties(kExpanded, false)) {
     ofst->ReserveStates(
-        CountStates(ifst) + final_action == MAP_NO_SUPERFINAL ? 0 : 1);
+        CountStates(ifst) + (final_action == MAP_NO_SUPERFINAL ? 0 : 1));
   }
 
   // Add all states.
@@ -8,15 +8,26 @@
 
 #include <algorithm>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <fst/cache.h>
 #include <fst/state-map.h>
 #include <fst/test-properties.h>
+#include <fst/thread-pool.h>
+#include <fst/vector-fst.h>
 
 
 namespace fst {
 
+template <class A>
+class ILabelCompare;
+
+template <class A>
+class OLabelCompare;
+
 template <class Arc, class Compare>
 class ArcSortMapper {
  public:
@@ -64,6 +75,126 @@ class ArcSortMapper {
   ArcSortMapper &operator=(const ArcSortMapper &) = delete;
 };
 
+namespace internal {
+
+// Minimum number of arcs for which sorting by label uses a radix sort rather
+// than std::sort.
+const size_t kArcSortRadixMinArcs = 256;
+
+// Sorts the arcs in [begin, end) by the label 'key(arc)' with a stable LSD
+// radix sort, one byte per pass; bytes shared by all labels are skipped.
+// 'buffer' is scratch space.
+template <class Arc, class Key>
+void RadixSortArcs(Arc *begin, Arc *end, Key key, std::vector<Arc> *buffer) {
+  typedef typename Arc::Label Label;
+  typedef typename std::make_unsigned<Label>::type Digits;
+  static const int kBytes = sizeof(Label);
+  // Flipping the sign bit orders negative labels (e.g. kNoLabel) first.
+  static const Digits kSignBit = Digits(1) << (8 * kBytes - 1);
+  auto digits = [&key](const Arc &arc) {
+    return static_cast<Digits>(key(arc)) ^ kSignBit;
+  };
+
+  const size_t size = end - begin;
+  size_t counts[kBytes][256] = {};
+  for (const Arc *arc = begin; arc != end; ++arc) {
+    Digits d = digits(*arc);
+    for (int i = 0; i < kBytes; ++i, d >>= 8) ++counts[i][d & 0xff];
+  }
+  buffer->resize(size);
+  Arc *from = begin;
+  Arc *to = buffer->data();
+  for (int i = 0; i < kBytes; ++i) {
+    size_t *count = counts[i];
+    const int shift = 8 * i;
+    if (count[(digits(*begin) >> shift) & 0xff] == size) continue;
+    size_t offset = 0;
+    for (int d = 0; d < 256; ++d) {
+      const size_t n = count[d];
+      count[d] = offset;
+      offset += n;
+    }
+    for (const Arc *arc = from; arc != from + size; ++arc) {
+      to[count[(digits(*arc) >> shift) & 0xff]++] = *arc;
+    }
+    std::swap(from, to);
+  }
+  if (from != begin) std::copy(from, from + size, begin);
+}
+
+// Sorts the arcs in [begin, end) according to 'comp'.
+template <class Arc, class Compare>
+void SortArcs(Arc *begin, Arc *end, const Compare &comp,
+              std::vector<Arc> *buffer) {
+  std::sort(begin, end, comp);
+}
+
+template <class Arc>
+void SortArcs(Arc *begin, Arc *end, const ILabelCompare<Arc> &comp,
+              std::vector<Arc> *buffer) {
+  if (static_cast<size_t>(end - begin) < kArcSortRadixMinArcs) {
+    std::sort(begin, end, comp);
+  } else {
+    RadixSortArcs(begin, end, [](const Arc &arc) { return arc.ilabel; },
+                  buffer);
+  }
+}
+
+template <class Arc>
+void SortArcs(Arc *begin, Arc *end, const OLabelCompare<Arc> &comp,
+              std::vector<Arc> *buffer) {
+  if (static_cast<size_t>(end - begin) < kArcSortRadixMinArcs) {
+    std::sort(begin, end, comp);
+  } else {
+    RadixSortArcs(begin, end, [](const Arc &arc) { return arc.olabel; },
+                  buffer);
+  }
+}
+
+}  // namespace internal
+
+// Sorts the arcs of a VectorFst in place. See ArcSort() below.
+template <class Arc, class State, class Compare>
+void ArcSort(VectorFst<Arc, State> *fst, Compare comp) {
+  if (fst->Start() == kNoStateId) return;
+  uint64 props = fst->Properties(kFstProperties, false);
+  std::vector<Arc> buffer;
+  for (StateIterator<VectorFst<Arc, State>> siter(*fst); !siter.Done();
+       siter.Next()) {
+    fst->SortArcs(siter.Value(), [&comp, &buffer](Arc *begin, Arc *end) {
+      if (!std::is_sorted(begin, end, comp)) {
+        internal::SortArcs(begin, end, comp, &buffer);
+      }
+    });
+  }
+  // SortArcs() keeps the label, epsilon, weight and top-sort properties
+  // exact; the sort may only add to them.
+  fst->SetProperties(
+      comp.Properties(props) | fst->Properties(kFstProperties, false),
+      kFstProperties);
+}
+
+// Sorts the arcs of a VectorFst as below, each state on one of 'num_threads'
+// threads (all hardware threads if num_threads <= 0), so 'comp' is called
+// concurrently. The properties counted by each thread are combined at the
+// end.
+template <class Arc, class State, class Compare>
+void ParallelArcSort(VectorFst<Arc, State> *fst, Compare comp,
+                     int num_threads) {
+  typedef typename Arc::StateId StateId;
+
+  if (fst->Start() == kNoStateId) return;
+  const uint64 props = fst->Properties(kFstProperties, false);
+  ThreadPool pool(num_threads);
+  std::vector<std::vector<Arc>> buffers(pool.NumThreads());
+  fst->MapArcs(&pool, [&comp, &buffers](StateId, Arc *begin, Arc *end,
+                                        int thread) {
+    if (!std::is_sorted(begin, end, comp)) {
+      internal::SortArcs(begin, end, comp, &buffers[thread]);
+    }
+  }, comp.Properties(props));
+}
+
 // Sorts the arcs in an FST according to function object 'comp' of
 // type Compare. This version modifies its input.  Comparison function
 // objects ILabelCompare and OLabelCompare are provived by the
@@ -73,14 +204,109 @@ class ArcSortMapper {
 // sorted FST; it takes as argument the input FST's known properties
 // before the sort.
 //
+// States whose arcs are already in order are left untouched, so
+// re-sorting a sorted FST only reads its arcs. With ILabelCompare and
+// OLabelCompare, states with many arcs are radix sorted on the labels, and
+// the arcs of a VectorFst are sorted in place.
+//
 // Complexity:
-// - Time: O(V D log D)
+// - Time: O(V D log D), or O(E) with a label radix sort
 // - Space: O(D)
-// where V = # of states and D = maximum out-degree.
+// where V = # of states, E = # of arcs and D = maximum out-degree.
 template <class Arc, class Compare>
 void ArcSort(MutableFst<Arc> *fst, Compare comp) {
-  ArcSortMapper<Arc, Compare> mapper(*fst, comp);
-  StateMap(fst, mapper);
+  typedef typename Arc::StateId StateId;
+
+  if (auto *vfst = dynamic_cast<VectorFst<Arc> *>(fst)) {
+    ArcSort(vfst, comp);
+    return;
+  }
+  if (fst->Start() == kNoStateId) return;
+  uint64 props = fst->Properties(kFstProperties, false);
+  std::vector<Arc> arcs;
+  std::vector<Arc> buffer;
+  for (StateIterator<MutableFst<Arc>> siter(*fst); !siter.Done();
+       siter.Next()) {
+    StateId s = siter.Value();
+    arcs.clear();
+    arcs.reserve(fst->NumArcs(s));
+    for (ArcIterator<MutableFst<Arc>> aiter(*fst, s); !aiter.Done();
+         aiter.Next()) {
+      arcs.push_back(aiter.Value());
+    }
+    if (std::is_sorted(arcs.begin(), arcs.end(), comp)) continue;
+    internal::SortArcs(arcs.data(), arcs.data() + arcs.size(), comp, &buffer);
+    fst->DeleteArcs(s);
+    for (const Arc &arc : arcs) fst->AddArc(s, arc);
+  }
+  fst->SetProperties(comp.Properties(props), kFstProperties);
+}
+
+// Relabels the input and output labels of an FST as Relabel(fst, ipairs,
+// opairs) in relabel.h does and sorts its arcs according to 'comp', in a
+// single pass over the states that rewrites each state at most once.
+template <class Arc, class Compare>
+void ArcSort(
+    MutableFst<Arc> *fst, Compare comp,
+    const std::vector<std::pair<typename Arc::Label, typename Arc::Label>>
+        &ipairs,
+    const std::vector<std::pair<typename Arc::Label, typename Arc::Label>>
+        &opairs) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Label Label;
+
+  uint64 props = fst->Properties(kFstProperties, false);
+  std::unordered_map<Label, Label> input_map;
+  for (const auto &pair : ipairs) input_map[pair.first] = pair.second;
+  std::unordered_map<Label, Label> output_map;
+  for (const auto &pair : opairs) output_map[pair.first] = pair.second;
+
+  std::vector<Arc> arcs;
+  std::vector<Arc> buffer;
+  for (StateIterator<MutableFst<Arc>> siter(*fst); !siter.Done();
+       siter.Next()) {
+    StateId s = siter.Value();
+    arcs.clear();
+    arcs.reserve(fst->NumArcs(s));
+    bool relabeled = false;
+    for (ArcIterator<MutableFst<Arc>> aiter(*fst, s); !aiter.Done();
+         aiter.Next()) {
+      Arc arc = aiter.Value();
+      auto it = input_map.find(arc.ilabel);
+      if (it != input_map.end() && it->second != arc.ilabel) {
+        if (it->second == kNoLabel) {
+          FSTERROR() << "ArcSort: Input symbol id " << arc.ilabel
+                     << " missing from target vocabulary";
+          fst->SetProperties(kError, kError);
+          return;
+        }
+        arc.ilabel = it->second;
+        relabeled = true;
+      }
+      it = output_map.find(arc.olabel);
+      if (it != output_map.end() && it->second != arc.olabel) {
+        if (it->second == kNoLabel) {
+          FSTERROR() << "ArcSort: Output symbol id " << arc.olabel
+                     << " missing from target vocabulary";
+          fst->SetProperties(kError, kError);
+          return;
+        }
+        arc.olabel = it->second;
+        relabeled = true;
+      }
+      arcs.push_back(arc);
+    }
+    const bool sorted = std::is_sorted(arcs.begin(), arcs.end(), comp);
+    if (sorted && !relabeled) continue;
+    if (!sorted) {
+      internal::SortArcs(arcs.data(), arcs.data() + arcs.size(), comp,
+                         &buffer);
+    }
+    fst->DeleteArcs(s);
+    for (const Arc &arc : arcs) fst->AddArc(s, arc);
+  }
+  fst->SetProperties(comp.Properties(RelabelProperties(props)),
+                     kFstProperties);
 }
 
 typedef CacheOptions ArcSortFstOptions;
@@ -159,7 +385,9 @@ class ArcIterator<ArcSortFst<A, C>>
 template <class A>
 class ILabelCompare {
  public:
-  bool operator()(A arc1, A arc2) const { return arc1.ilabel < arc2.ilabel; }
+  bool operator()(const A &arc1, const A &arc2) const {
+    return arc1.ilabel < arc2.ilabel;
+  }
 
   uint64 Properties(uint64 props) const {
     return (props & kArcSortProperties) | kILabelSorted |
@@ -6,10 +6,14 @@
 #ifndef FST_LIB_CONNECT_H_
 #define FST_LIB_CONNECT_H_
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <vector>
 
 #include <fst/dfs-visit.h>
 #include <fst/mutable-fst.h>
+#include <fst/thread-pool.h>
 #include <fst/union-find.h>
 
 
@@ -199,6 +203,17 @@ inline void SccVisitor<A>::InitVisit(const Fst<A> &fst) {
   lowlink_.reset(new std::vector<StateId>());
   onstack_.reset(new std::vector<bool>());
   scc_stack_.reset(new std::vector<StateId>());
+  // Sizes the per-state vectors at once if the state count is known, rather
+  // than growing them as states are discovered.
+  if (fst.Properties(kExpanded, false)) {
+    StateId nstates = CountStates(fst);
+    if (scc_) scc_->resize(nstates, -1);
+    if (access_) access_->resize(nstates, false);
+    coaccess_->resize(nstates, false);
+    dfnumber_->resize(nstates, -1);
+    lowlink_->resize(nstates, -1);
+    onstack_->resize(nstates, false);
+  }
 }
 
 template <class A>
@@ -263,15 +278,23 @@ inline void SccVisitor<A>::FinishState(StateId s, StateId p, const A *) {
 // - Time:  O(V + E)
 // - Space: O(V + E)
 // where V = # of states and E = # of arcs.
+//
+// The DFS storage is taken from 'scratch', so that trimming several FSTs in
+// turn reuses its memory.
 template <class Arc>
-void Connect(MutableFst<Arc> *fst) {
+void Connect(MutableFst<Arc> *fst, DfsScratch<Arc> *scratch) {
   typedef typename Arc::StateId StateId;
 
+  // Nothing to do if the FST is known to be trimmed.
+  if (fst->Properties(kAccessible | kCoAccessible, false) ==
+      (kAccessible | kCoAccessible)) {
+    return;
+  }
   std::vector<bool> access;
   std::vector<bool> coaccess;
   uint64 props = 0;
   SccVisitor<Arc> scc_visitor(nullptr, &access, &coaccess, &props);
-  DfsVisit(*fst, &scc_visitor);
+  DfsVisit(*fst, &scc_visitor, AnyArcFilter<Arc>(), false, scratch);
   std::vector<StateId> dstates;
   for (StateId s = 0; s < access.size(); ++s) {
     if (!access[s] || !coaccess[s]) dstates.push_back(s);
@@ -280,6 +303,564 @@ void Connect(MutableFst<Arc> *fst) {
   fst->SetProperties(kAccessible | kCoAccessible, kAccessible | kCoAccessible);
 }
 
+template <class Arc>
+void Connect(MutableFst<Arc> *fst) {
+  DfsScratch<Arc> scratch;
+  Connect(fst, &scratch);
+}
+
+namespace internal {
+
+// Number of consecutive states handed to a thread at a time.
+const size_t kParallelSccGrain = 1024;
+
+// Below this number of remaining states, the multithreaded SCC algorithm
+// finishes with Tarjan's algorithm on the calling thread.
+const size_t kParallelSccSerialStates = 1 << 12;
+
+// Maximum number of passes propagating colors before the multithreaded SCC
+// algorithm gives up coloring.
+const int kParallelSccColorRounds = 64;
+
+// The arcs of an ExpandedFst accepted by an arc filter as adjacency arrays in
+// both directions, built with a thread pool. Uses O(V + E) memory.
+template <class StateId>
+class SccGraph {
+ public:
+  template <class Arc, class ArcFilter>
+  SccGraph(const ExpandedFst<Arc> &fst, ArcFilter filter, ThreadPool *pool)
+      : nstates_(fst.NumStates()),
+        offsets_(nstates_ + 1, 0),
+        roffsets_(nstates_ + 1, 0) {
+    std::unique_ptr<std::atomic<size_t>[]> count(
+        new std::atomic<size_t>[nstates_]);
+    pool->ParallelFor(nstates_, [&](size_t s, int) {
+      count[s].store(0, std::memory_order_relaxed);
+    }, kParallelSccGrain);
+    pool->ParallelFor(nstates_, [&](size_t s, int) {
+      size_t narcs = 0;
+      for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        if (!filter(arc)) continue;
+        ++narcs;
+        count[arc.nextstate].fetch_add(1, std::memory_order_relaxed);
+      }
+      offsets_[s + 1] = narcs;
+    }, kParallelSccGrain);
+    for (size_t s = 0; s < nstates_; ++s) {
+      offsets_[s + 1] += offsets_[s];
+      roffsets_[s + 1] =
+          roffsets_[s] + count[s].load(std::memory_order_relaxed);
+    }
+    targets_.resize(offsets_[nstates_]);
+    sources_.resize(roffsets_[nstates_]);
+    // The counts become the positions of the next arcs into each state.
+    pool->ParallelFor(nstates_, [&](size_t s, int) {
+      count[s].store(roffsets_[s], std::memory_order_relaxed);
+    }, kParallelSccGrain);
+    pool->ParallelFor(nstates_, [&](size_t s, int) {
+      size_t i = offsets_[s];
+      for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        if (!filter(arc)) continue;
+        targets_[i++] = arc.nextstate;
+        sources_[count[arc.nextstate].fetch_add(
+            1, std::memory_order_relaxed)] = s;
+      }
+    }, kParallelSccGrain);
+  }
+
+  size_t NumStates() const { return nstates_; }
+
+  // The destination states of the arcs leaving 's', or the source states of
+  // the arcs entering 's' if 'reverse', are in [Begin(), End()).
+  const StateId *Begin(StateId s, bool reverse) const {
+    return reverse ? sources_.data() + roffsets_[s]
+                   : targets_.data() + offsets_[s];
+  }
+
+  const StateId *End(StateId s, bool reverse) const {
+    return reverse ? sources_.data() + roffsets_[s + 1]
+                   : targets_.data() + offsets_[s + 1];
+  }
+
+ private:
+  size_t nstates_;
+  std::vector<size_t> offsets_;
+  std::vector<size_t> roffsets_;
+  std::vector<StateId> targets_;
+  std::vector<StateId> sources_;
+};
+
+// Sets 'reached' for the states reachable from those of 'frontier', which
+// must be set already, through states for which 'allowed' holds, following
+// the arcs backward if 'reverse'. Each BFS level is expanded in parallel.
+template <class StateId, class Allowed>
+void ParallelReach(const SccGraph<StateId> &graph, bool reverse,
+                   Allowed allowed, std::vector<StateId> *frontier,
+                   std::atomic<char> *reached, ThreadPool *pool) {
+  std::vector<std::vector<StateId>> next(pool->NumThreads());
+  while (!frontier->empty()) {
+    pool->ParallelFor(frontier->size(), [&](size_t i, int thread) {
+      const StateId s = (*frontier)[i];
+      for (const StateId *t = graph.Begin(s, reverse);
+           t != graph.End(s, reverse); ++t) {
+        if (reached[*t].load(std::memory_order_relaxed) || !allowed(*t)) {
+          continue;
+        }
+        if (!reached[*t].exchange(1, std::memory_order_relaxed)) {
+          next[thread].push_back(*t);
+        }
+      }
+    }, 64);
+    frontier->clear();
+    for (auto &states : next) {
+      frontier->insert(frontier->end(), states.begin(), states.end());
+      states.clear();
+    }
+  }
+}
+
+// Finds the strongly connected components of an SccGraph with the multistep
+// method of Slota, Rajamanickam and Madduri ("BFS and Coloring-Based Parallel
+// Algorithms for Strongly Connected Components and Related Problems", IPDPS
+// 2014): trivial components are trimmed, the component of the state with
+// the most arcs is found by a forward-backward search, the remaining
+// components by coloring until few states are left, and those by Tarjan's
+// algorithm. Each component is identified by one of its states.
+template <class StateId>
+class ParallelSccFinder {
+ public:
+  ParallelSccFinder(const SccGraph<StateId> &graph, ThreadPool *pool)
+      : graph_(graph),
+        pool_(pool),
+        nstates_(graph.NumStates()),
+        done_(new std::atomic<char>[nstates_]),
+        in_(new std::atomic<StateId>[nstates_]),
+        out_(new std::atomic<StateId>[nstates_]) {}
+
+  // Sets 'rep[s]' to the state identifying the component of 's'.
+  void Find(std::vector<StateId> *rep) {
+    rep_ = rep;
+    rep_->assign(nstates_, kNoStateId);
+    pool_->ParallelFor(nstates_, [this](size_t s, int) {
+      done_[s].store(0, std::memory_order_relaxed);
+    }, kParallelSccGrain);
+    Trim();
+    ForwardBackward();
+    Trim();
+    // Coloring makes little progress on long paths between components, which
+    // are left to Tarjan's algorithm.
+    size_t nremaining = CollectRemaining();
+    while (nremaining > kParallelSccSerialStates && Color()) {
+      const size_t last = nremaining;
+      nremaining = CollectRemaining();
+      if (nremaining > last - last / 8) break;
+    }
+    Tarjan();
+  }
+
+ private:
+  bool Done(StateId s) const {
+    return done_[s].load(std::memory_order_relaxed);
+  }
+
+  // Assigns 's' to the component of 'r' unless it was already assigned;
+  // returns whether it was.
+  bool Assign(StateId s, StateId r) {
+    if (done_[s].exchange(1, std::memory_order_relaxed)) return false;
+    (*rep_)[s] = r;
+    return true;
+  }
+
+  // Removes the remaining states without arcs to or from other remaining
+  // states, each being a component, until none are left.
+  void Trim() {
+    std::vector<std::vector<StateId>> trimmed(pool_->NumThreads());
+    pool_->ParallelFor(nstates_, [&](size_t i, int thread) {
+      const StateId s = i;
+      if (Done(s)) return;
+      StateId in = 0;
+      StateId out = 0;
+      for (const StateId *t = graph_.Begin(s, true); t != graph_.End(s, true);
+           ++t) {
+        if (*t != s && !Done(*t)) ++in;
+      }
+      for (const StateId *t = graph_.Begin(s, false);
+           t != graph_.End(s, false); ++t) {
+        if (*t != s && !Done(*t)) ++out;
+      }
+      in_[s].store(in, std::memory_order_relaxed);
+      out_[s].store(out, std::memory_order_relaxed);
+      if (in == 0 || out == 0) trimmed[thread].push_back(s);
+    }, kParallelSccGrain);
+    std::vector<StateId> frontier;
+    for (const auto &states : trimmed) {
+      frontier.insert(frontier.end(), states.begin(), states.end());
+    }
+    for (const StateId s : frontier) Assign(s, s);
+    std::vector<std::vector<StateId>> next(pool_->NumThreads());
+    while (!frontier.empty()) {
+      pool_->ParallelFor(frontier.size(), [&](size_t i, int thread) {
+        const StateId s = frontier[i];
+        for (const bool reverse : {false, true}) {
+          std::atomic<StateId> *degree = reverse ? out_.get() : in_.get();
+          for (const StateId *t = graph_.Begin(s, reverse);
+               t != graph_.End(s, reverse); ++t) {
+            if (*t == s || Done(*t)) continue;
+            if (degree[*t].fetch_sub(1, std::memory_order_relaxed) == 1 &&
+                Assign(*t, *t)) {
+              next[thread].push_back(*t);
+            }
+          }
+        }
+      }, 64);
+      frontier.clear();
+      for (auto &states : next) {
+        frontier.insert(frontier.end(), states.begin(), states.end());
+        states.clear();
+      }
+    }
+  }
+
+  // Finds the component of the remaining state with the largest product of
+  // in- and out-degrees, as computed by Trim(): the states both reachable
+  // from it and reaching it.
+  void ForwardBackward() {
+    const int nthreads = pool_->NumThreads();
+    std::vector<StateId> best(nthreads, kNoStateId);
+    std::vector<double> best_degree(nthreads, 0.0);
+    pool_->ParallelForRange(nstates_, [&](size_t begin, size_t end,
+                                          int thread) {
+      for (size_t i = begin; i < end; ++i) {
+        const StateId s = i;
+        if (Done(s)) continue;
+        const double degree =
+            static_cast<double>(in_[s].load(std::memory_order_relaxed)) *
+            out_[s].load(std::memory_order_relaxed);
+        if (best[thread] == kNoStateId || degree > best_degree[thread] ||
+            (degree == best_degree[thread] && s < best[thread])) {
+          best[thread] = s;
+          best_degree[thread] = degree;
+        }
+      }
+    });
+    StateId pivot = kNoStateId;
+    double pivot_degree = 0.0;
+    for (int i = 0; i < nthreads; ++i) {
+      if (best[i] == kNoStateId) continue;
+      if (pivot == kNoStateId || best_degree[i] > pivot_degree ||
+          (best_degree[i] == pivot_degree && best[i] < pivot)) {
+        pivot = best[i];
+        pivot_degree = best_degree[i];
+      }
+    }
+    if (pivot == kNoStateId) return;
+    std::unique_ptr<std::atomic<char>[]> forward(
+        new std::atomic<char>[nstates_]);
+    std::unique_ptr<std::atomic<char>[]> backward(
+        new std::atomic<char>[nstates_]);
+    pool_->ParallelFor(nstates_, [&](size_t i, int) {
+      const StateId s = i;
+      forward[s].store(s == pivot, std::memory_order_relaxed);
+      backward[s].store(s == pivot, std::memory_order_relaxed);
+    }, kParallelSccGrain);
+    const auto remaining = [this](StateId s) { return !Done(s); };
+    std::vector<StateId> frontier(1, pivot);
+    ParallelReach(graph_, false, remaining, &frontier, forward.get(), pool_);
+    frontier.assign(1, pivot);
+    ParallelReach(graph_, true, remaining, &frontier, backward.get(), pool_);
+    pool_->ParallelFor(nstates_, [&](size_t s, int) {
+      if (forward[s].load(std::memory_order_relaxed) &&
+          backward[s].load(std::memory_order_relaxed)) {
+        Assign(s, pivot);
+      }
+    }, kParallelSccGrain);
+  }
+
+  // Lists the remaining states in increasing order and returns their count.
+  size_t CollectRemaining() {
+    const size_t nranges = pool_->NumThreads();
+    std::vector<std::vector<StateId>> ranges(nranges);
+    pool_->ParallelFor(nranges, [&](size_t r, int) {
+      for (size_t s = r * nstates_ / nranges;
+           s < (r + 1) * nstates_ / nranges; ++s) {
+        if (!Done(s)) ranges[r].push_back(s);
+      }
+    });
+    remaining_.clear();
+    for (const auto &states : ranges) {
+      remaining_.insert(remaining_.end(), states.begin(), states.end());
+    }
+    return remaining_.size();
+  }
+
+  // Propagates the largest state ID along the arcs between the remaining
+  // states until it is stable. A state keeping its own ID is then the
+  // largest of its component, whose other states are those with that color
+  // from which it is reachable. Returns false, having assigned no state, if
+  // the IDs are not stable after kParallelSccColorRounds passes.
+  bool Color() {
+    std::unique_ptr<std::atomic<StateId>[]> color(
+        new std::atomic<StateId>[nstates_]);
+    pool_->ParallelFor(remaining_.size(), [&](size_t i, int) {
+      color[remaining_[i]].store(remaining_[i], std::memory_order_relaxed);
+    }, kParallelSccGrain);
+    std::atomic<bool> changed(true);
+    for (int round = 0; changed.load(std::memory_order_relaxed); ++round) {
+      if (round == kParallelSccColorRounds) return false;
+      changed.store(false, std::memory_order_relaxed);
+      pool_->ParallelFor(remaining_.size(), [&](size_t i, int) {
+        const StateId s = remaining_[i];
+        const StateId c = color[s].load(std::memory_order_relaxed);
+        for (const StateId *t = graph_.Begin(s, false);
+             t != graph_.End(s, false); ++t) {
+          if (Done(*t)) continue;
+          StateId current = color[*t].load(std::memory_order_relaxed);
+          while (current < c &&
+                 !color[*t].compare_exchange_weak(
+                     current, c, std::memory_order_relaxed)) {
+          }
+          if (current < c) changed.store(true, std::memory_order_relaxed);
+        }
+      }, kParallelSccGrain);
+    }
+    std::vector<std::vector<StateId>> roots(pool_->NumThreads());
+    pool_->ParallelFor(remaining_.size(), [&](size_t i, int thread) {
+      const StateId s = remaining_[i];
+      if (color[s].load(std::memory_order_relaxed) == s) {
+        roots[thread].push_back(s);
+      }
+    }, kParallelSccGrain);
+    std::vector<StateId> all_roots;
+    for (const auto &states : roots) {
+      all_roots.insert(all_roots.end(), states.begin(), states.end());
+    }
+    // The colors are only read from here on, and each search only assigns
+    // states of its own color.
+    pool_->ParallelFor(all_roots.size(), [&](size_t i, int) {
+      const StateId r = all_roots[i];
+      std::vector<StateId> stack(1, r);
+      Assign(r, r);
+      while (!stack.empty()) {
+        const StateId s = stack.back();
+        stack.pop_back();
+        for (const StateId *t = graph_.Begin(s, true);
+             t != graph_.End(s, true); ++t) {
+          if (!Done(*t) && color[*t].load(std::memory_order_relaxed) == r &&
+              Assign(*t, r)) {
+            stack.push_back(*t);
+          }
+        }
+      }
+    });
+    return true;
+  }
+
+  // Finds the components of the remaining states with Tarjan's algorithm.
+  void Tarjan() {
+    std::vector<StateId> dfnumber(nstates_, kNoStateId);
+    std::vector<StateId> lowlink(nstates_, kNoStateId);
+    std::vector<bool> onstack(nstates_, false);
+    std::vector<StateId> scc_stack;
+    // DFS stack of states and positions of their next arcs.
+    std::vector<std::pair<StateId, const StateId *>> dfs_stack;
+    StateId count = 0;
+    for (const StateId root : remaining_) {
+      if (Done(root) || dfnumber[root] != kNoStateId) continue;
+      dfnumber[root] = lowlink[root] = count++;
+      scc_stack.push_back(root);
+      onstack[root] = true;
+      dfs_stack.emplace_back(root, graph_.Begin(root, false));
+      while (!dfs_stack.empty()) {
+        const StateId s = dfs_stack.back().first;
+        const StateId *&t = dfs_stack.back().second;
+        if (t != graph_.End(s, false)) {
+          const StateId u = *t++;
+          if (Done(u)) continue;
+          if (dfnumber[u] == kNoStateId) {
+            dfnumber[u] = lowlink[u] = count++;
+            scc_stack.push_back(u);
+            onstack[u] = true;
+            dfs_stack.emplace_back(u, graph_.Begin(u, false));
+          } else if (onstack[u]) {
+            lowlink[s] = std::min(lowlink[s], dfnumber[u]);
+          }
+          continue;
+        }
+        dfs_stack.pop_back();
+        if (!dfs_stack.empty()) {
+          const StateId p = dfs_stack.back().first;
+          lowlink[p] = std::min(lowlink[p], lowlink[s]);
+        }
+        if (lowlink[s] == dfnumber[s]) {
+          StateId u;
+          do {
+            u = scc_stack.back();
+            scc_stack.pop_back();
+            onstack[u] = false;
+            Assign(u, s);
+          } while (u != s);
+        }
+      }
+    }
+  }
+
+  const SccGraph<StateId> &graph_;
+  ThreadPool *pool_;
+  size_t nstates_;
+  std::vector<StateId> *rep_;
+  // Whether a state has been assigned to a component.
+  std::unique_ptr<std::atomic<char>[]> done_;
+  // In- and out-degrees of the states among the remaining states.
+  std::unique_ptr<std::atomic<StateId>[]> in_;
+  std::unique_ptr<std::atomic<StateId>[]> out_;
+  std::vector<StateId> remaining_;
+};
+
+}  // namespace internal
+
+// Computes the strongly connected components of an ExpandedFst, restricted
+// to the arcs accepted by 'filter', on 'num_threads' threads (all hardware
+// threads if num_threads <= 0). Sets 'scc[s]' to the component number of
+// state 's', the components being numbered in topological order as by
+// SccVisitor, and returns the number of components. The components are
+// those found by SccVisitor, but may be numbered differently when several
+// topological orders exist. The FST is read concurrently, which must be
+// safe for its type (e.g., VectorFst or ConstFst), and the arcs are copied
+// into adjacency arrays in both directions. With one thread, this uses
+// SccVisitor.
+template <class Arc, class ArcFilter>
+typename Arc::StateId ParallelScc(const ExpandedFst<Arc> &fst,
+                                  std::vector<typename Arc::StateId> *scc,
+                                  ArcFilter filter, int num_threads) {
+  typedef typename Arc::StateId StateId;
+
+  ThreadPool pool(num_threads);
+  if (pool.NumThreads() == 1) {
+    uint64 props = 0;
+    SccVisitor<Arc> scc_visitor(scc, nullptr, nullptr, &props);
+    DfsVisit(fst, &scc_visitor, filter);
+    return scc->empty() ? 0 : *std::max_element(scc->begin(), scc->end()) + 1;
+  }
+  const internal::SccGraph<StateId> graph(fst, filter, &pool);
+  const size_t nstates = graph.NumStates();
+  std::vector<StateId> rep;
+  internal::ParallelSccFinder<StateId>(graph, &pool).Find(&rep);
+
+  // Numbers the components in topological order, level by level with Kahn's
+  // algorithm, each level in increasing order of representative.
+  std::unique_ptr<std::atomic<StateId>[]> in(new std::atomic<StateId>[nstates]);
+  std::unique_ptr<std::atomic<size_t>[]> count(
+      new std::atomic<size_t>[nstates]);
+  pool.ParallelFor(nstates, [&](size_t s, int) {
+    in[s].store(0, std::memory_order_relaxed);
+    count[s].store(0, std::memory_order_relaxed);
+  }, internal::kParallelSccGrain);
+  pool.ParallelFor(nstates, [&](size_t s, int) {
+    count[rep[s]].fetch_add(1, std::memory_order_relaxed);
+    for (const StateId *t = graph.Begin(s, false); t != graph.End(s, false);
+         ++t) {
+      if (rep[*t] != rep[s]) in[rep[*t]].fetch_add(1, std::memory_order_relaxed);
+    }
+  }, internal::kParallelSccGrain);
+  // The states of the component of 'r' are members[begin[r] .. begin[r + 1]).
+  std::vector<size_t> begin(nstates + 1, 0);
+  std::vector<StateId> frontier;
+  for (size_t r = 0; r < nstates; ++r) {
+    const size_t size = count[r].load(std::memory_order_relaxed);
+    begin[r + 1] = begin[r] + size;
+    count[r].store(begin[r], std::memory_order_relaxed);
+    if (size > 0 && in[r].load(std::memory_order_relaxed) == 0) {
+      frontier.push_back(r);
+    }
+  }
+  std::vector<StateId> members(nstates);
+  pool.ParallelFor(nstates, [&](size_t s, int) {
+    members[count[rep[s]].fetch_add(1, std::memory_order_relaxed)] = s;
+  }, internal::kParallelSccGrain);
+  std::vector<StateId> number(nstates, kNoStateId);
+  std::vector<std::vector<StateId>> next(pool.NumThreads());
+  StateId nscc = 0;
+  while (!frontier.empty()) {
+    for (const StateId r : frontier) number[r] = nscc++;
+    pool.ParallelFor(frontier.size(), [&](size_t i, int thread) {
+      const StateId r = frontier[i];
+      for (size_t j = begin[r]; j < begin[r + 1]; ++j) {
+        const StateId s = members[j];
+        for (const StateId *t = graph.Begin(s, false);
+             t != graph.End(s, false); ++t) {
+          if (rep[*t] != r &&
+              in[rep[*t]].fetch_sub(1, std::memory_order_relaxed) == 1) {
+            next[thread].push_back(rep[*t]);
+          }
+        }
+      }
+    }, 64);
+    frontier.clear();
+    for (auto &states : next) {
+      frontier.insert(frontier.end(), states.begin(), states.end());
+      states.clear();
+    }
+    std::sort(frontier.begin(), frontier.end());
+  }
+  scc->resize(nstates);
+  pool.ParallelFor(nstates, [&](size_t s, int) {
+    (*scc)[s] = number[rep[s]];
+  }, internal::kParallelSccGrain);
+  return nscc;
+}
+
+// Trims an FST as above on 'num_threads' threads (all hardware threads if
+// num_threads <= 0), finding the accessible and coaccessible states by
+// breadth-first searches from the initial and final states whose levels are
+// expanded in parallel. The FST is read concurrently, which must be safe for
+// its type (e.g., VectorFst), and its arcs are copied into adjacency arrays
+// in both directions.
+template <class Arc>
+void ParallelConnect(MutableFst<Arc> *fst, int num_threads) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+
+  if (fst->Properties(kAccessible | kCoAccessible, false) ==
+      (kAccessible | kCoAccessible)) {
+    return;
+  }
+  ThreadPool pool(num_threads);
+  const ExpandedFst<Arc> &ifst = *fst;
+  const internal::SccGraph<StateId> graph(ifst, AnyArcFilter<Arc>(), &pool);
+  const size_t nstates = graph.NumStates();
+  std::unique_ptr<std::atomic<char>[]> access(new std::atomic<char>[nstates]);
+  std::unique_ptr<std::atomic<char>[]> coaccess(
+      new std::atomic<char>[nstates]);
+  const StateId start = ifst.Start();
+  std::vector<std::vector<StateId>> finals(pool.NumThreads());
+  pool.ParallelFor(nstates, [&](size_t i, int thread) {
+    const StateId s = i;
+    access[s].store(s == start, std::memory_order_relaxed);
+    const bool final = ifst.Final(s) != Weight::Zero();
+    coaccess[s].store(final, std::memory_order_relaxed);
+    if (final) finals[thread].push_back(s);
+  }, internal::kParallelSccGrain);
+  const auto any = [](StateId) { return true; };
+  std::vector<StateId> frontier;
+  if (start != kNoStateId) frontier.push_back(start);
+  internal::ParallelReach(graph, false, any, &frontier, access.get(), &pool);
+  for (const auto &states : finals) {
+    frontier.insert(frontier.end(), states.begin(), states.end());
+  }
+  internal::ParallelReach(graph, true, any, &frontier, coaccess.get(), &pool);
+  std::vector<StateId> dstates;
+  for (size_t s = 0; s < nstates; ++s) {
+    if (!access[s].load(std::memory_order_relaxed) ||
+        !coaccess[s].load(std::memory_order_relaxed)) {
+      dstates.push_back(s);
+    }
+  }
+  fst->DeleteStates(dstates);
+  fst->SetProperties(kAccessible | kCoAccessible, kAccessible | kCoAccessible);
+}
+
 // Returns an acyclic FST where each SCC in the input FST has been
 // condensed to a single state with transitions between SCCs retained
 // and within SCCs dropped.  Also returns the mapping from an input
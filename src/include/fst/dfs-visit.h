@@ -7,10 +7,11 @@
 #ifndef FST_LIB_DFS_VISIT_H_
 #define FST_LIB_DFS_VISIT_H_
 
-#include <stack>
+#include <type_traits>
 #include <vector>
 
 #include <fst/arcfilter.h>
+#include <fst/fst-decl.h>
 #include <fst/fst.h>
 
 
@@ -53,41 +54,123 @@ const int kDfsWhite = 0;  // Undiscovered
 const int kDfsGrey = 1;   // Discovered & unfinished
 const int kDfsBlack = 2;  // Finished
 
-// An Fst state's DFS stack state
+// Whether DfsVisit() accesses the arcs of an F through the data returned by
+// InitArcIterator(), as the generic ArcIterator<F> does, rather than through
+// the specialized ArcIterator<F>. The latter may avoid work such as caching
+// each state (e.g., for CompactFst or ReplaceFst), so the data is only used
+// when ArcIterator<F> is the generic one or iterates over the same arc array.
 template <class F>
-struct DfsState {
+struct DfsUsesArcIteratorData
+    : std::is_constructible<ArcIterator<F>,
+                            const ArcIteratorData<typename F::Arc> &> {};
+
+template <class A, class S>
+struct DfsUsesArcIteratorData<VectorFst<A, S>> : std::true_type {};
+
+template <class A, class U>
+struct DfsUsesArcIteratorData<ConstFst<A, U>> : std::true_type {};
+
+// Wraps a specialized ArcIterator<F> for use by DfsState.
+template <class F>
+class DfsArcIterator : public ArcIteratorBase<typename F::Arc> {
+ public:
   typedef typename F::Arc Arc;
   typedef typename Arc::StateId StateId;
 
-  DfsState(const F &fst, StateId s) : state_id(s), arc_iter(fst, s) {}
+  DfsArcIterator(const F &fst, StateId s) : aiter_(fst, s) {}
+
+ private:
+  bool Done_() const override { return aiter_.Done(); }
+  const Arc &Value_() const override { return aiter_.Value(); }
+  void Next_() override { aiter_.Next(); }
+  size_t Position_() const override { return aiter_.Position(); }
+  void Reset_() override { aiter_.Reset(); }
+  void Seek_(size_t a) override { aiter_.Seek(a); }
+  uint32 Flags_() const override { return aiter_.Flags(); }
+  void SetFlags_(uint32 flags, uint32 mask) override {
+    aiter_.SetFlags(flags, mask);
+  }
+
+  ArcIterator<F> aiter_;
+};
 
-  void *operator new(size_t size, MemoryPool<DfsState<F>> *pool) {
-    return pool->Allocate();
+// An Fst state's DFS stack state: the state and its arcs, accessed directly
+// if the Fst exposes them as an array (e.g., an ExpandedFst) and through an
+// arc iterator otherwise: the one returned by InitArcIterator() or, if F has
+// a specialized ArcIterator<F>, that one (see DfsUsesArcIteratorData).
+template <class Arc>
+struct DfsState {
+  typedef typename Arc::StateId StateId;
+
+  template <class F>
+  void Init(const F &fst, StateId s) {
+    state_id = s;
+    pos = 0;
+    if (DfsUsesArcIteratorData<F>::value) {
+      ArcIteratorData<Arc> data;
+      fst.InitArcIterator(s, &data);
+      base = data.base;
+      arcs = data.arcs;
+      narcs = data.narcs;
+      ref_count = data.ref_count;
+    } else {
+      base = new DfsArcIterator<F>(fst, s);
+      arcs = nullptr;
+      narcs = 0;
+      ref_count = nullptr;
+    }
   }
 
-  static void Destroy(DfsState<F> *dfs_state,
-                      MemoryPool<DfsState<F>> *pool) {
-    if (dfs_state) {
-      dfs_state->~DfsState<F>();
-      pool->Free(dfs_state);
+  // Releases the arc iterator or the reference to the arcs.
+  void Destroy() {
+    if (base) {
+      delete base;
+    } else if (ref_count) {
+      --(*ref_count);
     }
   }
 
-  StateId state_id;         // Fst state ...
-  ArcIterator<F> arc_iter;  // and its corresponding arcs
+  bool Done() const { return base ? base->Done() : pos >= narcs; }
+
+  const Arc &Value() const { return base ? base->Value() : arcs[pos]; }
+
+  void Next() {
+    if (base) {
+      base->Next();
+    } else {
+      ++pos;
+    }
+  }
+
+  StateId state_id;            // Fst state ...
+  ArcIteratorBase<Arc> *base;  // and its specialized arc iterator if non-zero
+  const Arc *arcs;             // o.w. its arcs
+  size_t narcs;                // ... arc count
+  size_t pos;                  // ... current arc position
+  int *ref_count;              // ... and reference count if non-zero
+};
+
+// Storage used by DfsVisit(): the state colors and the DFS execution stack.
+// Passing the same object to successive calls reuses their memory.
+template <class Arc>
+struct DfsScratch {
+  std::vector<char> state_color;
+  std::vector<DfsState<Arc>> state_stack;
 };
 
 // Performs depth-first visitation. Visitor class argument determines
 // actions and contains any return data. ArcFilter determines arcs
 // that are considered.  If 'access_only' is true, performs visitation
-// only to states accessible from the initial state.
+// only to states accessible from the initial state. The DFS stack is a
+// flat array, so no memory is allocated per visited state other than by
+// Fsts whose arc iterators do.
 //
 // Note this is similar to Visit() in visit.h called with a LIFO
 // queue except this version has a Visitor class specialized and
 // augmented for a DFS.
 template <class F, class V, class ArcFilter>
-void DfsVisit(const F &fst, V *visitor, ArcFilter filter,
-              bool access_only = false) {
+void DfsVisit(const F &fst, V *visitor, ArcFilter filter, bool access_only,
+              DfsScratch<typename F::Arc> *scratch) {
   typedef typename F::Arc Arc;
   typedef typename Arc::StateId StateId;
 
@@ -99,9 +182,12 @@ void DfsVisit(const F &fst, V *visitor, ArcFilter filter,
     return;
   }
 
-  std::vector<char> state_color;          // Fst state DFS status
-  std::stack<DfsState<F> *> state_stack;  // DFS execution stack
-  MemoryPool<DfsState<F>> state_pool;     // Pool for DFSStates
+  // Fst state DFS status
+  std::vector<char> &state_color = scratch->state_color;
+  // DFS execution stack; its top is the last element.
+  std::vector<DfsState<Arc>> &state_stack = scratch->state_stack;
+  state_color.clear();
+  state_stack.clear();
 
   StateId nstates = start + 1;  // # of known states in general case
   bool expanded = false;
@@ -119,38 +205,36 @@ void DfsVisit(const F &fst, V *visitor, ArcFilter filter,
   // Iterate over trees in DFS forest.
   for (StateId root = start; dfs && root < nstates;) {
     state_color[root] = kDfsGrey;
-    state_stack.push(new (&state_pool) DfsState<F>(fst, root));
+    state_stack.emplace_back();
+    state_stack.back().Init(fst, root);
     dfs = visitor->InitState(root, root);
     while (!state_stack.empty()) {
-      DfsState<F> *dfs_state = state_stack.top();
-      StateId s = dfs_state->state_id;
+      DfsState<Arc> &dfs_state = state_stack.back();
+      StateId s = dfs_state.state_id;
       if (s >= state_color.size()) {
         nstates = s + 1;
         state_color.resize(nstates, kDfsWhite);
       }
-      ArcIterator<F> &aiter = dfs_state->arc_iter;
-      if (!dfs || aiter.Done()) {
+      if (!dfs || dfs_state.Done()) {
         state_color[s] = kDfsBlack;
-        DfsState<F>::Destroy(dfs_state, &state_pool);
-        state_stack.pop();
+        dfs_state.Destroy();
+        state_stack.pop_back();
         if (!state_stack.empty()) {
-          DfsState<F> *parent_state = state_stack.top();
-          StateId p = parent_state->state_id;
-          ArcIterator<F> &piter = parent_state->arc_iter;
-          visitor->FinishState(s, p, &piter.Value());
-          piter.Next();
+          DfsState<Arc> &parent_state = state_stack.back();
+          visitor->FinishState(s, parent_state.state_id, &parent_state.Value());
+          parent_state.Next();
         } else {
           visitor->FinishState(s, kNoStateId, nullptr);
         }
         continue;
       }
-      const Arc &arc = aiter.Value();
+      const Arc &arc = dfs_state.Value();
       if (arc.nextstate >= state_color.size()) {
         nstates = arc.nextstate + 1;
         state_color.resize(nstates, kDfsWhite);
       }
       if (!filter(arc)) {
-        aiter.Next();
+        dfs_state.Next();
         continue;
       }
       int next_color = state_color[arc.nextstate];
@@ -160,16 +244,21 @@ void DfsVisit(const F &fst, V *visitor, ArcFilter filter,
           dfs = visitor->TreeArc(s, arc);
           if (!dfs) break;
           state_color[arc.nextstate] = kDfsGrey;
-          state_stack.push(new (&state_pool) DfsState<F>(fst, arc.nextstate));
-          dfs = visitor->InitState(arc.nextstate, root);
+          // 'dfs_state' and 'arc' may be invalidated by the push.
+          {
+            StateId nextstate = arc.nextstate;
+            state_stack.emplace_back();
+            state_stack.back().Init(fst, nextstate);
+            dfs = visitor->InitState(nextstate, root);
+          }
           break;
         case kDfsGrey:
           dfs = visitor->BackArc(s, arc);
-          aiter.Next();
+          dfs_state.Next();
           break;
         case kDfsBlack:
           dfs = visitor->ForwardOrCrossArc(s, arc);
-          aiter.Next();
+          dfs_state.Next();
           break;
       }
     }
@@ -195,6 +284,13 @@ void DfsVisit(const F &fst, V *visitor, ArcFilter filter,
   visitor->FinishVisit();
 }
 
+template <class F, class V, class ArcFilter>
+void DfsVisit(const F &fst, V *visitor, ArcFilter filter,
+              bool access_only = false) {
+  DfsScratch<typename F::Arc> scratch;
+  DfsVisit(fst, visitor, filter, access_only, &scratch);
+}
+
 template <class Arc, class V>
 void DfsVisit(const Fst<Arc> &fst, V *visitor) {
   DfsVisit(fst, visitor, AnyArcFilter<Arc>());
@@ -305,7 +305,8 @@ class EncodeMapper {
     uint64 outprops = inprops;
     if (error_) outprops |= kError;
 
-    uint64 mask = kFstProperties;
+    // The input label is always replaced by its encoding.
+    uint64 mask = kILabelInvariantProperties;
     if (flags_ & kEncodeLabels) {
       mask &= kILabelInvariantProperties & kOLabelInvariantProperties;
     }
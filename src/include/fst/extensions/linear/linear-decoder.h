@@ -0,0 +1,304 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Decoders that find the best output of a linear model for input sentences
+// directly on `LinearFstData`, without composing with a `LinearTaggerFst` or
+// `LinearClassifierFst` and running `ShortestPath()`.
+
+#ifndef FST_EXTENSIONS_LINEAR_LINEAR_DECODER_H_
+#define FST_EXTENSIONS_LINEAR_LINEAR_DECODER_H_
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include <fst/compat.h>
+#include <fst/weight.h>
+
+#include <fst/extensions/linear/linear-fst-data.h>
+#include <fst/extensions/linear/linear-fst.h>
+
+namespace fst {
+
+// Viterbi decoder of a linear tagger. For an input sentence (a string of
+// positive input labels), `Decode()` searches the same states and computes
+// the same path weights as the shortest path of the composition of the
+// sentence with `LinearTaggerFst<A>(data)`, but without the state caching and
+// arc iteration of the delayed FST; only paths of equal weight may be broken
+// differently. The weight must have the path property.
+// The distinct states at each position are kept in a hash set and their
+// back-pointers in flat vectors; these are reused across calls, so an object
+// should not be shared between threads.
+template <class A>
+class LinearTaggerDecoder {
+ public:
+  typedef A Arc;
+  typedef typename A::Label Label;
+  typedef typename A::Weight Weight;
+
+  explicit LinearTaggerDecoder(std::shared_ptr<const LinearFstData<A>> data)
+      : data_(std::move(data)),
+        delay_(data_->MaxFutureSize()),
+        num_groups_(data_->NumGroups()),
+        tuples_(0, TupleHash(this), TupleEqual(this)) {}
+
+  explicit LinearTaggerDecoder(const LinearTaggerFst<A> &fst)
+      : LinearTaggerDecoder(fst.Data()) {}
+
+  // Finds the best tagging of `words`, writing its output labels (one per
+  // word) to `tags`. Returns the weight of the tagging, or `Weight::Zero()`
+  // with empty `tags` if there is none (e.g. a word is out of range).
+  Weight Decode(const std::vector<Label> &words, std::vector<Label> *tags);
+
+  // Decodes each of `sentences` in turn; `tags` and `weights` are resized to
+  // the number of sentences.
+  void Decode(const std::vector<std::vector<Label>> &sentences,
+              std::vector<std::vector<Label>> *tags,
+              std::vector<Weight> *weights) {
+    tags->resize(sentences.size());
+    weights->resize(sentences.size());
+    for (size_t i = 0; i < sentences.size(); ++i)
+      (*weights)[i] = Decode(sentences[i], &(*tags)[i]);
+  }
+
+ private:
+  // Hashes and compares trie state tuples stored in `next_` by index.
+  class TupleHash {
+   public:
+    explicit TupleHash(const LinearTaggerDecoder *decoder)
+        : decoder_(decoder) {}
+
+    size_t operator()(size_t i) const {
+      const Label *tuple = decoder_->NextTuple(i);
+      size_t h = 0;
+      for (size_t g = 0; g < decoder_->num_groups_; ++g)
+        h = h * 7853 + static_cast<size_t>(tuple[g]);
+      return h;
+    }
+
+   private:
+    const LinearTaggerDecoder *decoder_;
+  };
+
+  class TupleEqual {
+   public:
+    explicit TupleEqual(const LinearTaggerDecoder *decoder)
+        : decoder_(decoder) {}
+
+    bool operator()(size_t i, size_t j) const {
+      return std::equal(decoder_->NextTuple(i),
+                        decoder_->NextTuple(i) + decoder_->num_groups_,
+                        decoder_->NextTuple(j));
+    }
+
+   private:
+    const LinearTaggerDecoder *decoder_;
+  };
+
+  const Label *NextTuple(size_t i) const {
+    return next_.data() + i * num_groups_;
+  }
+
+  std::shared_ptr<const LinearFstData<A>> data_;
+  size_t delay_;
+  size_t num_groups_;
+  // Input padded as the buffer of `LinearTaggerFstImpl` sees it: `delay_`
+  // `kStartOfSentence`s, the words and `delay_` `kEndOfSentence`s.
+  std::vector<Label> buffer_;
+  // Trie state tuples and weights of the states at the current and next
+  // positions.
+  std::vector<Label> current_, next_;
+  std::vector<Weight> current_weights_, next_weights_;
+  // Back-pointers and output labels of the best arcs into the states at all
+  // positions; `offsets_[t]` is the index of the first state at position t.
+  std::vector<size_t> backpointers_, offsets_;
+  std::vector<Label> olabels_;
+  std::unordered_set<size_t, TupleHash, TupleEqual> tuples_;
+
+  LinearTaggerDecoder(const LinearTaggerDecoder &) = delete;
+  LinearTaggerDecoder &operator=(const LinearTaggerDecoder &) = delete;
+};
+
+template <class A>
+typename A::Weight LinearTaggerDecoder<A>::Decode(
+    const std::vector<Label> &words, std::vector<Label> *tags) {
+  typedef LinearFstData<A> Data;
+  tags->clear();
+  for (const auto word : words) {
+    if (word < data_->MinInputLabel() || word > data_->MaxInputLabel())
+      return Weight::Zero();
+  }
+  current_.clear();
+  data_->EncodeStartState(&current_);
+  if (words.empty())
+    return data_->FinalWeight(current_.begin(), current_.end());
+  buffer_.assign(delay_, Data::kStartOfSentence);
+  buffer_.insert(buffer_.end(), words.begin(), words.end());
+  buffer_.insert(buffer_.end(), delay_, Data::kEndOfSentence);
+  current_weights_.assign(1, Weight::One());
+  backpointers_.assign(1, 0);
+  olabels_.assign(1, Data::kStartOfSentence);
+  offsets_.assign(1, 0);
+  // Each step consumes the next word (or a flush after the last one) and
+  // outputs the tag of the word `delay_` positions back.
+  const size_t num_steps = words.size() + delay_;
+  for (size_t t = 0; t < num_steps; ++t) {
+    const auto buffer_end = buffer_.cbegin() + t + delay_;
+    const Label ilabel = *buffer_end;
+    const Label observed = buffer_[t];
+    // Only an epsilon is output while the buffer is being filled.
+    const Label *olabel_begin = &Data::kStartOfSentence;
+    const Label *olabel_end = olabel_begin + 1;
+    if (observed != Data::kStartOfSentence) {
+      const auto range = data_->PossibleOutputLabels(observed);
+      if (range.first == range.second) return Weight::Zero();
+      olabel_begin = &*range.first;
+      olabel_end = olabel_begin + (range.second - range.first);
+    }
+    next_.clear();
+    next_weights_.clear();
+    tuples_.clear();
+    const size_t offset = offsets_.back();
+    offsets_.push_back(olabels_.size());
+    for (size_t i = 0; i < current_weights_.size(); ++i) {
+      const auto tuple_begin = current_.cbegin() + i * num_groups_;
+      for (const Label *olabel = olabel_begin; olabel != olabel_end;
+           ++olabel) {
+        Weight weight = Weight::One();
+        data_->TakeTransition(buffer_end, tuple_begin,
+                              tuple_begin + num_groups_, ilabel, *olabel,
+                              &next_, &weight);
+        weight = Times(current_weights_[i], weight);
+        const size_t id = next_weights_.size();
+        auto insert = tuples_.insert(id);
+        if (insert.second) {
+          next_weights_.push_back(weight);
+          backpointers_.push_back(offset + i);
+          olabels_.push_back(*olabel);
+        } else {
+          next_.resize(next_.size() - num_groups_);
+          const size_t j = *insert.first;
+          if (NaturalLess<Weight>()(weight, next_weights_[j])) {
+            next_weights_[j] = weight;
+            backpointers_[offsets_.back() + j] = offset + i;
+            olabels_[offsets_.back() + j] = *olabel;
+          }
+        }
+      }
+    }
+    current_.swap(next_);
+    current_weights_.swap(next_weights_);
+    if (current_weights_.empty()) return Weight::Zero();
+  }
+  // Picks the best final state; the first one wins ties.
+  Weight best = Weight::Zero();
+  size_t best_state = 0;
+  for (size_t i = 0; i < current_weights_.size(); ++i) {
+    const auto tuple_begin = current_.cbegin() + i * num_groups_;
+    const Weight weight =
+        Times(current_weights_[i],
+              data_->FinalWeight(tuple_begin, tuple_begin + num_groups_));
+    if (NaturalLess<Weight>()(weight, best)) {
+      best = weight;
+      best_state = i;
+    }
+  }
+  if (best == Weight::Zero()) return best;
+  for (size_t s = offsets_.back() + best_state; s != 0; s = backpointers_[s]) {
+    if (olabels_[s] != Data::kStartOfSentence) tags->push_back(olabels_[s]);
+  }
+  std::reverse(tags->begin(), tags->end());
+  return best;
+}
+
+// Decoder of a linear classifier. `Decode()` scores each class the same way
+// as the path through `LinearClassifierFst<A>(data, num_classes)` that
+// predicts it, and returns the best one. Not to be shared between threads.
+template <class A>
+class LinearClassifierDecoder {
+ public:
+  typedef A Arc;
+  typedef typename A::Label Label;
+  typedef typename A::Weight Weight;
+
+  LinearClassifierDecoder(std::shared_ptr<const LinearFstData<A>> data,
+                          size_t num_classes)
+      : data_(std::move(data)),
+        num_classes_(num_classes),
+        num_groups_(data_->NumGroups() / num_classes_) {}
+
+  explicit LinearClassifierDecoder(const LinearClassifierFst<A> &fst)
+      : LinearClassifierDecoder(fst.Data(), fst.NumClasses()) {}
+
+  // Finds the best class of `words`, writing it to `pred`. Returns its
+  // weight, or `Weight::Zero()` with `pred` set to `kNoLabel` if there is
+  // none. Ties go to the smaller class.
+  Weight Decode(const std::vector<Label> &words, Label *pred);
+
+  // Decodes each of `sentences` in turn; `preds` and `weights` are resized
+  // to the number of sentences.
+  void Decode(const std::vector<std::vector<Label>> &sentences,
+              std::vector<Label> *preds, std::vector<Weight> *weights) {
+    preds->resize(sentences.size());
+    weights->resize(sentences.size());
+    for (size_t i = 0; i < sentences.size(); ++i)
+      (*weights)[i] = Decode(sentences[i], &(*preds)[i]);
+  }
+
+ private:
+  // Computes the actual group id in the data storage, as in
+  // `LinearClassifierFstImpl`.
+  int GroupId(Label pred, int group) const {
+    return group * num_classes_ + pred - 1;
+  }
+
+  std::shared_ptr<const LinearFstData<A>> data_;
+  size_t num_classes_;
+  size_t num_groups_;
+  // Trie states of the groups of the class being scored.
+  std::vector<int> trie_states_;
+
+  LinearClassifierDecoder(const LinearClassifierDecoder &) = delete;
+  LinearClassifierDecoder &operator=(const LinearClassifierDecoder &) = delete;
+};
+
+template <class A>
+typename A::Weight LinearClassifierDecoder<A>::Decode(
+    const std::vector<Label> &words, Label *pred) {
+  *pred = kNoLabel;
+  for (const auto word : words) {
+    if (word < data_->MinInputLabel() || word > data_->MaxInputLabel())
+      return Weight::Zero();
+  }
+  Weight best = Weight::Zero();
+  for (Label c = 1; c <= static_cast<Label>(num_classes_); ++c) {
+    trie_states_.clear();
+    for (size_t group = 0; group < num_groups_; ++group)
+      trie_states_.push_back(data_->GroupStartState(GroupId(c, group)));
+    Weight path = Weight::One();
+    for (const auto word : words) {
+      Weight weight = Weight::One();
+      for (size_t group = 0; group < num_groups_; ++group)
+        trie_states_[group] = data_->GroupTransition(
+            GroupId(c, group), trie_states_[group], word, c, &weight);
+      path = Times(path, weight);
+    }
+    Weight final_weight = Weight::One();
+    for (size_t group = 0; group < num_groups_; ++group)
+      final_weight = Times(final_weight, data_->GroupFinalWeight(
+                                             GroupId(c, group),
+                                             trie_states_[group]));
+    path = Times(path, final_weight);
+    if (NaturalLess<Weight>()(path, best)) {
+      best = path;
+      *pred = c;
+    }
+  }
+  return best;
+}
+
+}  // namespace fst
+
+#endif  // FST_EXTENSIONS_LINEAR_LINEAR_DECODER_H_
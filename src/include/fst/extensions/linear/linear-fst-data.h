@@ -364,7 +364,7 @@ class FeatureGroup {
     }
   };
 
-  typedef FlatTrieTopology<InputOutputLabel, InputOutputLabelHash> Topology;
+  typedef SortedTrieTopology<InputOutputLabel, InputOutputLabelHash> Topology;
   typedef MutableTrie<InputOutputLabel, WeightBackLink, Topology> Trie;
 
   explicit FeatureGroup(size_t delay, int start)
@@ -399,6 +399,10 @@ struct FeatureGroup<A>::InputOutputLabel {
     return input == that.input && output == that.output;
   }
 
+  bool operator<(InputOutputLabel that) const {
+    return input < that.input || (input == that.input && output < that.output);
+  }
+
   std::istream &Read(std::istream &strm) {  // NOLINT
     ReadType(strm, &input);
     ReadType(strm, &output);
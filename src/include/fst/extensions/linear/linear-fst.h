@@ -87,6 +87,9 @@ class LinearTaggerFstImpl : public CacheImpl<A> {
     ReserveStubSpace();
   }
 
+  // Returns the underlying data storage.
+  const std::shared_ptr<const LinearFstData<A>> &Data() const { return data_; }
+
   StateId Start() {
     if (!HasStart()) {
       StateId start = FindStartState();
@@ -488,6 +491,11 @@ class LinearTaggerFst : public ImplToFst<LinearTaggerFstImpl<A>> {
     return new LinearFstMatcherTpl<LinearTaggerFst<A>>(*this, match_type);
   }
 
+  // Returns the underlying data storage, e.g. for `LinearTaggerDecoder`.
+  std::shared_ptr<const LinearFstData<A>> Data() const {
+    return GetImpl()->Data();
+  }
+
   static LinearTaggerFst<A> *Read(const string &filename) {
     if (!filename.empty()) {
       std::ifstream strm(filename.c_str(),
@@ -627,6 +635,11 @@ class LinearClassifierFstImpl : public CacheImpl<A> {
     ReserveStubSpace();
   }
 
+  // Returns the underlying data storage.
+  const std::shared_ptr<const LinearFstData<A>> &Data() const { return data_; }
+
+  size_t NumClasses() const { return num_classes_; }
+
   StateId Start() {
     if (!HasStart()) {
       StateId start = FindStartState();
@@ -940,6 +953,13 @@ class LinearClassifierFst : public ImplToFst<LinearClassifierFstImpl<A>> {
     return new LinearFstMatcherTpl<LinearClassifierFst<A>>(*this, match_type);
   }
 
+  // Returns the underlying data storage, e.g. for `LinearClassifierDecoder`.
+  std::shared_ptr<const LinearFstData<A>> Data() const {
+    return GetImpl()->Data();
+  }
+
+  size_t NumClasses() const { return GetImpl()->NumClasses(); }
+
   static LinearClassifierFst<A> *Read(const string &filename) {
     if (!filename.empty()) {
       std::ifstream strm(filename.c_str(),
@@ -4,6 +4,7 @@
 #ifndef FST_EXTENSIONS_LINEAR_TRIE_H_
 #define FST_EXTENSIONS_LINEAR_TRIE_H_
 
+#include <algorithm>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -20,6 +21,8 @@ template <class L, class H>
 class NestedTrieTopology;
 template <class L, class H>
 class FlatTrieTopology;
+template <class L, class H>
+class SortedTrieTopology;
 
 // A pair of parent node id and label, part of a trie edge
 template <class L>
@@ -34,6 +37,11 @@ struct ParentLabel {
     return parent == that.parent && label == that.label;
   }
 
+  bool operator<(const ParentLabel &that) const {
+    return parent < that.parent ||
+           (parent == that.parent && label < that.label);
+  }
+
   std::istream &Read(std::istream &strm) {  // NOLINT
     ReadType(strm, &parent);
     ReadType(strm, &label);
@@ -324,6 +332,181 @@ inline int FlatTrieTopology<L, H>::Find(int parent, const L &label) const {
   return it == next_.end() ? kNoTrieNodeId : it->second;
 }
 
+// An immutable trie topology with the children of all nodes held in one
+// array (in CSR fashion) and sorted by label, which must be ordered by
+// `operator<`; child lookup is a binary search over a contiguous range. It is
+// built by conversion from another topology. Its serialization is the same as
+// that of `FlatTrieTopology`, so the two can read each other's output.
+template <class L, class H>
+class SortedTrieTopology {
+ public:
+  typedef L Label;
+  typedef H Hash;
+
+  // Iterator over edges as std::pair<ParentLabel<L>, int>, ordered by parent
+  // then label.
+  class const_iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef std::pair<ParentLabel<L>, int> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type *pointer;
+    typedef const value_type &reference;
+
+    friend class SortedTrieTopology<L, H>;
+
+    const_iterator() : ptr_(nullptr), parent_(0), edge_(0) {}
+
+    reference operator*() {
+      UpdateStub();
+      return stub_;
+    }
+    pointer operator->() {
+      UpdateStub();
+      return &stub_;
+    }
+
+    const_iterator &operator++() {
+      ++edge_;
+      while (parent_ + 1 < ptr_->offsets_.size() &&
+             ptr_->offsets_[parent_ + 1] <= edge_) {
+        ++parent_;
+      }
+      return *this;
+    }
+
+    bool operator==(const const_iterator &that) const {
+      return ptr_ == that.ptr_ && edge_ == that.edge_;
+    }
+    bool operator!=(const const_iterator &that) const {
+      return !(*this == that);
+    }
+
+   private:
+    const_iterator(const SortedTrieTopology *ptr, size_t edge)
+        : ptr_(ptr), parent_(0), edge_(edge) {
+      while (parent_ + 1 < ptr_->offsets_.size() &&
+             ptr_->offsets_[parent_ + 1] <= edge_) {
+        ++parent_;
+      }
+    }
+
+    void UpdateStub() {
+      stub_.first = ParentLabel<L>(parent_, ptr_->labels_[edge_]);
+      stub_.second = ptr_->children_[edge_];
+    }
+
+    const SortedTrieTopology *ptr_;
+    size_t parent_;
+    size_t edge_;
+    value_type stub_;
+  };
+
+  SortedTrieTopology() : offsets_(2, 0) {}
+
+  // Conversion from any topology that iterates over its edges as
+  // std::pair<ParentLabel<L>, int>.
+  template <class T>
+  explicit SortedTrieTopology(const T &that) {
+    std::vector<std::pair<ParentLabel<L>, int>> edges(that.begin(),
+                                                      that.end());
+    Build(&edges);
+  }
+
+  void swap(SortedTrieTopology &that) {
+    offsets_.swap(that.offsets_);
+    labels_.swap(that.labels_);
+    children_.swap(that.children_);
+  }
+
+  bool operator==(const SortedTrieTopology &that) const {
+    return offsets_ == that.offsets_ && labels_ == that.labels_ &&
+           children_ == that.children_;
+  }
+  bool operator!=(const SortedTrieTopology &that) const {
+    return !(*this == that);
+  }
+
+  int Root() const { return 0; }
+  size_t NumNodes() const { return offsets_.size() - 1; }
+  int Find(int parent, const L &label) const {
+    const L *begin = labels_.data() + offsets_[parent];
+    const L *end = labels_.data() + offsets_[parent + 1];
+    const L *it = std::lower_bound(begin, end, label);
+    return it == end || !(*it == label) ? kNoTrieNodeId
+                                        : children_[it - labels_.data()];
+  }
+
+  std::istream &Read(std::istream &strm) {  // NOLINT
+    int64 n = 0;
+    strm.read(reinterpret_cast<char *>(&n), sizeof(n));
+    if (n < 0) strm.setstate(std::ios_base::failbit);
+    std::vector<std::pair<ParentLabel<L>, int>> edges;
+    for (int64 i = 0; i < n && strm; ++i) {
+      std::pair<ParentLabel<L>, int> edge;
+      ReadType(strm, &edge);
+      edges.push_back(edge);
+    }
+    if (strm && !Build(&edges)) strm.setstate(std::ios_base::failbit);
+    return strm;
+  }
+
+  std::ostream &Write(std::ostream &strm) const {  // NOLINT
+    int64 n = labels_.size();
+    strm.write(reinterpret_cast<char *>(&n), sizeof(n));
+    for (const_iterator it = begin(); it != end(); ++it) WriteType(strm, *it);
+    return strm;
+  }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, labels_.size()); }
+
+ private:
+  // Builds from edges of a tree rooted at node 0, whose nodes are numbered
+  // densely. Returns false, leaving an empty topology, if some edge has a
+  // parent or child outside of the nodes.
+  bool Build(std::vector<std::pair<ParentLabel<L>, int>> *edges) {
+    const size_t num_nodes = edges->size() + 1;
+    for (const auto &edge : *edges) {
+      if (edge.first.parent < 0 ||
+          static_cast<size_t>(edge.first.parent) >= num_nodes ||
+          edge.second <= 0 || static_cast<size_t>(edge.second) >= num_nodes) {
+        offsets_.assign(2, 0);
+        labels_.clear();
+        children_.clear();
+        return false;
+      }
+    }
+    std::sort(edges->begin(), edges->end(),
+              [](const std::pair<ParentLabel<L>, int> &a,
+                 const std::pair<ParentLabel<L>, int> &b) {
+                return a.first < b.first;
+              });
+    offsets_.assign(edges->size() + 2, 0);
+    labels_.clear();
+    labels_.reserve(edges->size());
+    children_.clear();
+    children_.reserve(edges->size());
+    for (const auto &edge : *edges) {
+      ++offsets_[edge.first.parent + 1];
+      labels_.push_back(edge.first.label);
+      children_.push_back(edge.second);
+    }
+    for (size_t i = 1; i < offsets_.size(); ++i) offsets_[i] += offsets_[i - 1];
+    return true;
+  }
+
+  // Children of node i are at positions [offsets_[i], offsets_[i + 1]).
+  std::vector<size_t> offsets_;
+  std::vector<L> labels_;
+  std::vector<int> children_;
+};
+
+template <class L, class H>
+inline void swap(SortedTrieTopology<L, H> &t1, SortedTrieTopology<L, H> &t2) {
+  t1.swap(t2);
+}
+
 // A collection of implementations of the trie data structure. The key
 // is a sequence of type `L` which must be hashable. The value is of
 // `V` which must be default constructible and copyable. In addition,
@@ -427,6 +610,9 @@ class MutableTrie {
   std::istream &Read(std::istream &strm) {  // NOLINT
     ReadType(strm, &topology_);
     ReadType(strm, &values_);
+    if (strm && values_.size() != topology_.NumNodes()) {
+      strm.setstate(std::ios_base::failbit);
+    }
     return strm;
   }
   std::ostream &Write(std::ostream &strm) const {  // NOLINT
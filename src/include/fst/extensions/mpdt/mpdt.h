@@ -6,7 +6,7 @@
 #ifndef FST_EXTENSIONS_MPDT_MPDT_H__
 #define FST_EXTENSIONS_MPDT_MPDT_H__
 
-#include <map>
+#include <unordered_map>
 #include <vector>
 
 #include <fst/compat.h>
@@ -45,6 +45,12 @@ struct StackConfig {
 
   const K &operator[](const int index) const { return array_[index]; }
 
+  bool operator==(const StackConfig<K, nlevels> &config) const {
+    for (int i = 0; i < nlevels; ++i)
+      if (array_[i] != config.array_[i]) return false;
+    return true;
+  }
+
   StackConfig &operator=(const StackConfig<K, nlevels> &config) {
     if (this == &config) return *this;
     for (int i = 0; i < nlevels; ++i) array_[i] = config.array_[i];
@@ -70,6 +76,19 @@ class CompConfig {
   }
 };
 
+template <typename K, int nlevels>
+class HashConfig {
+ public:
+  size_t operator()(const StackConfig<K, nlevels> &config) const {
+    size_t h = 0;
+    for (int i = 0; i < nlevels; ++i) h = h * kPrime + config.array_[i];
+    return h;
+  }
+
+ private:
+  static const size_t kPrime = 7853;
+};
+
 // Defines the KeyPair type used as the key to MPdtStack.paren_id_map_. The hash
 // function is provided as a separate struct to match templating syntax.
 template <typename L>
@@ -98,7 +117,7 @@ class MPdtStack {
   typedef L Label;
   typedef L Level;  // Not really needed, but I find it confusing otherwise.
   typedef StackConfig<StackId, nlevels> Config;
-  typedef std::map<Config, StackId, CompConfig<StackId, nlevels>>
+  typedef std::unordered_map<Config, StackId, HashConfig<StackId, nlevels>>
       ConfigToStackId;
 
   MPdtStack(const std::vector<std::pair<Label, Label>> &parens,
@@ -118,7 +137,7 @@ class MPdtStack {
   // (or -1) if there is none. Then map that to the external stack_id to return
   ssize_t Top(StackId stack_id) const {
     if (stack_id == -1) return -1;
-    const Config config = InternalStackIds(stack_id);
+    const Config &config = InternalStackIds(stack_id);
     Level lev = 0;
     StackId underlying_id = -1;
     for (; lev < nlevels; ++lev) {
@@ -160,29 +179,22 @@ class MPdtStack {
 
   // Each of the component stacks keeps its own stack id for a given
   // configuration and label. This function relates a configuration of those to
-  // the stack id that the caller of the mpdt sees.
+  // the stack id that the caller of the mpdt sees. Configurations are
+  // hash-consed: each distinct one is stored once and gets the next id.
   inline StackId ExternalStackId(const Config &config) {
-    typename ConfigToStackId::const_iterator idx =
-        config_to_stack_id_map_.find(config);
-    StackId result;
-    if (idx == config_to_stack_id_map_.end()) {
-      result = next_stack_id_++;
-      config_to_stack_id_map_.insert(
-          std::pair<Config, StackId>(config, result));
-      stack_id_to_config_map_[result] = config;
-    } else {
-      result = idx->second;
+    auto insert =
+        config_to_stack_id_map_.insert(std::make_pair(config, next_stack_id_));
+    if (insert.second) {
+      ++next_stack_id_;
+      configs_.push_back(config);
     }
-    return result;
+    return insert.first->second;
   }
 
   // This function gets the internal stack id from an external stack id
-  inline const Config InternalStackIds(StackId stack_id) const {
-    typename std::unordered_map<StackId, Config>::const_iterator idx =
-        stack_id_to_config_map_.find(stack_id);
-    if (idx == stack_id_to_config_map_.end())
-      idx = stack_id_to_config_map_.find(-1);
-    return idx->second;
+  inline const Config &InternalStackIds(StackId stack_id) const {
+    size_t index = stack_id + 1;
+    return index < configs_.size() ? configs_[index] : configs_[0];
   }
 
   inline bool Empty(const Config &config, Level lev) const {
@@ -205,9 +217,10 @@ class MPdtStack {
   // Map between internal paren_id and external paren_id
   std::unordered_map<KeyPair<Level>, size_t, KeyPairHasher<Level>>
       paren_id_map_;
-  // Maps between internal stack ids and external stack id.
+  // Maps between internal stack ids and external stack id; the configuration
+  // of external stack id 's' is 'configs_[s + 1]'.
   ConfigToStackId config_to_stack_id_map_;
-  std::unordered_map<StackId, Config> stack_id_to_config_map_;
+  std::vector<Config> configs_;
   StackId next_stack_id_;
   // Underlying stacks
   PdtStack<StackId, Label> *stacks_[nlevels];  // Array of stacks
@@ -222,12 +235,11 @@ MPdtStack<K, L, nlevels, restrict>::MPdtStack(
       max_paren_(kNoLabel),
       parens_(parens),
       next_stack_id_(1) {
+  for (L i = 0; i < nlevels; ++i) stacks_[i] = nullptr;
   typedef K StackId;
   typedef L Label;
   typedef L Level;  // Not really needed, but I find it confusing otherwise.
   typedef StackConfig<StackId, nlevels> Config;
-  typedef std::map<Config, StackId, CompConfig<StackId, nlevels>>
-      ConfigToStackId;
   if (parens.size() != assignments.size()) {
     FSTERROR() << "MPdtStack: Parens of different size from assignments";
     error_ = true;
@@ -267,8 +279,8 @@ MPdtStack<K, L, nlevels, restrict>::MPdtStack(
   }
   config_to_stack_id_map_[neg_one] = -1;
   config_to_stack_id_map_[zero] = 0;
-  stack_id_to_config_map_[-1] = neg_one;
-  stack_id_to_config_map_[0] = zero;
+  configs_.push_back(neg_one);
+  configs_.push_back(zero);
 }
 
 template <typename K, typename L, L nlevels, MPdtType restrict>
@@ -277,35 +289,16 @@ MPdtStack<K, L, nlevels, restrict>::MPdtStack(
     : error_(mstack.error_),
       min_paren_(mstack.min_paren_),
       max_paren_(mstack.max_paren_),
+      paren_levels_(mstack.paren_levels_),
       parens_(mstack.parens_),
+      paren_map_(mstack.paren_map_),
+      paren_id_map_(mstack.paren_id_map_),
+      config_to_stack_id_map_(mstack.config_to_stack_id_map_),
+      configs_(mstack.configs_),
       next_stack_id_(mstack.next_stack_id_) {
-  typedef K StackId;
-  typedef L Label;
-  typedef L Level;  // Not really needed, but I find it confusing otherwise.
-  typedef StackConfig<StackId, nlevels> Config;
-  for (const auto &kv : mstack.paren_levels_) {
-    paren_levels_[kv.first] = kv.second;
-  }
-  for (int i = 0; i < mstack.parens_.size(); ++i) {
-    parens_.push_back(mstack.parens_[i]);
-  }
-  for (const auto &kv : mstack.paren_map_) {
-    paren_map_[kv.first] = kv.second;
-  }
-  for (const auto &kv : mstack.paren_id_map_) {
-    paren_id_map_[kv.first] = kv.second;
-  }
-  for (typename ConfigToStackId::const_iterator ix =
-           mstack.config_to_stack_id_map_.begin();
-       ix != mstack.config_to_stack_id_map_.end(); ++ix) {
-    config_to_stack_id_map_[ix->first] = ix->second;
-  }
-  for (const auto &kv : mstack.stack_id_to_config_map_) {
-    Config config(kv.second);
-    stack_id_to_config_map_[kv.first] = config;
-  }
   for (int i = 0; i < nlevels; ++i) {
-    stacks_[i] = mstack.stacks_[i];
+    stacks_[i] = mstack.stacks_[i] ? new PdtStack<K, L>(*mstack.stacks_[i])
+                                   : nullptr;
   }
 }
 
@@ -323,7 +316,7 @@ K MPdtStack<K, L, nlevels, restrict>::Find(K stack_id, L label) {
     return stack_id;
   ssize_t paren_id = pit->second;
   // Get the configuration associated with this stack_id
-  const Config config = InternalStackIds(stack_id);
+  const Config &config = InternalStackIds(stack_id);
   // Get the level
   auto pli = paren_levels_.find(label);
   Level lev = pli->second;
@@ -22,6 +22,12 @@
 //
 // To handle overflows, a "primary" index containing a running count of
 // bits set in each block is created using the type uint64.
+//
+// Select is further sped up by sampled "select hints": the index of the word
+// containing every kSelectSample-th set (and clear) bit is kept, so that a
+// select only needs to search the few words between two consecutive samples,
+// which takes expected constant time unless the bits are very unevenly
+// distributed.
 
 namespace fst {
 
@@ -107,6 +113,8 @@ class BitmapIndex {
   static const uint32 kStorageLogBitSize = 6;
   static const uint32 kSecondaryBlockSize =
       ((1 << 16) - 1) >> kStorageLogBitSize;
+  // A select hint is kept for every kSelectSample-th set or clear bit.
+  static const uint32 kSelectSample = 512;
 
  private:
   static const uint32 kStorageBlockMask = kStorageBitSize - 1;
@@ -114,32 +122,14 @@ class BitmapIndex {
   // returns, from the index, the count of ones up to array_index
   size_t get_index_ones_count(size_t array_index) const;
 
-  // because the indexes, both primary and secondary, contain a running
-  // count of the population of one bits contained in [0,i), there is
-  // no reason to have an element in the zeroth position as this value would
-  // necessarily be zero.  (The bits are indexed in a zero based way.)  Thus
-  // we don't store the 0th element in either index.  Both of the following
-  // functions, if greater than 0, must be decremented by one before retreiving
-  // the value from the corresponding array.
-  // returns the 1 + the block that contains the bitindex in question
-  // the inverted version works the same but looks for zeros using an inverted
-  // view of the index
-  size_t find_primary_block(size_t bit_index) const;
-
-  size_t find_inverted_primary_block(size_t bit_index) const;
-
-  // similarly, the secondary index (which resets its count to zero at
-  // the end of every kSecondaryBlockSize entries) does not store the element
-  // at 0.  Note that the rem_bit_index parameter is the number of bits
-  // within the secondary block, after the bits accounted for by the primary
-  // block have been removed (i.e. the remaining bits)  And, because we
-  // reset to zero with each new block, there is no need to store those
-  // actual zeros.
-  // returns 1 + the secondary block that contains the bitindex in question
-  size_t find_secondary_block(size_t block, size_t rem_bit_index) const;
-
-  size_t find_inverted_secondary_block(size_t block,
-                                       size_t rem_bit_index) const;
+  // Returns the index of the word containing the bit_index'th (zero based)
+  // set or clear bit, using the select hints to bound the search.
+  size_t find_select1_word(size_t bit_index) const;
+
+  size_t find_select0_word(size_t bit_index) const;
+
+  // Builds the select hints; called from BuildIndex().
+  void BuildSelectHints();
 
   // We create a primary index based upon the number of secondary index
   // blocks.  The primary index uses fields wide enough to accomodate any
@@ -161,6 +151,11 @@ class BitmapIndex {
   // bitmap.  It is the same length (in units of uint16) as the
   // bitmap's map is in units of uint64s.
   std::vector<uint16> secondary_index_;
+  // The nth value is the index of the word containing the
+  // (n * kSelectSample)'th set bit, followed by ArraySize() - 1.
+  std::vector<uint32> select1_hints_;
+  // As above, for the clear bits.
+  std::vector<uint32> select0_hints_;
 };
 
 }  // end namespace fst
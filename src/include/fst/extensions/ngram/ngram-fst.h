@@ -13,12 +13,14 @@
 #include <algorithm>
 #include <iostream>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <fst/compat.h>
 #include <fstream>
 #include <fst/extensions/ngram/bitmap-index.h>
+#include <fst/extensions/ngram/quantized-array.h>
 #include <fst/fstlib.h>
 #include <fst/mapped-file.h>
 
@@ -76,7 +78,10 @@ class NGramFstImpl : public FstImpl<A> {
     SetProperties(kStaticProperties);
   }
 
-  NGramFstImpl(const Fst<A> &fst, std::vector<StateId> *order_out);
+  // If weight_bits is 8 or 16, the weights are quantized to a codebook of
+  // that many bits and the labels are bit-packed; see Quantize().
+  NGramFstImpl(const Fst<A> &fst, std::vector<StateId> *order_out,
+               int weight_bits = 0);
 
   explicit NGramFstImpl(const Fst<A> &fst) : NGramFstImpl(fst, nullptr) {}
 
@@ -93,32 +98,55 @@ class NGramFstImpl : public FstImpl<A> {
 
   static NGramFstImpl<A> *Read(std::istream &strm,  // NOLINT
                                const FstReadOptions &opts) {
-    NGramFstImpl<A> *impl = new NGramFstImpl();
+    std::unique_ptr<NGramFstImpl<A>> impl(new NGramFstImpl());
     FstHeader hdr;
-    if (!impl->ReadHeader(strm, opts, kMinFileVersion, &hdr)) return 0;
-    uint64 num_states, num_futures, num_final;
-    const size_t offset =
-        sizeof(num_states) + sizeof(num_futures) + sizeof(num_final);
-    // Peek at num_states and num_futures to see how much more needs to be read.
-    strm.read(reinterpret_cast<char *>(&num_states), sizeof(num_states));
-    strm.read(reinterpret_cast<char *>(&num_futures), sizeof(num_futures));
-    strm.read(reinterpret_cast<char *>(&num_final), sizeof(num_final));
-    size_t size = Storage(num_states, num_futures, num_final);
-    MappedFile *data_region = MappedFile::Allocate(size);
-    char *data = reinterpret_cast<char *>(data_region->mutable_data());
-    // Copy num_states, num_futures and num_final back into data.
-    memcpy(data, reinterpret_cast<char *>(&num_states), sizeof(num_states));
-    memcpy(data + sizeof(num_states), reinterpret_cast<char *>(&num_futures),
-           sizeof(num_futures));
-    memcpy(data + sizeof(num_states) + sizeof(num_futures),
-           reinterpret_cast<char *>(&num_final), sizeof(num_final));
-    strm.read(data + offset, size - offset);
-    if (strm.fail()) {
-      delete impl;
+    if (!impl->ReadHeader(strm, opts, kMinFileVersion, &hdr)) return nullptr;
+    // Ensures compatibility.
+    if (hdr.Version() == kAlignedFileVersion) {
+      hdr.SetFlags(hdr.GetFlags() | FstHeader::IS_ALIGNED);
+    }
+    // Version 4 writers set the aligned flag without padding the data, so the
+    // flag is only honored for later versions.
+    const bool aligned = hdr.Version() >= kAlignedFileVersion &&
+                         (hdr.GetFlags() & FstHeader::IS_ALIGNED);
+    const bool quantized = hdr.Version() == kQuantizedFileVersion;
+    if (aligned && !AlignInput(strm)) {
+      LOG(ERROR) << "NGramFst::Read: Alignment failed: " << opts.source;
+      return nullptr;
+    }
+    const std::streampos pos = aligned ? strm.tellg() : std::streampos(0);
+    // Peek at num_states, num_futures, num_final and, if quantized, the format
+    // to see how much more needs to be read.
+    uint64 counts[4] = {0, 0, 0, 0};
+    const size_t offset = (quantized ? 4 : 3) * sizeof(counts[0]);
+    strm.read(reinterpret_cast<char *>(counts), offset);
+    if (!strm) {
+      LOG(ERROR) << "NGramFst::Read: Read failed: " << opts.source;
+      return nullptr;
+    }
+    const size_t size = Storage(counts[0], counts[1], counts[2], counts[3]);
+    MappedFile *data_region = nullptr;
+    if (aligned) {
+      // The data is position-independent, so an aligned file can be mapped
+      // (or read) in place as a single region.
+      strm.seekg(pos);
+      data_region = MappedFile::Map(&strm, opts.mode == FstReadOptions::MAP,
+                                    opts.source, size);
+    } else {
+      data_region = MappedFile::Allocate(size);
+      char *data = reinterpret_cast<char *>(data_region->mutable_data());
+      // Copy the peeked values back into data.
+      memcpy(data, reinterpret_cast<char *>(counts), offset);
+      strm.read(data + offset, size - offset);
+    }
+    if (!strm || !data_region) {
+      LOG(ERROR) << "NGramFst::Read: Read failed: " << opts.source;
+      delete data_region;
       return nullptr;
     }
-    impl->Init(data, false, data_region);
-    return impl;
+    impl->Init(reinterpret_cast<const char *>(data_region->data()), false,
+               data_region, quantized);
+    return impl.release();
   }
 
   bool Write(std::ostream &strm,  // NOLINT
@@ -126,7 +154,15 @@ class NGramFstImpl : public FstImpl<A> {
     FstHeader hdr;
     hdr.SetStart(Start());
     hdr.SetNumStates(num_states_);
-    WriteHeader(strm, opts, kFileVersion, &hdr);
+    const int file_version =
+        Quantized() ? kQuantizedFileVersion
+                    : opts.align ? kAlignedFileVersion : kFileVersion;
+    WriteHeader(strm, opts, file_version, &hdr);
+    if (opts.align && !AlignOutput(strm)) {
+      LOG(ERROR) << "NGramFst::Write: Could not align file during write "
+                 << "after header";
+      return false;
+    }
     strm.write(data_, StorageSize());
     return !strm.fail();
   }
@@ -168,23 +204,42 @@ class NGramFstImpl : public FstImpl<A> {
     data->nstates = num_states_;
   }
 
+  // Returns the size of the data; format is zero for full labels and weights,
+  // or else the packed label bits plus the weight bits shifted left by eight.
   static size_t Storage(uint64 num_states, uint64 num_futures,
-                        uint64 num_final) {
+                        uint64 num_final, uint64 format = 0) {
     uint64 b64;
     Weight weight;
     Label label;
     size_t offset =
         sizeof(num_states) + sizeof(num_futures) + sizeof(num_final);
+    if (format) offset += sizeof(format);
     offset +=
         sizeof(b64) * (BitmapIndex::StorageSize(num_states * 2 + 1) +
                        BitmapIndex::StorageSize(num_futures + num_states + 1) +
                        BitmapIndex::StorageSize(num_states));
-    offset += (num_states + 1) * sizeof(label) + num_futures * sizeof(label);
+    const int label_bits = format & 0xff;
+    const int weight_bits = (format >> 8) & 0xff;
+    if (format) {
+      offset += sizeof(b64) * (NGramLabelArray<Label>::PackedStorageSize(
+                                   num_states + 1, label_bits) +
+                               NGramLabelArray<Label>::PackedStorageSize(
+                                   num_futures, label_bits));
+    } else {
+      offset += (num_states + 1) * sizeof(label) + num_futures * sizeof(label);
+    }
     // Pad for alignemnt, see
     // http://en.wikipedia.org/wiki/Data_structure_alignment#Computing_padding
     offset = (offset + sizeof(weight) - 1) & ~(sizeof(weight) - 1);
-    offset += (num_states + 1) * sizeof(weight) + num_final * sizeof(weight) +
-              (num_futures + 1) * sizeof(weight);
+    if (format) {
+      // The codebook, followed by the weight codes.
+      offset += sizeof(weight) << weight_bits;
+      offset += (num_states + 1 + num_final + num_futures + 1) *
+                (weight_bits / 8);
+    } else {
+      offset += (num_states + 1) * sizeof(weight) +
+                num_final * sizeof(weight) + (num_futures + 1) * sizeof(weight);
+    }
     return offset;
   }
 
@@ -223,7 +278,12 @@ class NGramFstImpl : public FstImpl<A> {
     return data_;
   }
 
-  void Init(const char *data, bool owned, MappedFile *file = nullptr);
+  // If quantized, the data holds bit-packed labels and quantized weights.
+  void Init(const char *data, bool owned, MappedFile *file = nullptr,
+            bool quantized = false);
+
+  // True if the labels are bit-packed and the weights quantized.
+  bool Quantized() const { return weight_bits_ != 0; }
 
   const std::vector<Label> &GetContext(StateId s, NGramFstInst<A> *inst) const {
     SetInstFuture(s, inst);
@@ -232,14 +292,44 @@ class NGramFstImpl : public FstImpl<A> {
   }
 
   size_t StorageSize() const {
-    return Storage(num_states_, num_futures_, num_final_);
+    return Storage(num_states_, num_futures_, num_final_,
+                   label_bits_ | (weight_bits_ << 8));
   }
 
   void GetStates(const std::vector<Label> &context,
                  std::vector<StateId> *states) const;
 
+  Weight ScoreSequence(StateId s, const Label *labels, size_t size,
+                       bool final, StateId *end_state,
+                       std::vector<Weight> *weights) const;
+
  private:
-  StateId Transition(const std::vector<Label> &context, Label future) const;
+  // Replaces the data with bit-packed labels and weights quantized to a
+  // codebook of 2^weight_bits entries. Fails for weights that are not
+  // quantizable (see IsQuantizableWeight).
+  void Quantize(int weight_bits) {
+    Quantize(weight_bits, std::integral_constant<
+                              bool, IsQuantizableWeight<Weight>::value>());
+  }
+
+  void Quantize(int weight_bits, std::true_type);
+
+  void Quantize(int weight_bits, std::false_type) {
+    FSTERROR() << "NGramFst: Weights of type " << Weight::Type()
+               << " cannot be quantized";
+    SetProperties(kError, kError);
+  }
+
+  StateId Transition(const std::vector<Label> &context, Label future) const {
+    size_t matched;
+    return context_index_.Rank1(
+        TransitionNode(context.data(), context.size(), future, &matched));
+  }
+
+  // Returns the context trie node reached from context (oldest label first)
+  // by future; *matched is set to the number of context labels retained.
+  size_t TransitionNode(const Label *context, size_t size, Label future,
+                        size_t *matched) const;
 
   // Properties always true for this Fst class.
   static const uint64 kStaticProperties =
@@ -247,8 +337,14 @@ class NGramFstImpl : public FstImpl<A> {
       kOEpsilons | kILabelSorted | kOLabelSorted | kWeighted | kCyclic |
       kInitialAcyclic | kNotTopSorted | kAccessible | kCoAccessible |
       kNotString | kExpanded;
-  // Current file format version.
+  // Current unaligned file format version.
   static const int kFileVersion = 4;
+  // Current aligned file format version; the data follows the header at an
+  // aligned offset so that it can be memory-mapped.
+  static const int kAlignedFileVersion = 5;
+  // Current file format version with bit-packed labels and quantized
+  // weights; aligned if the header says so.
+  static const int kQuantizedFileVersion = 6;
   // Minimum file format version supported.
   static const int kMinFileVersion = 4;
 
@@ -260,21 +356,32 @@ class NGramFstImpl : public FstImpl<A> {
   uint64 num_futures_ = 0;
   uint64 num_final_ = 0;
   std::pair<size_t, size_t> select_root_;
-  const Label *root_children_ = nullptr;
+  size_t root_children_ = 0;  // Index of the first child of the root.
   // borrowed references
   const uint64 *context_ = nullptr;
   const uint64 *future_ = nullptr;
   const uint64 *final_ = nullptr;
-  const Label *context_words_ = nullptr;
-  const Label *future_words_ = nullptr;
-  const Weight *backoff_ = nullptr;
-  const Weight *final_probs_ = nullptr;
-  const Weight *future_probs_ = nullptr;
+  int label_bits_ = 0;   // Width of the packed labels, if quantized.
+  int weight_bits_ = 0;  // Width of the weight codes, if quantized.
+  NGramLabelArray<Label> context_words_;
+  NGramLabelArray<Label> future_words_;
+  NGramWeightArray<Weight> backoff_;
+  NGramWeightArray<Weight> final_probs_;
+  NGramWeightArray<Weight> future_probs_;
   BitmapIndex context_index_;
   BitmapIndex future_index_;
   BitmapIndex final_index_;
 };
 
+template <typename A>
+const int NGramFstImpl<A>::kFileVersion;
+template <typename A>
+const int NGramFstImpl<A>::kAlignedFileVersion;
+template <typename A>
+const int NGramFstImpl<A>::kQuantizedFileVersion;
+template <typename A>
+const int NGramFstImpl<A>::kMinFileVersion;
+
 template <typename A>
 inline void NGramFstImpl<A>::GetStates(
     const std::vector<Label> &context,
@@ -282,10 +389,11 @@ inline void NGramFstImpl<A>::GetStates(
   states->clear();
   states->push_back(0);
   typename std::vector<Label>::const_reverse_iterator cit = context.rbegin();
-  const Label *children = root_children_;
+  size_t children = root_children_;
   size_t num_children = select_root_.second - 2;
-  const Label *loc = std::lower_bound(children, children + num_children, *cit);
-  if (loc == children + num_children || *loc != *cit) return;
+  size_t loc =
+      context_words_.LowerBound(children, children + num_children, *cit);
+  if (loc == children + num_children || context_words_[loc] != *cit) return;
   size_t node = 2 + loc - children;
   states->push_back(context_index_.Rank1(node));
   if (context.size() == 1) return;
@@ -297,10 +405,11 @@ inline void NGramFstImpl<A>::GetStates(
   if (context_index_.Get(first_child) != false) {
     size_t last_child = zeros.second - 1;
     while (cit != context.rend()) {
-      children = context_words_ + context_index_.Rank1(first_child);
-      loc = std::lower_bound(children, children + last_child - first_child + 1,
-                             *cit);
-      if (loc == children + last_child - first_child + 1 || *loc != *cit) {
+      children = context_index_.Rank1(first_child);
+      loc = context_words_.LowerBound(
+          children, children + last_child - first_child + 1, *cit);
+      if (loc == children + last_child - first_child + 1 ||
+          context_words_[loc] != *cit) {
         break;
       }
       ++cit;
@@ -335,6 +444,15 @@ class NGramFst : public ImplToExpandedFst<NGramFstImpl<A>> {
   NGramFst(const Fst<A> &fst, std::vector<StateId> *order_out)
       : ImplToExpandedFst<Impl>(std::make_shared<Impl>(fst, order_out)) {}
 
+  // Compressed variant: the weights are quantized to a codebook of
+  // 2^weight_bits entries (weight_bits is 8 or 16, and the weights must be
+  // quantizable, see IsQuantizableWeight) and the labels are bit-packed to the width of the largest
+  // label.
+  NGramFst(const Fst<A> &fst, std::vector<StateId> *order_out,
+           int weight_bits)
+      : ImplToExpandedFst<Impl>(
+            std::make_shared<Impl>(fst, order_out, weight_bits)) {}
+
   // Because the NGramFstImpl is a const stateless data structure, there
   // is never a need to do anything beside copy the reference.
   NGramFst(const NGramFst<A> &fst, bool safe = false)
@@ -342,10 +460,11 @@ class NGramFst : public ImplToExpandedFst<NGramFstImpl<A>> {
 
   NGramFst() : ImplToExpandedFst<Impl>(std::make_shared<Impl>()) {}
 
-  // Non-standard constructor to initialize NGramFst directly from data.
-  NGramFst(const char *data, bool owned)
+  // Non-standard constructor to initialize NGramFst directly from data;
+  // quantized must be true if the data was produced by the compressed variant.
+  NGramFst(const char *data, bool owned, bool quantized = false)
       : ImplToExpandedFst<Impl>(std::make_shared<Impl>()) {
-    GetMutableImpl()->Init(data, owned, nullptr);
+    GetMutableImpl()->Init(data, owned, nullptr, quantized);
   }
 
   // Get method that gets the data associated with Init().
@@ -364,6 +483,30 @@ class NGramFst : public ImplToExpandedFst<NGramFstImpl<A>> {
     return GetImpl()->GetStates(context, state);
   }
 
+  // Scores the label sequence from state s, following backoff arcs only when a
+  // label has no arc at the current state. If final is true, the (backed-off)
+  // final weight of the state reached is included. Returns Weight::Zero() if
+  // some label is not in the model. If non-null, end_state is set to the state
+  // reached (kNoStateId on failure) and the weight of each label, then of the
+  // final weight, is appended to weights.
+  Weight ScoreSequence(StateId s, const std::vector<Label> &labels,
+                       bool final = false, StateId *end_state = nullptr,
+                       std::vector<Weight> *weights = nullptr) const {
+    return GetImpl()->ScoreSequence(s, labels.data(), labels.size(), final,
+                                    end_state, weights);
+  }
+
+  // Scores a batch of label sequences (e.g., sentences) from the start state;
+  // see ScoreSequence().
+  void ScoreSequences(const std::vector<std::vector<Label>> &sequences,
+                      bool final, std::vector<Weight> *scores) const {
+    scores->clear();
+    scores->reserve(sequences.size());
+    for (const auto &labels : sequences) {
+      scores->push_back(ScoreSequence(GetImpl()->Start(), labels, final));
+    }
+  }
+
   size_t NumArcs(StateId s) const override {
     return GetImpl()->NumArcs(s, &inst_);
   }
@@ -465,7 +608,8 @@ inline void NGramFst<A>::InitArcIterator(StateId s,
 
 template <typename A>
 NGramFstImpl<A>::NGramFstImpl(const Fst<A> &fst,
-                              std::vector<StateId> *order_out) {
+                              std::vector<StateId> *order_out,
+                              int weight_bits) {
   typedef A Arc;
   typedef typename Arc::Label Label;
   typedef typename Arc::Weight Weight;
@@ -689,11 +833,101 @@ NGramFstImpl<A>::NGramFstImpl(const Fst<A> &fst,
   }
 
   Init(data, false, data_region);
+  if (weight_bits != 0 && !Properties(kError)) Quantize(weight_bits);
+}
+
+template <typename A>
+void NGramFstImpl<A>::Quantize(int weight_bits, std::true_type) {
+  if (weight_bits != 8 && weight_bits != 16) {
+    FSTERROR() << "NGramFst: Weights can only be quantized to 8 or 16 bits";
+    SetProperties(kError, kError);
+    return;
+  }
+  Label max_label = 0;
+  for (size_t i = 0; i < num_states_; ++i) {
+    max_label = std::max(max_label, context_words_[i]);
+  }
+  for (size_t i = 0; i < num_futures_; ++i) {
+    max_label = std::max(max_label, future_words_[i]);
+  }
+  const int label_bits = NGramLabelArray<Label>::PackedBits(max_label);
+  std::vector<Weight> weights;
+  weights.reserve(num_states_ + num_final_ + num_futures_);
+  for (size_t i = 0; i < num_states_; ++i) weights.push_back(backoff_[i]);
+  for (size_t i = 0; i < num_final_; ++i) weights.push_back(final_probs_[i]);
+  for (size_t i = 0; i < num_futures_; ++i) {
+    weights.push_back(future_probs_[i]);
+  }
+  std::vector<Weight> codebook;
+  const size_t num_entries =
+      BuildWeightCodebook(weights, weight_bits, &codebook);
+
+  const uint64 format = label_bits | (weight_bits << 8);
+  const size_t storage =
+      Storage(num_states_, num_futures_, num_final_, format);
+  MappedFile *data_region = MappedFile::Allocate(storage);
+  char *data = reinterpret_cast<char *>(data_region->mutable_data());
+  memset(data, 0, storage);
+  uint64 b64;
+  size_t offset = 0;
+  memcpy(data + offset, reinterpret_cast<const char *>(&num_states_),
+         sizeof(num_states_));
+  offset += sizeof(num_states_);
+  memcpy(data + offset, reinterpret_cast<const char *>(&num_futures_),
+         sizeof(num_futures_));
+  offset += sizeof(num_futures_);
+  memcpy(data + offset, reinterpret_cast<const char *>(&num_final_),
+         sizeof(num_final_));
+  offset += sizeof(num_final_);
+  memcpy(data + offset, reinterpret_cast<const char *>(&format),
+         sizeof(format));
+  offset += sizeof(format);
+  // The bitmaps are unchanged.
+  const size_t bitmap_size =
+      sizeof(b64) * (BitmapIndex::StorageSize(num_states_ * 2 + 1) +
+                     BitmapIndex::StorageSize(num_futures_ + num_states_ + 1) +
+                     BitmapIndex::StorageSize(num_states_));
+  memcpy(data + offset, reinterpret_cast<const char *>(context_),
+         bitmap_size);
+  offset += bitmap_size;
+  uint64 *context_words = reinterpret_cast<uint64 *>(data + offset);
+  for (size_t i = 0; i < num_states_; ++i) {
+    NGramLabelArray<Label>::Pack(context_words, label_bits, i,
+                                 context_words_[i]);
+  }
+  offset += NGramLabelArray<Label>::PackedStorageSize(num_states_ + 1,
+                                                       label_bits) *
+            sizeof(b64);
+  uint64 *future_words = reinterpret_cast<uint64 *>(data + offset);
+  for (size_t i = 0; i < num_futures_; ++i) {
+    NGramLabelArray<Label>::Pack(future_words, label_bits, i,
+                                 future_words_[i]);
+  }
+  offset +=
+      NGramLabelArray<Label>::PackedStorageSize(num_futures_, label_bits) *
+      sizeof(b64);
+  offset = (offset + sizeof(Weight) - 1) & ~(sizeof(Weight) - 1);
+  std::copy(codebook.begin(), codebook.end(),
+            reinterpret_cast<Weight *>(data + offset));
+  offset += sizeof(Weight) << weight_bits;
+  // Codes are written in the order backoff, final, future weights, leaving
+  // the unused last backoff entry (and last future entry) zero.
+  size_t position = 0;
+  for (size_t i = 0; i < weights.size(); ++i) {
+    if (i == num_states_) ++position;
+    const size_t code = EncodeWeight(codebook, num_entries, weights[i]);
+    if (weight_bits == 8) {
+      reinterpret_cast<uint8 *>(data + offset)[position++] = code;
+    } else {
+      reinterpret_cast<uint16 *>(data + offset)[position++] = code;
+    }
+  }
+  Init(data, false, data_region, true);
 }
 
 template <typename A>
 inline void NGramFstImpl<A>::Init(const char *data, bool owned,
-                                  MappedFile *data_region) {
+                                  MappedFile *data_region, bool quantized) {
   if (owned_) {
     delete[] data_;
   }
@@ -707,6 +941,20 @@ inline void NGramFstImpl<A>::Init(const char *data, bool owned,
   offset += sizeof(num_futures_);
   num_final_ = *(reinterpret_cast<const uint64 *>(data_ + offset));
   offset += sizeof(num_final_);
+  label_bits_ = 0;
+  weight_bits_ = 0;
+  if (quantized) {
+    const uint64 format = *(reinterpret_cast<const uint64 *>(data_ + offset));
+    offset += sizeof(format);
+    label_bits_ = format & 0xff;
+    weight_bits_ = (format >> 8) & 0xff;
+    if (label_bits_ == 0 || label_bits_ > 64 ||
+        (weight_bits_ != 8 && weight_bits_ != 16)) {
+      FSTERROR() << "Malformed file";
+      SetProperties(kError, kError);
+      return;
+    }
+  }
   uint64 bits;
   size_t context_bits = num_states_ * 2 + 1;
   size_t future_bits = num_futures_ + num_states_ + 1;
@@ -716,16 +964,38 @@ inline void NGramFstImpl<A>::Init(const char *data, bool owned,
   offset += BitmapIndex::StorageSize(future_bits) * sizeof(bits);
   final_ = reinterpret_cast<const uint64 *>(data_ + offset);
   offset += BitmapIndex::StorageSize(num_states_) * sizeof(bits);
-  context_words_ = reinterpret_cast<const Label *>(data_ + offset);
-  offset += (num_states_ + 1) * sizeof(*context_words_);
-  future_words_ = reinterpret_cast<const Label *>(data_ + offset);
-  offset += num_futures_ * sizeof(*future_words_);
-  offset = (offset + sizeof(*backoff_) - 1) & ~(sizeof(*backoff_) - 1);
-  backoff_ = reinterpret_cast<const Weight *>(data_ + offset);
-  offset += (num_states_ + 1) * sizeof(*backoff_);
-  final_probs_ = reinterpret_cast<const Weight *>(data_ + offset);
-  offset += num_final_ * sizeof(*final_probs_);
-  future_probs_ = reinterpret_cast<const Weight *>(data_ + offset);
+  if (quantized) {
+    context_words_.Init(reinterpret_cast<const uint64 *>(data_ + offset),
+                        label_bits_);
+    offset += NGramLabelArray<Label>::PackedStorageSize(num_states_ + 1,
+                                                         label_bits_) *
+              sizeof(bits);
+    future_words_.Init(reinterpret_cast<const uint64 *>(data_ + offset),
+                       label_bits_);
+    offset +=
+        NGramLabelArray<Label>::PackedStorageSize(num_futures_, label_bits_) *
+        sizeof(bits);
+    offset = (offset + sizeof(Weight) - 1) & ~(sizeof(Weight) - 1);
+    const Weight *codebook = reinterpret_cast<const Weight *>(data_ + offset);
+    offset += sizeof(Weight) << weight_bits_;
+    const size_t code_size = weight_bits_ / 8;
+    backoff_.Init(codebook, data_ + offset, weight_bits_);
+    offset += (num_states_ + 1) * code_size;
+    final_probs_.Init(codebook, data_ + offset, weight_bits_);
+    offset += num_final_ * code_size;
+    future_probs_.Init(codebook, data_ + offset, weight_bits_);
+  } else {
+    context_words_.Init(reinterpret_cast<const Label *>(data_ + offset));
+    offset += (num_states_ + 1) * sizeof(Label);
+    future_words_.Init(reinterpret_cast<const Label *>(data_ + offset));
+    offset += num_futures_ * sizeof(Label);
+    offset = (offset + sizeof(Weight) - 1) & ~(sizeof(Weight) - 1);
+    backoff_.Init(reinterpret_cast<const Weight *>(data_ + offset));
+    offset += (num_states_ + 1) * sizeof(Weight);
+    final_probs_.Init(reinterpret_cast<const Weight *>(data_ + offset));
+    offset += num_final_ * sizeof(Weight);
+    future_probs_.Init(reinterpret_cast<const Weight *>(data_ + offset));
+  }
 
   context_index_.BuildIndex(context_, context_bits);
   future_index_.BuildIndex(future_, future_bits);
@@ -738,19 +1008,21 @@ inline void NGramFstImpl<A>::Init(const char *data, bool owned,
     SetProperties(kError, kError);
     return;
   }
-  root_children_ = context_words_ + context_index_.Rank1(2);
+  root_children_ = context_index_.Rank1(2);
   start_ = 1;
 }
 
 template <typename A>
-inline typename A::StateId NGramFstImpl<A>::Transition(
-    const std::vector<Label> &context, Label future) const {
-  const Label *children = root_children_;
+inline size_t NGramFstImpl<A>::TransitionNode(const Label *context,
+                                              size_t size, Label future,
+                                              size_t *matched) const {
+  *matched = 0;
+  size_t children = root_children_;
   size_t num_children = select_root_.second - 2;
-  const Label *loc =
-      std::lower_bound(children, children + num_children, future);
-  if (loc == children + num_children || *loc != future) {
-    return context_index_.Rank1(0);
+  size_t loc =
+      context_words_.LowerBound(children, children + num_children, future);
+  if (loc == children + num_children || context_words_[loc] != future) {
+    return 0;
   }
   size_t node = 2 + loc - children;
   size_t node_rank = context_index_.Rank1(node);
@@ -758,18 +1030,19 @@ inline typename A::StateId NGramFstImpl<A>::Transition(
       (node_rank == 0) ? select_root_ : context_index_.Select0s(node_rank);
   size_t first_child = zeros.first + 1;
   if (context_index_.Get(first_child) == false) {
-    return context_index_.Rank1(node);
+    return node;
   }
   size_t last_child = zeros.second - 1;
-  for (int word = context.size() - 1; word >= 0; --word) {
-    children = context_words_ + context_index_.Rank1(first_child);
-    loc = std::lower_bound(children, children + last_child - first_child + 1,
-                           context[word]);
+  for (int word = size - 1; word >= 0; --word) {
+    children = context_index_.Rank1(first_child);
+    loc = context_words_.LowerBound(
+        children, children + last_child - first_child + 1, context[word]);
     if (loc == children + last_child - first_child + 1 ||
-        *loc != context[word]) {
+        context_words_[loc] != context[word]) {
       break;
     }
     node = first_child + loc - children;
+    ++*matched;
     node_rank = context_index_.Rank1(node);
     zeros =
         (node_rank == 0) ? select_root_ : context_index_.Select0s(node_rank);
@@ -777,7 +1050,72 @@ inline typename A::StateId NGramFstImpl<A>::Transition(
     if (context_index_.Get(first_child) == false) break;
     last_child = zeros.second - 1;
   }
-  return context_index_.Rank1(node);
+  return node;
+}
+
+// Scores the labels from state s, taking the backoff arc of a state only when
+// the label has no arc there (i.e., with failure semantics, as a backoff
+// language model would). The context of the current state and its trie node
+// are carried from one label to the next rather than recomputed.
+template <typename A>
+typename A::Weight NGramFstImpl<A>::ScoreSequence(
+    StateId s, const Label *labels, size_t size, bool final,
+    StateId *end_state, std::vector<Weight> *weights) const {
+  // Context of the current state, oldest label first.
+  std::vector<Label> context;
+  size_t node = context_index_.Select1(s);
+  for (size_t n = node; n != 0;
+       n = context_index_.Select1(context_index_.Rank0(n) - 1)) {
+    context.push_back(context_words_[context_index_.Rank1(n)]);
+  }
+  Weight total = Weight::One();
+  for (size_t i = 0; i < size; ++i) {
+    const Label label = labels[i];
+    Weight weight = Weight::One();
+    while (true) {
+      const std::pair<size_t, size_t> zeros = future_index_.Select0s(s);
+      const size_t offset = future_index_.Rank1(zeros.first + 1);
+      const size_t end = offset + zeros.second - zeros.first - 1;
+      const size_t search = future_words_.LowerBound(offset, end, label);
+      if (search != end && future_words_[search] == label) {
+        weight = Times(weight, future_probs_[search]);
+        size_t matched;
+        node = TransitionNode(context.data(), context.size(), label, &matched);
+        context.erase(context.begin(), context.end() - matched);
+        if (node == 0) {
+          context.clear();
+        } else {
+          context.push_back(label);
+        }
+        s = context_index_.Rank1(node);
+        break;
+      }
+      if (s == 0) {  // Not in the model.
+        if (end_state) *end_state = kNoStateId;
+        if (weights) weights->push_back(Weight::Zero());
+        return Weight::Zero();
+      }
+      weight = Times(weight, backoff_[s]);
+      node = context_index_.Select1(context_index_.Rank0(node) - 1);
+      s = context_index_.Rank1(node);
+      context.erase(context.begin());
+    }
+    if (weights) weights->push_back(weight);
+    total = Times(total, weight);
+  }
+  if (end_state) *end_state = s;
+  if (final) {
+    Weight weight = Weight::One();
+    while (!final_index_.Get(s) && s != 0) {
+      weight = Times(weight, backoff_[s]);
+      node = context_index_.Select1(context_index_.Rank0(node) - 1);
+      s = context_index_.Rank1(node);
+    }
+    weight = Times(weight, Final(s));
+    if (weights) weights->push_back(weight);
+    total = Times(total, weight);
+  }
+  return total;
 }
 
 /*****************************************************************************/
@@ -847,10 +1185,11 @@ class NGramFstMatcher : public MatcherBase<A> {
       }
     } else {
       current_loop_ = false;
-      const Label *start = fst_.GetImpl()->future_words_ + inst_.offset_;
-      const Label *end = start + inst_.num_futures_;
-      const Label *search = std::lower_bound(start, end, label);
-      if (search != end && *search == label) {
+      const auto &future_words = fst_.GetImpl()->future_words_;
+      const size_t start = inst_.offset_;
+      const size_t end = start + inst_.num_futures_;
+      const size_t search = future_words.LowerBound(start, end, label);
+      if (search != end && future_words[search] == label) {
         size_t state = search - start;
         arc_.ilabel = arc_.olabel = label;
         arc_.weight = fst_.GetImpl()->future_probs_[inst_.offset_ + state];
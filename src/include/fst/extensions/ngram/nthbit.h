@@ -6,9 +6,19 @@
 
 #include <fst/types.h>
 
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif  // __BMI2__
+
 extern uint32 nth_bit_bit_offset[];
 
+// Returns the position of the rth (one based) set bit of v.
+// REQUIRES: 0 < r <= popcount(v)
 inline uint32 nth_bit(uint64 v, uint32 r) {
+#ifdef __BMI2__
+  // Deposits a single bit at the position of the rth set bit of v.
+  return __builtin_ctzll(_pdep_u64(uint64{1} << (r - 1), v));
+#else
   uint32 shift = 0;
   uint32 c = __builtin_popcount(v & 0xffffffff);
   uint32 mask = -(r > c);
@@ -27,6 +37,7 @@ inline uint32 nth_bit(uint64 v, uint32 r) {
 
   return shift +
          ((nth_bit_bit_offset[(v >> shift) & 0xff] >> ((r - 1) << 2)) & 0xf);
+#endif  // __BMI2__
 }
 
 #endif  // FST_EXTENSIONS_NGRAM_NTHBIT_H_
@@ -0,0 +1,223 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Read-only views of the label and weight arrays of an NGramFst, stored either
+// in full or compressed: labels bit-packed to a fixed width and weights
+// replaced by 8- or 16-bit indices into a codebook. Element access is
+// constant-time in both cases.
+
+#ifndef FST_EXTENSIONS_NGRAM_QUANTIZED_ARRAY_H_
+#define FST_EXTENSIONS_NGRAM_QUANTIZED_ARRAY_H_
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <vector>
+
+#include <fst/float-weight.h>
+#include <fst/types.h>
+
+namespace fst {
+
+// Array of labels, either stored as Labels or bit-packed into uint64 words.
+// Packed labels are stored incremented by one so that kNoLabel can be
+// represented.
+template <class L>
+class NGramLabelArray {
+ public:
+  typedef L Label;
+
+  NGramLabelArray() : labels_(nullptr), packed_(nullptr), bits_(0), mask_(0) {}
+
+  // Full-width labels.
+  void Init(const Label *labels) {
+    labels_ = labels;
+    packed_ = nullptr;
+    bits_ = 0;
+  }
+
+  // Labels packed to the given bit width, see Pack().
+  void Init(const uint64 *packed, int bits) {
+    labels_ = nullptr;
+    packed_ = packed;
+    bits_ = bits;
+    mask_ = bits < 64 ? (uint64{1} << bits) - 1 : ~uint64{0};
+  }
+
+  Label operator[](size_t i) const {
+    if (!packed_) return labels_[i];
+    const size_t pos = i * bits_;
+    const size_t word = pos >> 6;
+    const int shift = pos & 63;
+    uint64 value = packed_[word] >> shift;
+    if (shift + bits_ > 64) value |= packed_[word + 1] << (64 - shift);
+    return static_cast<Label>(value & mask_) - 1;
+  }
+
+  // Returns the first position in [begin, end) whose label is not less than
+  // label, assuming the labels in the range are sorted.
+  size_t LowerBound(size_t begin, size_t end, Label label) const {
+    if (!packed_) {
+      return std::lower_bound(labels_ + begin, labels_ + end, label) - labels_;
+    }
+    size_t count = end - begin;
+    while (count > 0) {
+      const size_t step = count / 2;
+      if ((*this)[begin + step] < label) {
+        begin += step + 1;
+        count -= step + 1;
+      } else {
+        count = step;
+      }
+    }
+    return begin;
+  }
+
+  // Number of bits needed to pack labels up to max_label.
+  static int PackedBits(Label max_label) {
+    int bits = 1;
+    while (bits < 64 && (static_cast<uint64>(max_label) + 1) >> bits) ++bits;
+    return bits;
+  }
+
+  // Number of uint64 words needed to pack size labels.
+  static size_t PackedStorageSize(size_t size, int bits) {
+    return (size * bits + 63) >> 6;
+  }
+
+  // Stores the ith label of a packed array, which must be zero-initialized.
+  static void Pack(uint64 *packed, int bits, size_t i, Label label) {
+    const uint64 value = static_cast<uint64>(label + 1);
+    const size_t pos = i * bits;
+    const size_t word = pos >> 6;
+    const int shift = pos & 63;
+    packed[word] |= value << shift;
+    if (shift + bits > 64) packed[word + 1] |= value >> (64 - shift);
+  }
+
+ private:
+  const Label *labels_;
+  const uint64 *packed_;
+  int bits_;
+  uint64 mask_;
+};
+
+// Array of weights, either stored as Weights or as 8- or 16-bit indices into
+// a codebook of weights.
+template <class W>
+class NGramWeightArray {
+ public:
+  typedef W Weight;
+
+  NGramWeightArray() : weights_(nullptr), codes_(nullptr), bits_(0) {}
+
+  // Full weights.
+  void Init(const Weight *weights) {
+    weights_ = weights;
+    codes_ = nullptr;
+    bits_ = 0;
+  }
+
+  // Codebook of 2^bits weights and the codes, bits is 8 or 16.
+  void Init(const Weight *codebook, const void *codes, int bits) {
+    weights_ = codebook;
+    codes_ = codes;
+    bits_ = bits;
+  }
+
+  Weight operator[](size_t i) const {
+    if (!codes_) return weights_[i];
+    return weights_[bits_ == 8 ? static_cast<const uint8 *>(codes_)[i]
+                               : static_cast<const uint16 *>(codes_)[i]];
+  }
+
+ private:
+  const Weight *weights_;
+  const void *codes_;
+  int bits_;
+};
+
+// Whether weights of type W can be quantized, i.e., have a real Value() as do
+// the weights derived from FloatWeightTpl (e.g., TropicalWeight, LogWeight).
+template <class W>
+struct IsQuantizableWeight {
+  static const bool value =
+      std::is_base_of<FloatWeightTpl<float>, W>::value ||
+      std::is_base_of<FloatWeightTpl<double>, W>::value;
+};
+
+// Builds a codebook of at most 2^bits weights for the given weights, which
+// must be quantizable (see IsQuantizableWeight). If there are
+// no more distinct values than codebook entries, the codebook is exact.
+// Otherwise the finite values are split into bins of equal count, each
+// represented by its mean, and the infinite values are kept exactly. The
+// codebook is sorted by value and padded with Weight::Zero(); returns the
+// number of entries before the padding.
+template <class Weight>
+size_t BuildWeightCodebook(const std::vector<Weight> &weights, int bits,
+                           std::vector<Weight> *codebook) {
+  typedef typename Weight::ValueType Value;
+  const size_t size = size_t{1} << bits;
+  std::vector<Value> values;
+  values.reserve(weights.size());
+  for (const auto &weight : weights) values.push_back(weight.Value());
+  std::sort(values.begin(), values.end());
+  std::vector<Value> distinct(values);
+  distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+  std::vector<Value> entries;
+  if (distinct.size() <= size) {
+    entries.swap(distinct);
+  } else {
+    std::vector<Value> finite;
+    for (auto value : values) {
+      if (std::isfinite(value)) {
+        finite.push_back(value);
+      } else if (entries.empty() || entries.back() != value) {
+        entries.push_back(value);
+      }
+    }
+    const size_t num_bins = size - entries.size();
+    size_t begin = 0;
+    for (size_t bin = 0; bin < num_bins; ++bin) {
+      const size_t end = finite.size() * (bin + 1) / num_bins;
+      if (end == begin) continue;
+      double sum = 0.0;
+      for (size_t i = begin; i < end; ++i) sum += finite[i];
+      entries.push_back(sum / (end - begin));
+      begin = end;
+    }
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+  }
+  codebook->clear();
+  for (auto value : entries) codebook->push_back(Weight(value));
+  codebook->resize(size, Weight::Zero());
+  return entries.size();
+}
+
+// Returns the index of the codebook entry nearest to weight, given the first
+// num_entries entries sorted by value.
+template <class Weight>
+size_t EncodeWeight(const std::vector<Weight> &codebook, size_t num_entries,
+                    const Weight &weight) {
+  const auto value = weight.Value();
+  size_t lo = 0;
+  size_t hi = num_entries;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (codebook[mid].Value() < value) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == num_entries) return num_entries - 1;
+  if (lo == 0 || codebook[lo].Value() == value) return lo;
+  return value - codebook[lo - 1].Value() <= codebook[lo].Value() - value
+             ? lo - 1
+             : lo;
+}
+
+}  // namespace fst
+
+#endif  // FST_EXTENSIONS_NGRAM_QUANTIZED_ARRAY_H_
@@ -9,10 +9,9 @@
 #include <forward_list>
 #include <vector>
 
+#include <fst/extensions/pdt/paren-index.h>
 #include <fst/extensions/pdt/paren.h>
 #include <fst/extensions/pdt/pdt.h>
-#include <fst/extensions/pdt/reverse.h>
-#include <fst/extensions/pdt/shortest-path.h>
 #include <fst/cache.h>
 #include <fst/mutable-fst.h>
 #include <fst/queue.h>
@@ -296,7 +295,7 @@ inline void PdtExpandFst<A>::InitStateIterator(StateIteratorData<A> *data)
 // The algorithm works by visiting the delayed ExpandFst using a
 // shortest-stack first queue discipline and relies on the
 // shortest-distance information computed using a reverse
-// shortest-path call to perform the pruning.
+// shortest-path call (see PdtParenIndex) to perform the pruning.
 //
 // The algorithm maintains the same state ordering between the ExpandFst
 // being visited 'efst_' and the result of pruning written into the
@@ -312,7 +311,6 @@ class PdtPrunedExpand {
   typedef StateId StackId;
   typedef PdtStack<StackId, Label> Stack;
   typedef PdtStateTable<StateId, StackId> StateTable;
-  typedef typename PdtBalanceData<Arc>::SetIterator SetIterator;
 
   // Constructor taking as input a PDT specified by 'ifst' and 'parens'.
   // 'keep_parentheses' specifies whether parentheses are replaced by
@@ -323,23 +321,33 @@ class PdtPrunedExpand {
                bool keep_parentheses = false,
                const CacheOptions &opts = CacheOptions())
       : ifst_(ifst.Copy()),
+        own_index_(new PdtParenIndex<Arc>(*ifst_, parens)),
+        index_(own_index_.get()),
         keep_parentheses_(keep_parentheses),
         stack_(parens),
         efst_(ifst, parens,
               PdtExpandFstOptions<Arc>(opts, true, &stack_, &state_table_)),
         queue_(state_table_, stack_, stack_length_, distance_, fdistance_),
-        error_(false) {
-    Reverse(*ifst_, parens, &rfst_);
-    VectorFst<Arc> path;
-    reverse_shortest_path_.reset(
-        new SP(rfst_, parens,
-               PdtShortestPathOptions<A, FifoQueue<StateId>>(true, false)));
-    reverse_shortest_path_->ShortestPath(&path);
-    error_ = (path.Properties(kError, true) == kError);
-    balance_data_.reset(reverse_shortest_path_->GetBalanceData()->Reverse(
-        rfst_.NumStates(), 10, -1));
-
-    InitCloseParenMultimap(parens);
+        error_(index_->Error()) {}
+
+  // Same as above, with the paren index of the PDT precomputed; 'index' is
+  // not owned and must outlive this object. It is an error if 'index' is
+  // not the index of 'ifst' (see PdtParenIndex::Matches()).
+  PdtPrunedExpand(const Fst<A> &ifst, const PdtParenIndex<Arc> &index,
+               bool keep_parentheses = false,
+               const CacheOptions &opts = CacheOptions())
+      : ifst_(ifst.Copy()),
+        index_(&index),
+        keep_parentheses_(keep_parentheses),
+        stack_(index.Parens()),
+        efst_(ifst, index.Parens(),
+              PdtExpandFstOptions<Arc>(opts, true, &stack_, &state_table_)),
+        queue_(state_table_, stack_, stack_length_, distance_, fdistance_),
+        error_(index.Error()) {
+    if (!error_ && !index.Matches(ifst, index.Parens())) {
+      FSTERROR() << "PdtPrunedExpand: Paren index does not match the PDT";
+      error_ = true;
+    }
   }
 
   bool Error() const { return error_; }
@@ -411,8 +419,6 @@ class PdtPrunedExpand {
               StackCompare(st, s, sl, d, fd)) {}
   };
 
-  void InitCloseParenMultimap(
-      const std::vector<std::pair<Label, Label>> &parens);
   Weight DistanceToDest(StateId state, StateId source) const;
   uint8 Flags(StateId s) const;
   void SetFlags(StateId s, uint8 flags, uint8 mask);
@@ -433,7 +439,8 @@ class PdtPrunedExpand {
   void ProcDestStates(StateId s, StackId si);
 
   std::unique_ptr<Fst<A>> ifst_;       // Input PDT
-  VectorFst<Arc> rfst_;                // Reversed PDT
+  std::unique_ptr<const PdtParenIndex<Arc>> own_index_;
+  const PdtParenIndex<Arc> *index_;    // Paren index of 'ifst_'
   bool keep_parentheses_;              // Keep parentheses in ofst?
   StateTable state_table_;             // State table for efst_
   Stack stack_;                        // Stack trie
@@ -446,13 +453,7 @@ class PdtPrunedExpand {
   std::vector<uint8> flags_;       // Status flags for states in efst_/ofst
   std::vector<StateId> sources_;   // PDT source state for each expanded state
 
-  typedef PdtShortestPath<Arc, FifoQueue<StateId>> SP;
-  typedef typename SP::CloseParenMultimap ParenMultimap;
-  std::unique_ptr<SP> reverse_shortest_path_;  // Shortest path for rfst_
-  std::unique_ptr<PdtBalanceData<Arc>>
-      balance_data_;                    // Not owned by shortest_path_
-  ParenMultimap close_paren_multimap_;  // Maps open paren arcs to
-  // balancing close paren arcs.
+  typedef typename PdtParenArcs<Arc>::CloseParenMultimap ParenMultimap;
 
   MutableFst<Arc> *ofst_;  // Output fst
   Weight limit_;           // Weight limit
@@ -487,42 +488,15 @@ const uint8 PdtPrunedExpand<A>::kExpanded = 0x02;
 template <class A>
 const uint8 PdtPrunedExpand<A>::kSourceState = 0x04;
 
-// Initializes close paren multimap, mapping pairs (s,paren_id) to
-// all the arcs out of s labeled with close parenthese for paren_id.
-template <class A>
-void PdtPrunedExpand<A>::InitCloseParenMultimap(
-    const std::vector<std::pair<Label, Label>> &parens) {
-  std::unordered_map<Label, Label> paren_id_map;
-  for (Label i = 0; i < parens.size(); ++i) {
-    const auto &p = parens[i];
-    paren_id_map[p.first] = i;
-    paren_id_map[p.second] = i;
-  }
-
-  for (StateIterator<Fst<Arc>> siter(*ifst_); !siter.Done(); siter.Next()) {
-    StateId s = siter.Value();
-    for (ArcIterator<Fst<Arc>> aiter(*ifst_, s); !aiter.Done(); aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      typename std::unordered_map<Label, Label>::const_iterator pit =
-          paren_id_map.find(arc.ilabel);
-      if (pit == paren_id_map.end()) continue;
-      if (arc.ilabel == parens[pit->second].second) {  // Close paren
-        ParenState<Arc> paren_state(pit->second, s);
-        close_paren_multimap_.insert(std::make_pair(paren_state, arc));
-      }
-    }
-  }
-}
-
 // Returns the weight of the shortest balanced path from 'source' to 'dest'
-// in 'ifst_', 'dest' must be the source state of a close paren arc.
+// in 'ifst_', 'dest' must be the source state of a close paren arc, or
+// kNoStateId for the final states.
 template <class A>
 typename A::Weight PdtPrunedExpand<A>::DistanceToDest(StateId source,
                                                       StateId dest) const {
-  typename SP::SearchState s(source + 1, dest + 1);
   VLOG(2) << "D(" << source << ", " << dest
-          << ") =" << reverse_shortest_path_->GetShortestPathData().Distance(s);
-  return reverse_shortest_path_->GetShortestPathData().Distance(s);
+          << ") =" << index_->Distance(source, dest);
+  return index_->Distance(source, dest);
 }
 
 // Returns the flags for state 's' in 'ofst_'.
@@ -625,10 +599,8 @@ bool PdtPrunedExpand<A>::PruneArc(StateId s, const A &arc) {
     cached_stack_id_ = current_stack_id_;
     cached_dest_list_.clear();
     if (cached_source_ != ifst_->Start()) {
-      for (SetIterator set_iter =
-               balance_data_->Find(current_paren_id_, cached_source_);
-           !set_iter.Done(); set_iter.Next()) {
-        StateId dest = set_iter.Element();
+      for (StateId dest :
+           index_->CloseSources(current_paren_id_, cached_source_)) {
         typename DestMap::const_iterator iter = dest_map_.find(dest);
         cached_dest_list_.push_front(*iter);
       }
@@ -636,7 +608,7 @@ bool PdtPrunedExpand<A>::PruneArc(StateId s, const A &arc) {
       // TODO(allauzen): queue discipline should prevent this never
       // from happening; replace by a check.
       cached_dest_list_.push_front(
-          std::make_pair(rfst_.Start() - 1, Weight::One()));
+          std::make_pair(kNoStateId, Weight::One()));
     }
   }
 
@@ -665,18 +637,18 @@ void PdtPrunedExpand<A>::ProcStart() {
   current_stack_id_ = 0;
   current_paren_id_ = -1;
   stack_length_.push_back(0);
-  dest_map_[rfst_.Start() - 1] = Weight::One();  // not needed
+  dest_map_[kNoStateId] = Weight::One();  // not needed
 
   cached_source_ = ifst_->Start();
   cached_stack_id_ = 0;
   cached_dest_list_.push_front(
-      std::make_pair(rfst_.Start() - 1, Weight::One()));
+      std::make_pair(kNoStateId, Weight::One()));
 
-  PdtStateTuple<StateId, StackId> tuple(rfst_.Start() - 1, 0);
+  PdtStateTuple<StateId, StackId> tuple(kNoStateId, 0);
   SetFinalDistance(state_table_.FindState(tuple), Weight::One());
   SetDistance(s, Weight::One());
-  SetFinalDistance(s, DistanceToDest(ifst_->Start(), rfst_.Start() - 1));
-  VLOG(2) << DistanceToDest(ifst_->Start(), rfst_.Start() - 1);
+  SetFinalDistance(s, DistanceToDest(ifst_->Start(), kNoStateId));
+  VLOG(2) << DistanceToDest(ifst_->Start(), kNoStateId);
 }
 
 // Makes 's' final in 'ofst_' if shortest accepting path ending in 's'
@@ -726,10 +698,9 @@ bool PdtPrunedExpand<A>::ProcOpenParen(StateId s, const A &arc, StackId si,
   Weight fd = Weight::Zero();
   ssize_t paren_id = stack_.ParenId(arc.ilabel);
   std::forward_list<StateId> sources;
-  for (SetIterator set_iter =
-           balance_data_->Find(paren_id, state_table_.Tuple(ns).state_id);
-       !set_iter.Done(); set_iter.Next()) {
-    sources.push_front(set_iter.Element());
+  for (StateId source :
+       index_->CloseSources(paren_id, state_table_.Tuple(ns).state_id)) {
+    sources.push_front(source);
   }
   for (typename std::forward_list<StateId>::const_iterator sources_iter =
            sources.begin();
@@ -737,9 +708,10 @@ bool PdtPrunedExpand<A>::ProcOpenParen(StateId s, const A &arc, StackId si,
     StateId source = *sources_iter;
     VLOG(2) << "Close paren source: " << source;
     ParenState<Arc> paren_state(paren_id, source);
+    const ParenMultimap &close_parens = index_->ParenArcs().CloseParens();
     for (typename ParenMultimap::const_iterator iter =
-             close_paren_multimap_.find(paren_state);
-         iter != close_paren_multimap_.end() && paren_state == iter->first;
+             close_parens.find(paren_state);
+         iter != close_parens.end() && paren_state == iter->first;
          ++iter) {
       Arc meta_arc = iter->second;
       PdtStateTuple<StateId, StackId> tuple(meta_arc.nextstate, si);
@@ -809,16 +781,15 @@ void PdtPrunedExpand<A>::ProcDestStates(StateId s, StackId si) {
   SetSourceState(s, state_table_.Tuple(s).state_id);
 
   ssize_t paren_id = stack_.Top(si);
-  for (SetIterator set_iter =
-           balance_data_->Find(paren_id, state_table_.Tuple(s).state_id);
-       !set_iter.Done(); set_iter.Next()) {
-    StateId dest_state = set_iter.Element();
+  for (StateId dest_state :
+       index_->CloseSources(paren_id, state_table_.Tuple(s).state_id)) {
     if (dest_map_.find(dest_state) != dest_map_.end()) continue;
     Weight dest_weight = Weight::Zero();
     ParenState<Arc> paren_state(paren_id, dest_state);
+    const ParenMultimap &close_parens = index_->ParenArcs().CloseParens();
     for (typename ParenMultimap::const_iterator iter =
-             close_paren_multimap_.find(paren_state);
-         iter != close_paren_multimap_.end() && paren_state == iter->first;
+             close_parens.find(paren_state);
+         iter != close_parens.end() && paren_state == iter->first;
          ++iter) {
       const Arc &arc = iter->second;
       PdtStateTuple<StateId, StackId> tuple(arc.nextstate, stack_.Pop(si));
@@ -848,7 +819,7 @@ void PdtPrunedExpand<A>::Expand(MutableFst<A> *ofst,
   ofst_->SetInputSymbols(ifst_->InputSymbols());
   ofst_->SetOutputSymbols(ifst_->OutputSymbols());
 
-  limit_ = Times(DistanceToDest(ifst_->Start(), rfst_.Start() - 1), threshold);
+  limit_ = Times(DistanceToDest(ifst_->Start(), kNoStateId), threshold);
   flags_.clear();
 
   ProcStart();
@@ -888,10 +859,15 @@ struct PdtExpandOptions {
   bool connect;
   bool keep_parentheses;
   typename Arc::Weight weight_threshold;
+  // Optional paren index of the PDT and parentheses used when pruning; not
+  // owned.
+  const PdtParenIndex<Arc> *paren_index;
 
   PdtExpandOptions(bool c = true, bool k = false,
-                typename Arc::Weight w = Arc::Weight::Zero())
-      : connect(c), keep_parentheses(k), weight_threshold(w) {}
+                typename Arc::Weight w = Arc::Weight::Zero(),
+                const PdtParenIndex<Arc> *pi = nullptr)
+      : connect(c), keep_parentheses(k), weight_threshold(w),
+        paren_index(pi) {}
 };
 
 // Expands a pushdown transducer (PDT) encoded as an FST into an FST.
@@ -916,6 +892,15 @@ void Expand(const Fst<Arc> &ifst,
   if (opts.weight_threshold == Weight::Zero()) {
     eopts.keep_parentheses = opts.keep_parentheses;
     *ofst = PdtExpandFst<Arc>(ifst, parens, eopts);
+  } else if (opts.paren_index) {
+    if (opts.paren_index->Parens() != parens) {
+      FSTERROR() << "PdtExpand: Paren index has different parentheses";
+      ofst->SetProperties(kError, kError);
+      return;
+    }
+    PdtPrunedExpand<Arc> pruned_expand(ifst, *opts.paren_index,
+                                       opts.keep_parentheses);
+    pruned_expand.Expand(ofst, opts.weight_threshold);
   } else {
     PdtPrunedExpand<Arc> pruned_expand(ifst, parens, opts.keep_parentheses);
     pruned_expand.Expand(ofst, opts.weight_threshold);
@@ -0,0 +1,323 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Precomputed parenthesis index of a PDT: its paren arcs, the balanced
+// reachability between open paren destinations and close paren sources and
+// the shortest balanced distances to them. Computed once for a fixed PDT
+// (e.g., a grammar) and possibly read from a file, it lets the pruned
+// expansion avoid reversing the PDT and running a shortest path per call.
+// The index records a fingerprint of its PDT (state and arc counts and a
+// checksum of the states and arcs) so that an index read from a file can be
+// checked against the PDT it is used with. It is used by the pruned PDT
+// expansion (see PdtExpandOptions and pdtexpand --paren_index); PdtCompose
+// does not use it since it neither prunes nor needs balanced distances, and
+// its result is a different PDT.
+
+#ifndef FST_EXTENSIONS_PDT_PAREN_INDEX_H_
+#define FST_EXTENSIONS_PDT_PAREN_INDEX_H_
+
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+#include <fst/extensions/pdt/paren.h>
+#include <fst/extensions/pdt/reverse.h>
+#include <fst/extensions/pdt/shortest-path.h>
+#include <fst/queue.h>
+#include <fst/vector-fst.h>
+
+namespace fst {
+
+static const int32 kPdtParenIndexMagicNumber = 1295409713;
+
+template <class A>
+class PdtParenIndex {
+ public:
+  typedef A Arc;
+  typedef typename A::Label Label;
+  typedef typename A::StateId StateId;
+  typedef typename A::Weight Weight;
+
+  // Computes the index of the PDT specified by 'fst' and 'parens'. The
+  // distances are found by a shortest path on the reversed PDT, so the
+  // weight must have the path property and be right distributive.
+  PdtParenIndex(const Fst<A> &fst,
+                const std::vector<std::pair<Label, Label>> &parens)
+      : paren_arcs_(fst, parens), error_(false) {
+    Fingerprint(fst, &num_states_, &num_arcs_, &checksum_);
+    typedef PdtShortestPath<A, FifoQueue<StateId>> SP;
+    VectorFst<A> rfst;
+    Reverse(fst, parens, &rfst);
+    VectorFst<A> path;
+    SP reverse_shortest_path(
+        rfst, parens, PdtShortestPathOptions<A, FifoQueue<StateId>>(true, false));
+    reverse_shortest_path.ShortestPath(&path);
+    error_ = path.Properties(kError, true) == kError;
+
+    // State 'r' of 'rfst' is state 'r - 1' of 'fst'; its super-initial state
+    // stands for the final states of 'fst'.
+    std::vector<std::pair<typename SP::SearchState, Weight>> states;
+    reverse_shortest_path.GetShortestPathData().GetSearchStates(&states);
+    for (const auto &entry : states) {
+      if (entry.first.state == rfst.Start()) continue;
+      StateId dest = entry.first.start == rfst.Start() ? kNoStateId
+                                                      : entry.first.start - 1;
+      distances_[StatePair(entry.first.state - 1, dest)] = entry.second;
+    }
+
+    std::unique_ptr<PdtBalanceData<A>> balance_data(
+        reverse_shortest_path.GetBalanceData()->Reverse(rfst.NumStates(), 10,
+                                                        -1));
+    for (const auto &open_paren : paren_arcs_.OpenParens()) {
+      ParenState<A> paren_state(open_paren.first, open_paren.second);
+      if (close_sources_.find(paren_state) != close_sources_.end()) continue;
+      std::vector<StateId> &sources = close_sources_[paren_state];
+      for (auto set_iter =
+               balance_data->Find(open_paren.first, open_paren.second);
+           !set_iter.Done(); set_iter.Next()) {
+        sources.push_back(set_iter.Element());
+      }
+      if (sources.empty()) close_sources_.erase(paren_state);
+    }
+  }
+
+  const PdtParenArcs<A> &ParenArcs() const { return paren_arcs_; }
+
+  const std::vector<std::pair<Label, Label>> &Parens() const {
+    return paren_arcs_.Parens();
+  }
+
+  // Returns the source states of the close paren arcs with paren ID
+  // 'paren_id' reachable by a balanced path from 'open_dest', the
+  // destination state of an open paren arc with that ID.
+  const std::vector<StateId> &CloseSources(Label paren_id,
+                                           StateId open_dest) const {
+    static const std::vector<StateId> kEmpty;
+    auto it = close_sources_.find(ParenState<A>(paren_id, open_dest));
+    return it == close_sources_.end() ? kEmpty : it->second;
+  }
+
+  // Returns the weight of the shortest balanced path from 'state' to 'dest',
+  // a close paren source state, or to the final states if 'dest' is
+  // kNoStateId. Only defined for 'state' in the sub-graph of 'dest'.
+  Weight Distance(StateId state, StateId dest) const {
+    auto it = distances_.find(StatePair(state, dest));
+    return it == distances_.end() ? Weight::Zero() : it->second;
+  }
+
+  bool Error() const { return error_; }
+
+  // Tests whether this is the index of the PDT specified by 'fst' and
+  // 'parens', up to the collisions of its checksum.
+  bool Matches(const Fst<A> &fst,
+               const std::vector<std::pair<Label, Label>> &parens) const {
+    if (parens != Parens()) return false;
+    int64 num_states, num_arcs;
+    uint64 checksum;
+    Fingerprint(fst, &num_states, &num_arcs, &checksum);
+    return num_states == num_states_ && num_arcs == num_arcs_ &&
+           checksum == checksum_;
+  }
+
+  // Reads an index, failing if it is malformed; whether it belongs to a PDT
+  // is checked with Matches().
+  static PdtParenIndex<A> *Read(std::istream &strm, const string &source);
+
+  static PdtParenIndex<A> *Read(const string &filename) {
+    std::ifstream strm(filename.c_str(),
+                       std::ios_base::in | std::ios_base::binary);
+    if (!strm) {
+      LOG(ERROR) << "PdtParenIndex::Read: Can't open file: " << filename;
+      return nullptr;
+    }
+    return Read(strm, filename);
+  }
+
+  bool Write(std::ostream &strm, const string &source) const;
+
+  bool Write(const string &filename) const {
+    std::ofstream strm(filename.c_str(),
+                       std::ios_base::out | std::ios_base::binary);
+    if (!strm) {
+      LOG(ERROR) << "PdtParenIndex::Write: Can't open file: " << filename;
+      return false;
+    }
+    return Write(strm, filename);
+  }
+
+ private:
+  typedef std::pair<StateId, StateId> StatePair;
+
+  struct StatePairHash {
+    size_t operator()(const StatePair &p) const {
+      return p.first + p.second * kPrime;
+    }
+  };
+
+  static const size_t kPrime;
+
+  PdtParenIndex()
+      : num_states_(0), num_arcs_(0), checksum_(0), error_(false) {}
+
+  // Computes the state and arc counts and a checksum of the final weights
+  // and arcs of 'fst'.
+  static void Fingerprint(const Fst<A> &fst, int64 *num_states,
+                          int64 *num_arcs, uint64 *checksum) {
+    static const uint64 kMultiplier = 0x9e3779b97f4a7c15ULL;
+    *num_states = 0;
+    *num_arcs = 0;
+    uint64 hash = fst.Start();
+    auto mix = [&hash](uint64 value) {
+      hash = (hash ^ value) * kMultiplier;
+      hash ^= hash >> 29;
+    };
+    for (StateIterator<Fst<A>> siter(fst); !siter.Done(); siter.Next()) {
+      const StateId s = siter.Value();
+      ++*num_states;
+      mix(s);
+      mix(fst.Final(s).Hash());
+      for (ArcIterator<Fst<A>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        const A &arc = aiter.Value();
+        ++*num_arcs;
+        mix(arc.ilabel);
+        mix(arc.olabel);
+        mix(arc.weight.Hash());
+        mix(arc.nextstate);
+      }
+    }
+    *checksum = hash;
+  }
+
+  // Tests whether the paren IDs and states of a read index are in range.
+  bool Valid() const {
+    const auto valid_state = [this](StateId s) {
+      return s >= 0 && s < num_states_;
+    };
+    const Label num_parens = Parens().size();
+    for (const auto &open_paren : paren_arcs_.OpenParens()) {
+      if (open_paren.first < 0 || open_paren.first >= num_parens ||
+          !valid_state(open_paren.second)) {
+        return false;
+      }
+    }
+    for (const auto &entry : paren_arcs_.CloseParens()) {
+      if (entry.first.paren_id < 0 || entry.first.paren_id >= num_parens ||
+          !valid_state(entry.first.state_id) ||
+          !valid_state(entry.second.nextstate)) {
+        return false;
+      }
+    }
+    for (const auto &entry : close_sources_) {
+      if (entry.first.paren_id < 0 || entry.first.paren_id >= num_parens ||
+          !valid_state(entry.first.state_id)) {
+        return false;
+      }
+      for (const StateId s : entry.second) {
+        if (!valid_state(s)) return false;
+      }
+    }
+    for (const auto &entry : distances_) {
+      if (!valid_state(entry.first.first) ||
+          (entry.first.second != kNoStateId &&
+           !valid_state(entry.first.second))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  PdtParenArcs<A> paren_arcs_;
+  // Close paren sources per open paren ID and destination state.
+  std::unordered_map<ParenState<A>, std::vector<StateId>,
+                     typename ParenState<A>::Hash>
+      close_sources_;
+  std::unordered_map<StatePair, Weight, StatePairHash> distances_;
+  // Fingerprint of the PDT.
+  int64 num_states_;
+  int64 num_arcs_;
+  uint64 checksum_;
+  bool error_;
+
+  PdtParenIndex(const PdtParenIndex &) = delete;
+  PdtParenIndex &operator=(const PdtParenIndex &) = delete;
+};
+
+template <class A>
+const size_t PdtParenIndex<A>::kPrime = 7853;
+
+template <class A>
+bool PdtParenIndex<A>::Write(std::ostream &strm, const string &source) const {
+  WriteType(strm, kPdtParenIndexMagicNumber);
+  WriteType(strm, num_states_);
+  WriteType(strm, num_arcs_);
+  WriteType(strm, checksum_);
+  paren_arcs_.Write(strm);
+  int64 size = close_sources_.size();
+  WriteType(strm, size);
+  for (const auto &entry : close_sources_) {
+    WriteType(strm, entry.first.paren_id);
+    WriteType(strm, entry.first.state_id);
+    WriteType(strm, entry.second);
+  }
+  size = distances_.size();
+  WriteType(strm, size);
+  for (const auto &entry : distances_) {
+    WriteType(strm, entry.first.first);
+    WriteType(strm, entry.first.second);
+    entry.second.Write(strm);
+  }
+  WriteType(strm, error_);
+  strm.flush();
+  if (!strm) {
+    LOG(ERROR) << "PdtParenIndex::Write: Write failed: " << source;
+    return false;
+  }
+  return true;
+}
+
+template <class A>
+PdtParenIndex<A> *PdtParenIndex<A>::Read(std::istream &strm,
+                                         const string &source) {
+  int32 magic_number = 0;
+  ReadType(strm, &magic_number);
+  if (magic_number != kPdtParenIndexMagicNumber) {
+    LOG(ERROR) << "PdtParenIndex::Read: Bad paren index header: " << source;
+    return nullptr;
+  }
+  std::unique_ptr<PdtParenIndex<A>> index(new PdtParenIndex<A>);
+  ReadType(strm, &index->num_states_);
+  ReadType(strm, &index->num_arcs_);
+  ReadType(strm, &index->checksum_);
+  index->paren_arcs_.Read(strm);
+  int64 size = 0;
+  ReadType(strm, &size);
+  for (int64 i = 0; i < size && strm; ++i) {
+    ParenState<A> paren_state;
+    ReadType(strm, &paren_state.paren_id);
+    ReadType(strm, &paren_state.state_id);
+    ReadType(strm, &index->close_sources_[paren_state]);
+  }
+  size = 0;
+  ReadType(strm, &size);
+  for (int64 i = 0; i < size && strm; ++i) {
+    StatePair state_pair;
+    ReadType(strm, &state_pair.first);
+    ReadType(strm, &state_pair.second);
+    index->distances_[state_pair].Read(strm);
+  }
+  ReadType(strm, &index->error_);
+  if (!strm) {
+    LOG(ERROR) << "PdtParenIndex::Read: Read failed: " << source;
+    return nullptr;
+  }
+  if (!index->Valid()) {
+    LOG(ERROR) << "PdtParenIndex::Read: Malformed paren index: " << source;
+    return nullptr;
+  }
+  return index.release();
+}
+
+}  // namespace fst
+
+#endif  // FST_EXTENSIONS_PDT_PAREN_INDEX_H_
@@ -12,6 +12,7 @@
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <fst/extensions/pdt/collection.h>
 #include <fst/extensions/pdt/pdt.h>
@@ -333,8 +334,10 @@ class PdtBalanceData {
   PdtBalanceData() {}
 
   void Clear() {
+    open_paren_set_.clear();
     open_paren_map_.clear();
     close_paren_map_.clear();
+    close_source_map_.clear();
   }
 
   // Adds an open parenthesis with destination state 'open_dest'.
@@ -455,6 +458,113 @@ PdtBalanceData<A> *PdtBalanceData<A>::Reverse(StateId num_states,
   return bd;
 }
 
+// Parenthesis arcs of a PDT: the paren ID of each paren label, the paren
+// IDs and destination states of the open paren arcs and the close paren arcs
+// keyed by paren ID and source state. Computed once per PDT, it can be shared
+// by operations on that PDT (see PdtShortestPathOptions).
+template <class A>
+class PdtParenArcs {
+ public:
+  typedef typename A::Label Label;
+  typedef typename A::StateId StateId;
+  typedef typename A::Weight Weight;
+
+  // Maps from close paren ID and source state to the close paren arcs.
+  typedef std::unordered_multimap<ParenState<A>, A,
+                                  typename ParenState<A>::Hash>
+      CloseParenMultimap;
+
+  PdtParenArcs() {}
+
+  PdtParenArcs(const Fst<A> &fst,
+               const std::vector<std::pair<Label, Label>> &parens)
+      : parens_(parens) {
+    InitParenIds();
+    for (StateIterator<Fst<A>> siter(fst); !siter.Done(); siter.Next()) {
+      StateId s = siter.Value();
+      for (ArcIterator<Fst<A>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        const A &arc = aiter.Value();
+        Label paren_id = ParenId(arc.ilabel);
+        if (paren_id == kNoLabel) continue;
+        if (arc.ilabel == parens_[paren_id].first) {  // Open paren
+          open_parens_.push_back(std::make_pair(paren_id, arc.nextstate));
+        } else {  // Close paren
+          close_parens_.insert(
+              std::make_pair(ParenState<A>(paren_id, s), arc));
+        }
+      }
+    }
+  }
+
+  const std::vector<std::pair<Label, Label>> &Parens() const {
+    return parens_;
+  }
+
+  // Returns the paren ID of 'label', or kNoLabel if it is not a paren.
+  Label ParenId(Label label) const {
+    auto it = paren_id_map_.find(label);
+    return it == paren_id_map_.end() ? kNoLabel : it->second;
+  }
+
+  // Paren ID and destination state of each open paren arc.
+  const std::vector<std::pair<Label, StateId>> &OpenParens() const {
+    return open_parens_;
+  }
+
+  const CloseParenMultimap &CloseParens() const { return close_parens_; }
+
+  std::istream &Read(std::istream &strm) {  // NOLINT
+    ReadType(strm, &parens_);
+    ReadType(strm, &open_parens_);
+    int64 size;
+    ReadType(strm, &size);
+    close_parens_.clear();
+    for (int64 i = 0; i < size && strm; ++i) {
+      ParenState<A> paren_state;
+      A arc;
+      ReadType(strm, &paren_state.paren_id);
+      ReadType(strm, &paren_state.state_id);
+      ReadType(strm, &arc.ilabel);
+      ReadType(strm, &arc.olabel);
+      arc.weight.Read(strm);
+      ReadType(strm, &arc.nextstate);
+      close_parens_.insert(std::make_pair(paren_state, arc));
+    }
+    InitParenIds();
+    return strm;
+  }
+
+  std::ostream &Write(std::ostream &strm) const {  // NOLINT
+    WriteType(strm, parens_);
+    WriteType(strm, open_parens_);
+    int64 size = close_parens_.size();
+    WriteType(strm, size);
+    for (const auto &entry : close_parens_) {
+      WriteType(strm, entry.first.paren_id);
+      WriteType(strm, entry.first.state_id);
+      WriteType(strm, entry.second.ilabel);
+      WriteType(strm, entry.second.olabel);
+      entry.second.weight.Write(strm);
+      WriteType(strm, entry.second.nextstate);
+    }
+    return strm;
+  }
+
+ private:
+  void InitParenIds() {
+    paren_id_map_.clear();
+    for (size_t i = 0; i < parens_.size(); ++i) {
+      paren_id_map_[parens_[i].first] = i;
+      paren_id_map_[parens_[i].second] = i;
+    }
+  }
+
+  std::vector<std::pair<Label, Label>> parens_;
+  std::unordered_map<Label, Label> paren_id_map_;
+  std::vector<std::pair<Label, StateId>> open_parens_;
+  CloseParenMultimap close_parens_;
+};
+
 }  // namespace fst
 
 #endif  // FST_EXTENSIONS_PDT_PAREN_H_
@@ -11,6 +11,7 @@
 
 #include <fst/extensions/pdt/compose.h>
 #include <fst/extensions/pdt/expand.h>
+#include <fst/extensions/pdt/paren-index.h>
 #include <fst/extensions/pdt/pdt.h>
 #include <fst/extensions/pdt/replace.h>
 #include <fst/extensions/pdt/reverse.h>
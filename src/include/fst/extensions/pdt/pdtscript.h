@@ -8,6 +8,8 @@
 #define FST_EXTENSIONS_PDT_PDTSCRIPT_H_
 
 #include <algorithm>
+#include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -63,9 +65,18 @@ struct PdtExpandOptions {
   bool connect;
   bool keep_parentheses;
   const WeightClass &weight_threshold;
-
-  PdtExpandOptions(bool c, bool k, const WeightClass &w)
-      : connect(c), keep_parentheses(k), weight_threshold(w) {}
+  // If not empty, the file of the paren index used when pruning; the index
+  // is computed and written to it if write_paren_index, and read otherwise.
+  string paren_index;
+  bool write_paren_index;
+
+  PdtExpandOptions(bool c, bool k, const WeightClass &w,
+                   const string &pi = "", bool wpi = false)
+      : connect(c),
+        keep_parentheses(k),
+        weight_threshold(w),
+        paren_index(pi),
+        write_paren_index(wpi) {}
 };
 
 typedef args::Package<const FstClass &, const std::vector<LabelPair> &,
@@ -82,10 +93,28 @@ void PdtExpand(PdtExpandArgs *args) {
   std::vector<std::pair<typename Arc::Label,
                         typename Arc::Label>> typed_parens(args->arg2.size());
   std::copy(args->arg2.begin(), args->arg2.end(), typed_parens.begin());
+  const PdtExpandOptions &opts = args->arg4;
+  std::unique_ptr<PdtParenIndex<Arc>> paren_index;
+  if (!opts.paren_index.empty()) {
+    if (opts.write_paren_index) {
+      paren_index.reset(new PdtParenIndex<Arc>(fst, typed_parens));
+      if (paren_index->Error() || !paren_index->Write(opts.paren_index)) {
+        ofst->SetProperties(kError, kError);
+        return;
+      }
+    } else {
+      paren_index.reset(PdtParenIndex<Arc>::Read(opts.paren_index));
+      if (!paren_index) {
+        ofst->SetProperties(kError, kError);
+        return;
+      }
+    }
+  }
   Expand(fst, typed_parens, ofst,
-         fst::PdtExpandOptions<Arc>(args->arg4.connect,
-         args->arg4.keep_parentheses,
-         *(args->arg4.weight_threshold.GetWeight<typename Arc::Weight>())));
+         fst::PdtExpandOptions<Arc>(
+             opts.connect, opts.keep_parentheses,
+             *(opts.weight_threshold.GetWeight<typename Arc::Weight>()),
+             paren_index.get()));
 }
 
 void PdtExpand(const FstClass &ifst, const std::vector<LabelPair> &parens,
@@ -155,10 +184,18 @@ struct PdtShortestPathOptions {
   QueueType queue_type;
   bool keep_parentheses;
   bool path_gc;
+  WeightClass weight_threshold;  // No pruning if untyped.
+  int64 state_threshold;
 
   PdtShortestPathOptions(QueueType qt = FIFO_QUEUE, bool kp = false,
-                         bool gc = true)
-      : queue_type(qt), keep_parentheses(kp), path_gc(gc) {}
+                         bool gc = true,
+                         const WeightClass &w = WeightClass(),
+                         int64 s = kNoStateId)
+      : queue_type(qt),
+        keep_parentheses(kp),
+        path_gc(gc),
+        weight_threshold(w),
+        state_threshold(s) {}
 };
 
 typedef args::Package<const FstClass &, const std::vector<LabelPair> &,
@@ -176,27 +213,43 @@ void PdtShortestPath(PdtShortestPathArgs *args) {
   std::vector<std::pair<typename Arc::Label,
                         typename Arc::Label>> typed_parens(args->arg2.size());
   std::copy(args->arg2.begin(), args->arg2.end(), typed_parens.begin());
+  typename Arc::Weight weight_threshold = Arc::Weight::Zero();
+  if (opts.weight_threshold.Type() != "none") {
+    const auto *weight =
+        opts.weight_threshold.GetWeight<typename Arc::Weight>();
+    if (!weight) {
+      FSTERROR() << "PdtShortestPath: Weight threshold type "
+                 << opts.weight_threshold.Type() << " does not match arc type "
+                 << Arc::Type();
+      ofst->SetProperties(kError, kError);
+      return;
+    }
+    weight_threshold = *weight;
+  }
   switch (opts.queue_type) {
     default:
       FSTERROR() << "Unknown queue type: " << opts.queue_type;
     case FIFO_QUEUE: {
       using Queue = FifoQueue<typename Arc::StateId>;
-      fst::PdtShortestPathOptions<Arc, Queue> spopts(opts.keep_parentheses,
-                                                         opts.path_gc);
+      fst::PdtShortestPathOptions<Arc, Queue> spopts(
+          opts.keep_parentheses, opts.path_gc, weight_threshold,
+          opts.state_threshold);
       ShortestPath(fst, typed_parens, ofst, spopts);
       return;
     }
     case LIFO_QUEUE: {
       using Queue = LifoQueue<typename Arc::StateId>;
-      fst::PdtShortestPathOptions<Arc, Queue> spopts(opts.keep_parentheses,
-                                                         opts.path_gc);
+      fst::PdtShortestPathOptions<Arc, Queue> spopts(
+          opts.keep_parentheses, opts.path_gc, weight_threshold,
+          opts.state_threshold);
       ShortestPath(fst, typed_parens, ofst, spopts);
       return;
     }
     case STATE_ORDER_QUEUE: {
       using Queue = StateOrderQueue<typename Arc::StateId>;
-      fst::PdtShortestPathOptions<Arc, Queue> spopts(opts.keep_parentheses,
-                                                         opts.path_gc);
+      fst::PdtShortestPathOptions<Arc, Queue> spopts(
+          opts.keep_parentheses, opts.path_gc, weight_threshold,
+          opts.state_threshold);
       ShortestPath(fst, typed_parens, ofst, spopts);
       return;
     }
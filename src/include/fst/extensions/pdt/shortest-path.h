@@ -16,13 +16,45 @@
 
 namespace fst {
 
+// When 'weight_threshold' is not Zero(), a search state is pruned once the
+// best complete path found so far times 'weight_threshold' is less than the
+// state's distance from the PDT start state times its estimated distance to
+// the final states in 'prune_estimates' (One() if not given). The estimates
+// are used only for this pruning test and not to order the search, so this
+// is not an A* search: the queue discipline is unchanged and the estimates
+// do not speed up finding the first complete path. If the estimates can
+// exceed the true distances, or since the distance of a state inside a
+// parenthesized sub-graph is taken w.r.t. the path on which that sub-graph
+// was first entered, the best path may be pruned. When 'state_threshold' is
+// not kNoStateId, no new search states are created once that many are being
+// stored. Both make the search approximate and bound its memory. When
+// 'paren_arcs' is given, it must have been computed for the same PDT and
+// parentheses and is used instead of scanning the PDT for its parenthesis
+// arcs.
 template <class Arc, class Queue>
 struct PdtShortestPathOptions {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+
   bool keep_parentheses;
   bool path_gc;
-
-  PdtShortestPathOptions(bool kp = false, bool gc = true)
-      : keep_parentheses(kp), path_gc(gc) {}
+  Weight weight_threshold;  // Pruning weight threshold.
+  StateId state_threshold;  // Pruning search state threshold.
+  // Optional estimates of the distance from each PDT state to the final
+  // states, indexed by state, used only for pruning; not owned.
+  const std::vector<Weight> *prune_estimates;
+  const PdtParenArcs<Arc> *paren_arcs;  // Optional, not owned
+
+  PdtShortestPathOptions(bool kp = false, bool gc = true,
+                         Weight w = Weight::Zero(), StateId s = kNoStateId,
+                         const std::vector<Weight> *e = nullptr,
+                         const PdtParenArcs<Arc> *pa = nullptr)
+      : keep_parentheses(kp),
+        path_gc(gc),
+        weight_threshold(std::move(w)),
+        state_threshold(s),
+        prune_estimates(e),
+        paren_arcs(pa) {}
 };
 
 // Class to store PDT shortest path results. Stores shortest path
@@ -115,8 +147,10 @@ class PdtShortestPathData {
     search_multimap_.clear();
     paren_map_.clear();
     state_ = SearchState(kNoStateId, kNoStateId);
+    paren_ = ParenSpec(kNoLabel, kNoStateId, kNoStateId);
     nstates_ = 0;
     ngc_ = 0;
+    finished_ = false;
   }
 
   Weight Distance(SearchState s) const {
@@ -182,6 +216,23 @@ class PdtShortestPathData {
     data->flags |= f & mask;
   }
 
+  // Number of search states currently stored.
+  size_t NumSearchStates() const { return search_map_.size(); }
+
+  bool HasSearchState(SearchState s) const {
+    return search_map_.find(s) != search_map_.end();
+  }
+
+  // Appends the stored search states with a non-Zero() distance and their
+  // distances to 'states'.
+  void GetSearchStates(
+      std::vector<std::pair<SearchState, Weight>> *states) const {
+    for (const auto &entry : search_map_) {
+      if (entry.second.distance != Weight::Zero())
+        states->push_back(std::make_pair(entry.first, entry.second.distance));
+    }
+  }
+
   void GC(StateId s);
 
   void Finish() { finished_ = true; }
@@ -347,7 +398,9 @@ const uint8 PdtShortestPathData<Arc>::kMarked = 0x04;
 // straight-forward. In general, this will not be the case, so the
 // algorithm (implicitly) creates a new graph where each state is a
 // pair of an original state and a possible parenthesis 'start' state
-// for that state.
+// for that state. The parenthesis arcs of the PDT are indexed once on
+// construction (or given in the options), so ShortestPath() can be called
+// repeatedly.
 template <class Arc, class Queue>
 class PdtShortestPath {
  public:
@@ -370,6 +423,10 @@ class PdtShortestPath {
         keep_parens_(opts.keep_parentheses),
         start_(ifst.Start()),
         sp_data_(opts.path_gc),
+        paren_arcs_(opts.paren_arcs),
+        weight_threshold_(opts.weight_threshold),
+        state_threshold_(opts.state_threshold),
+        prune_estimates_(opts.prune_estimates),
         error_(false) {
     if ((Weight::Properties() & (kPath | kRightSemiring)) !=
         (kPath | kRightSemiring)) {
@@ -378,17 +435,18 @@ class PdtShortestPath {
       error_ = true;
     }
 
-    for (Label i = 0; i < parens.size(); ++i) {
-      const std::pair<Label, Label> &p = parens[i];
-      paren_id_map_[p.first] = i;
-      paren_id_map_[p.second] = i;
+    // Finds open parens per destination state and close parens per source
+    // state, unless given.
+    if (!paren_arcs_) {
+      own_paren_arcs_.reset(new PdtParenArcs<Arc>(*ifst_, parens));
+      paren_arcs_ = own_paren_arcs_.get();
     }
   }
 
   ~PdtShortestPath() {
     VLOG(1) << "# of input states: " << CountStates(*ifst_);
     VLOG(1) << "# of enqueued: " << nenqueued_;
-    VLOG(1) << "cpmm size: " << close_paren_multimap_.size();
+    VLOG(1) << "cpmm size: " << paren_arcs_->CloseParens().size();
   }
 
   void ShortestPath(MutableFst<Arc> *ofst) {
@@ -414,11 +472,10 @@ class PdtShortestPath {
 
  public:
   // Hash multimap from close paren label to an paren arc.
-  typedef std::unordered_multimap<
-      ParenState<Arc>, Arc, typename ParenState<Arc>::Hash> CloseParenMultimap;
+  typedef typename PdtParenArcs<Arc>::CloseParenMultimap CloseParenMultimap;
 
   const CloseParenMultimap &GetCloseParenMultimap() const {
-    return close_paren_multimap_;
+    return paren_arcs_->CloseParens();
   }
 
  private:
@@ -430,6 +487,7 @@ class PdtShortestPath {
   void ProcCloseParen(Label paren_id, SearchState s, const Arc &arc, Weight w);
   void ProcNonParen(SearchState s, const Arc &arc, Weight w);
   void Relax(SearchState s, SearchState t, Arc arc, Weight w, Label paren_id);
+  bool Prune(SearchState d, const Weight &w) const;
   void Enqueue(SearchState d);
   void GetPath();
   Arc GetPathArc(SearchState s, SearchState p, Label paren_id, bool open);
@@ -443,10 +501,15 @@ class PdtShortestPath {
   Weight f_distance_;
   SearchState f_parent_;
   SpData sp_data_;
-  std::unordered_map<Label, Label> paren_id_map_;
-  CloseParenMultimap close_paren_multimap_;
+  std::unique_ptr<const PdtParenArcs<Arc>> own_paren_arcs_;
+  const PdtParenArcs<Arc> *paren_arcs_;
   PdtBalanceData<Arc> balance_data_;
   ssize_t nenqueued_;
+  Weight weight_threshold_;
+  StateId state_threshold_;
+  const std::vector<Weight> *prune_estimates_;
+  Weight offset_;  // Distance to the current sub-graph 'start' state
+  NaturalLess<Weight> less_;
   bool error_;
 };
 
@@ -461,30 +524,14 @@ void PdtShortestPath<Arc, Queue>::Init(MutableFst<Arc> *ofst) {
 
   f_distance_ = Weight::Zero();
   f_parent_ = SearchState(kNoStateId, kNoStateId);
+  offset_ = Weight::One();
 
   sp_data_.Clear();
-  close_paren_multimap_.clear();
   balance_data_.Clear();
   nenqueued_ = 0;
 
-  // Find open parens per destination state and close parens per source state.
-  for (StateIterator<Fst<Arc>> siter(*ifst_); !siter.Done(); siter.Next()) {
-    StateId s = siter.Value();
-    for (ArcIterator<Fst<Arc>> aiter(*ifst_, s); !aiter.Done(); aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      typename std::unordered_map<Label, Label>::const_iterator pit =
-          paren_id_map_.find(arc.ilabel);
-      if (pit != paren_id_map_.end()) {  // Is a paren?
-        Label paren_id = pit->second;
-        if (arc.ilabel == parens_[paren_id].first) {  // Open paren
-          balance_data_.OpenInsert(paren_id, arc.nextstate);
-        } else {  // Close paren
-          ParenState<Arc> paren_state(paren_id, s);
-          close_paren_multimap_.insert(std::make_pair(paren_state, arc));
-        }
-      }
-    }
-  }
+  for (const auto &open_paren : paren_arcs_->OpenParens())
+    balance_data_.OpenInsert(open_paren.first, open_paren.second);
 }
 
 // Computes the shortest distance stored in a recursive way. Each
@@ -537,10 +584,8 @@ void PdtShortestPath<Arc, Queue>::ProcArcs(SearchState s) {
     Arc arc = aiter.Value();
     Weight w = Times(sp_data_.Distance(s), arc.weight);
 
-    typename std::unordered_map<Label, Label>::const_iterator pit =
-        paren_id_map_.find(arc.ilabel);
-    if (pit != paren_id_map_.end()) {  // Is a paren?
-      Label paren_id = pit->second;
+    Label paren_id = paren_arcs_->ParenId(arc.ilabel);
+    if (paren_id != kNoLabel) {  // Is a paren?
       if (arc.ilabel == parens_[paren_id].first)
         ProcOpenParen(paren_id, s, arc, w);
       else
@@ -564,13 +609,17 @@ inline void PdtShortestPath<Arc, Queue>::ProcOpenParen(Label paren_id,
   ParenSpec paren(paren_id, s.start, d.start);
   Weight pdist = sp_data_.Distance(paren);
   if (pdist != Plus(pdist, w)) {
+    if (Prune(d, w)) return;
     sp_data_.SetDistance(paren, w);
     sp_data_.SetParent(paren, s);
     Weight dist = sp_data_.Distance(d);
     if (dist == Weight::Zero()) {
       Queue *state_queue = state_queue_;
+      Weight offset = offset_;
+      offset_ = Times(offset_, w);
       GetDistance(d.start);
       state_queue_ = state_queue;
+      offset_ = offset;
     } else if (!(sp_data_.Flags(d) & kFinished)) {
       FSTERROR()
           << "PdtShortestPath: open parenthesis recursion: not bounded stack";
@@ -582,9 +631,10 @@ inline void PdtShortestPath<Arc, Queue>::ProcOpenParen(Label paren_id,
          !set_iter.Done(); set_iter.Next()) {
       SearchState cpstate(set_iter.Element(), d.start);
       ParenState<Arc> paren_state(paren_id, cpstate.state);
+      const CloseParenMultimap &close_parens = paren_arcs_->CloseParens();
       for (typename CloseParenMultimap::const_iterator cpit =
-               close_paren_multimap_.find(paren_state);
-           cpit != close_paren_multimap_.end() && paren_state == cpit->first;
+               close_parens.find(paren_state);
+           cpit != close_parens.end() && paren_state == cpit->first;
            ++cpit) {
         const Arc &cparc = cpit->second;
         Weight cpw = Times(w, Times(sp_data_.Distance(cpstate), cparc.weight));
@@ -626,6 +676,7 @@ inline void PdtShortestPath<Arc, Queue>::Relax(SearchState s, SearchState t,
                                                Arc arc, Weight w,
                                                Label paren_id) {
   SearchState d(arc.nextstate, t.start);
+  if (Prune(d, w)) return;
   Weight dist = sp_data_.Distance(d);
   if (dist != Plus(dist, w)) {
     sp_data_.SetParent(d, s);
@@ -635,6 +686,26 @@ inline void PdtShortestPath<Arc, Queue>::Relax(SearchState s, SearchState t,
   }
 }
 
+// Tests whether search state 'd', reached with distance 'w' from the current
+// sub-graph 'start' state, should be pruned by the weight or state threshold.
+template <class Arc, class Queue>
+inline bool PdtShortestPath<Arc, Queue>::Prune(SearchState d,
+                                               const Weight &w) const {
+  if (state_threshold_ != kNoStateId &&
+      sp_data_.NumSearchStates() >= static_cast<size_t>(state_threshold_) &&
+      !sp_data_.HasSearchState(d)) {
+    return true;
+  }
+  if (weight_threshold_ == Weight::Zero() || f_distance_ == Weight::Zero())
+    return false;
+  Weight estimate = Times(offset_, w);
+  if (prune_estimates_ &&
+      static_cast<size_t>(d.state) < prune_estimates_->size()) {
+    estimate = Times(estimate, (*prune_estimates_)[d.state]);
+  }
+  return less_(Times(f_distance_, weight_threshold_), estimate);
+}
+
 template <class Arc, class Queue>
 inline void PdtShortestPath<Arc, Queue>::Enqueue(SearchState s) {
   if (!(sp_data_.Flags(s) & kEnqueued)) {
@@ -701,11 +772,8 @@ Arc PdtShortestPath<Arc, Queue>::GetPathArc(SearchState s, SearchState d,
        aiter.Next()) {
     const Arc &arc = aiter.Value();
     if (arc.nextstate != d.state) continue;
-    Label arc_paren_id = kNoLabel;
-    typename std::unordered_map<Label, Label>::const_iterator pit =
-        paren_id_map_.find(arc.ilabel);
-    if (pit != paren_id_map_.end()) {
-      arc_paren_id = pit->second;
+    Label arc_paren_id = paren_arcs_->ParenId(arc.ilabel);
+    if (arc_paren_id != kNoLabel) {
       bool arc_open_paren = arc.ilabel == parens_[arc_paren_id].first;
       if (arc_open_paren != open_paren) continue;
     }
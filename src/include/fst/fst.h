@@ -870,7 +870,14 @@ class ImplToFst : public F {
   uint64 Properties(uint64 mask, bool test) const override {
     if (test) {
       uint64 knownprops, testprops = TestProperties(*this, mask, &knownprops);
-      impl_->SetProperties(testprops, knownprops);
+      // Only updates the stored properties when something new was learned,
+      // so that testing properties which are already known does not write to
+      // the FST (e.g., when it is shared between threads).
+      const uint64 props = impl_->Properties();
+      if (((props & ~knownprops) | (testprops & knownprops) |
+           (props & kError)) != props) {
+        impl_->SetProperties(testprops, knownprops);
+      }
       return testprops & mask;
     } else {
       return impl_->Properties(mask);
@@ -95,6 +95,32 @@ class VectorIntervalStore {
   T count_;
 };
 
+// Refers to IntIntervals<T> stored elsewhere, e.g. a range of a larger array
+// shared by many interval sets. The set can be read but not modified.
+template <class T>
+class ConstIntervalStore {
+ public:
+  typedef IntInterval<T> Interval;
+  typedef const Interval *Iterator;
+
+  ConstIntervalStore() : intervals_(nullptr), size_(0), count_(-1) {}
+
+  ConstIntervalStore(const Interval *intervals, T size, T count)
+      : intervals_(intervals), size_(size), count_(count) {}
+
+  const Interval *Intervals() const { return intervals_; }
+  T Size() const { return size_; }
+  T Count() const { return count_; }
+
+  Iterator begin() const { return intervals_; }
+  Iterator end() const { return intervals_ + size_; }
+
+ private:
+  const Interval *intervals_;
+  T size_;
+  T count_;
+};
+
 // Stores and operates on a set of half-open integral intervals [a,b)
 // of signed integers of type T.
 template <class T, class S = VectorIntervalStore<T>>
@@ -6,8 +6,12 @@
 #ifndef FST_LIB_INVERT_H_
 #define FST_LIB_INVERT_H_
 
+#include <memory>
+
 #include <fst/arc-map.h>
+#include <fst/fst-decl.h>
 #include <fst/mutable-fst.h>
+#include <fst/thread-pool.h>
 
 
 namespace fst {
@@ -31,7 +35,8 @@ struct InvertMapper {
 };
 
 // Inverts the transduction corresponding to an FST by exchanging the
-// FST's input and output labels. This version modifies its input.
+// FST's input and output labels. This version modifies its input. Only the
+// symbol tables of an FST known to be an acceptor are exchanged.
 //
 // Complexity:
 // - Time: O(V + E)
@@ -43,7 +48,30 @@ inline void Invert(MutableFst<Arc> *fst) {
       fst->InputSymbols() ? fst->InputSymbols()->Copy() : nullptr);
   std::unique_ptr<SymbolTable> output(
       fst->OutputSymbols() ? fst->OutputSymbols()->Copy() : nullptr);
-  ArcMap(fst, InvertMapper<Arc>());
+  if (!fst->Properties(kAcceptor, false)) ArcMap(fst, InvertMapper<Arc>());
+  fst->SetInputSymbols(output.get());
+  fst->SetOutputSymbols(input.get());
+}
+
+// Inverts a VectorFst as above, mapping the arcs of its states concurrently
+// on 'num_threads' threads (all hardware threads if num_threads <= 0). The
+// properties counted by each thread are combined at the end.
+template <class Arc, class State>
+void ParallelInvert(VectorFst<Arc, State> *fst, int num_threads) {
+  typedef typename Arc::StateId StateId;
+
+  std::unique_ptr<SymbolTable> input(
+      fst->InputSymbols() ? fst->InputSymbols()->Copy() : nullptr);
+  std::unique_ptr<SymbolTable> output(
+      fst->OutputSymbols() ? fst->OutputSymbols()->Copy() : nullptr);
+  if (!fst->Properties(kAcceptor, false)) {
+    const uint64 props = fst->Properties(kFstProperties, false);
+    ThreadPool pool(num_threads);
+    fst->MapArcs(&pool, [](StateId, Arc *begin, Arc *end, int) {
+      InvertMapper<Arc> mapper;
+      for (Arc *arc = begin; arc != end; ++arc) *arc = mapper(*arc);
+    }, InvertProperties(props));
+  }
   fst->SetInputSymbols(output.get());
   fst->SetOutputSymbols(input.get());
 }
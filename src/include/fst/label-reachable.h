@@ -20,29 +20,47 @@
 
 namespace fst {
 
-// Stores shareable data for label reachable class copies.
+// Stores shareable data for label reachable class copies. The interval sets
+// of all states are stored in one array, indexed by per-state offsets, and
+// are accessed through constant views.
 template <typename L>
 class LabelReachableData {
  public:
   typedef L Label;
   typedef IntervalSet<L> LabelIntervalSet;
   typedef typename IntervalSet<L>::Interval Interval;
+  typedef IntervalSet<L, ConstIntervalStore<L>> ConstLabelIntervalSet;
 
   explicit LabelReachableData(bool reach_input, bool keep_relabel_data = true)
       : reach_input_(reach_input),
         keep_relabel_data_(keep_relabel_data),
         have_relabel_data_(true),
-        final_label_(kNoLabel) {}
+        final_label_(kNoLabel),
+        offsets_(1, 0) {}
 
   ~LabelReachableData() {}
 
   bool ReachInput() const { return reach_input_; }
 
-  std::vector<LabelIntervalSet> *MutableIntervalSets() { return &isets_; }
+  // Sets the interval sets of the states, which must be normalized.
+  template <class Iterator>
+  void SetIntervalSets(Iterator begin, Iterator end) {
+    intervals_.clear();
+    counts_.clear();
+    offsets_.assign(1, 0);
+    for (Iterator it = begin; it != end; ++it) {
+      intervals_.insert(intervals_.end(), it->begin(), it->end());
+      counts_.push_back(it->Count());
+      offsets_.push_back(intervals_.size());
+    }
+  }
 
-  const LabelIntervalSet &GetIntervalSet(int s) const { return isets_[s]; }
+  ConstLabelIntervalSet GetIntervalSet(int s) const {
+    return ConstLabelIntervalSet(intervals_.data() + offsets_[s],
+                                 offsets_[s + 1] - offsets_[s], counts_[s]);
+  }
 
-  int NumIntervalSets() const { return isets_.size(); }
+  int NumIntervalSets() const { return counts_.size(); }
 
   std::unordered_map<L, L> *Label2Index() {
     if (!have_relabel_data_) {
@@ -64,7 +82,24 @@ class LabelReachableData {
     data->have_relabel_data_ = data->keep_relabel_data_;
     if (data->keep_relabel_data_) ReadType(istrm, &data->label2index_);
     ReadType(istrm, &data->final_label_);
-    ReadType(istrm, &data->isets_);
+    // Same format as a vector of IntervalSet<L>, read directly into the
+    // flat arrays.
+    int64 nsets = 0;
+    ReadType(istrm, &nsets);
+    data->counts_.reserve(nsets);
+    data->offsets_.reserve(nsets + 1);
+    for (int64 s = 0; s < nsets && istrm; ++s) {
+      int64 size = 0;
+      ReadType(istrm, &size);
+      size_t offset = data->intervals_.size();
+      data->intervals_.resize(offset + size);
+      istrm.read(reinterpret_cast<char *>(data->intervals_.data() + offset),
+                 size * sizeof(Interval));
+      Label count;
+      ReadType(istrm, &count);
+      data->counts_.push_back(count);
+      data->offsets_.push_back(data->intervals_.size());
+    }
     return data;
   }
 
@@ -73,19 +108,34 @@ class LabelReachableData {
     WriteType(ostrm, keep_relabel_data_);
     if (keep_relabel_data_) WriteType(ostrm, label2index_);
     WriteType(ostrm, FinalLabel());
-    WriteType(ostrm, isets_);
+    int64 nsets = counts_.size();
+    WriteType(ostrm, nsets);
+    for (int64 s = 0; s < nsets; ++s) {
+      int64 size = offsets_[s + 1] - offsets_[s];
+      WriteType(ostrm, size);
+      ostrm.write(
+          reinterpret_cast<const char *>(intervals_.data() + offsets_[s]),
+          size * sizeof(Interval));
+      WriteType(ostrm, counts_[s]);
+    }
     return true;
   }
 
  private:
-  LabelReachableData() {}
+  // Intervals are read and written as arrays, as pairs of labels.
+  static_assert(sizeof(Interval) == 2 * sizeof(Label),
+                "IntInterval must be a pair of labels");
+
+  LabelReachableData() : offsets_(1, 0) {}
 
   bool reach_input_;               // Input or output labels considered?
   bool keep_relabel_data_;         // Save label2index_ to file?
   bool have_relabel_data_;         // Using label2index_?
   Label final_label_;                     // Final label
   std::unordered_map<L, L> label2index_;  // Finds index for a label.
-  std::vector<LabelIntervalSet> isets_;  // Interval sets per state.
+  std::vector<Interval> intervals_;       // Intervals of all states.
+  std::vector<Label> counts_;             // Interval set counts per state.
+  std::vector<size_t> offsets_;  // First interval per state; one extra.
 };
 
 // Tests reachability of labels from a given state. If reach_input =
@@ -281,7 +331,7 @@ class LabelReachable {
   bool Reach(Iterator *aiter, ssize_t aiter_begin, ssize_t aiter_end,
              bool compute_weight) {
     if (error_) return false;
-    const LabelIntervalSet& iset = data_->GetIntervalSet(s_);
+    const auto iset = data_->GetIntervalSet(s_);
     ++ncalls_;
     nintervals_ += iset.Size();
 
@@ -399,7 +449,7 @@ class LabelReachable {
             indeg.push_back(0);
             ++ons;
           }
-          arc.nextstate = label2state_[label];
+          arc.nextstate = insert_result.first->second;
           aiter.SetValue(arc);
         }
         ++indeg[arc.nextstate];  // Finds in-degrees for next step.
@@ -413,7 +463,7 @@ class LabelReachable {
           indeg.push_back(0);
           ++ons;
         }
-        Arc arc(kNoLabel, kNoLabel, final_weight, label2state_[kNoLabel]);
+        Arc arc(kNoLabel, kNoLabel, final_weight, insert_result.first->second);
         fst_->AddArc(s, arc);
         ++indeg[arc.nextstate];  // Finds in-degrees for next step.
 
@@ -446,9 +496,8 @@ class LabelReachable {
     }
 
     std::vector<Label> &state2index = state_reachable.State2Index();
-    std::vector<LabelIntervalSet> &isets = *data_->MutableIntervalSets();
-    isets = state_reachable.IntervalSets();
-    isets.resize(ins);
+    const std::vector<LabelIntervalSet> &isets = state_reachable.IntervalSets();
+    data_->SetIntervalSets(isets.begin(), isets.begin() + ins);
 
     std::unordered_map<Label, Label> &label2index = *data_->Label2Index();
     for (const auto &kv : label2state_) {
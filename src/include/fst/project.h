@@ -7,7 +7,9 @@
 #define FST_LIB_PROJECT_H_
 
 #include <fst/arc-map.h>
+#include <fst/fst-decl.h>
 #include <fst/mutable-fst.h>
+#include <fst/thread-pool.h>
 
 
 namespace fst {
@@ -50,7 +52,7 @@ class ProjectMapper {
 
 // Projects an FST onto its domain or range by either copying each arcs'
 // input label to the output label or vice versa. This version modifies
-// its input.
+// its input. The arcs of an FST known to be an acceptor are not visited.
 //
 // Complexity:
 // - Time: O(V + E)
@@ -58,7 +60,31 @@ class ProjectMapper {
 // where V = # of states and E = # of arcs.
 template <class Arc>
 inline void Project(MutableFst<Arc> *fst, ProjectType project_type) {
-  ArcMap(fst, ProjectMapper<Arc>(project_type));
+  if (!fst->Properties(kAcceptor, false)) {
+    ArcMap(fst, ProjectMapper<Arc>(project_type));
+  }
+  if (project_type == PROJECT_INPUT) fst->SetOutputSymbols(fst->InputSymbols());
+  if (project_type == PROJECT_OUTPUT) {
+    fst->SetInputSymbols(fst->OutputSymbols());
+  }
+}
+
+// Projects a VectorFst as above, mapping the arcs of its states concurrently
+// on 'num_threads' threads (all hardware threads if num_threads <= 0). The
+// properties counted by each thread are combined at the end.
+template <class Arc, class State>
+void ParallelProject(VectorFst<Arc, State> *fst, ProjectType project_type,
+                     int num_threads) {
+  typedef typename Arc::StateId StateId;
+
+  if (!fst->Properties(kAcceptor, false)) {
+    const uint64 props = fst->Properties(kFstProperties, false);
+    ThreadPool pool(num_threads);
+    fst->MapArcs(&pool, [project_type](StateId, Arc *begin, Arc *end, int) {
+      ProjectMapper<Arc> mapper(project_type);
+      for (Arc *arc = begin; arc != end; ++arc) *arc = mapper(*arc);
+    }, ProjectProperties(props, project_type == PROJECT_INPUT));
+  }
   if (project_type == PROJECT_INPUT) fst->SetOutputSymbols(fst->InputSymbols());
   if (project_type == PROJECT_OUTPUT) {
     fst->SetInputSymbols(fst->OutputSymbols());
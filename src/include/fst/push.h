@@ -2,14 +2,16 @@
 // finite-state transducer library.
 //
 // Class to reweight/push an FST, and utility functions to weigh and reweight
-// an FST.
+// an FST. Also a delayed FST that pushes weights on the fly.
 
 #ifndef FST_LIB_PUSH_H_
 #define FST_LIB_PUSH_H_
 
+#include <memory>
 #include <vector>
 
 #include <fst/arc-map.h>
+#include <fst/cache.h>
 #include <fst/factor-weight.h>
 #include <fst/fst.h>
 #include <fst/reweight.h>
@@ -149,6 +151,341 @@ void Push(const Fst<Arc> &ifst, MutableFst<Arc> *ofst, uint32 ptype,
   }
 }
 
+// Potentials of the states of an FST stored in a vector, e.g. as computed
+// by ShortestDistance(); states past its end have potential Zero(). Copies
+// share the vector.
+template <class A>
+class VectorPotential {
+ public:
+  typedef typename A::StateId StateId;
+  typedef typename A::Weight Weight;
+
+  explicit VectorPotential(std::shared_ptr<const std::vector<Weight>> potential)
+      : potential_(std::move(potential)) {}
+
+  Weight operator()(StateId s) const {
+    return static_cast<size_t>(s) < potential_->size() ? (*potential_)[s]
+                                                       : Weight::Zero();
+  }
+
+ private:
+  std::shared_ptr<const std::vector<Weight>> potential_;
+};
+
+struct PushFstOptions : CacheOptions {
+  float delta;  // Convergence delta when computing the potentials
+
+  explicit PushFstOptions(const CacheOptions &opts, float delta = kDelta)
+      : CacheOptions(opts), delta(delta) {}
+
+  explicit PushFstOptions(float delta = kDelta) : delta(delta) {}
+};
+
+template <class A, class P>
+class PushFst;
+
+// Implementation of delayed weight pushing. Each state is reweighted by its
+// potential as in Reweight() when it is expanded. Rather than changing the
+// arcs of the initial state or adding an epsilon arc to keep the weight of
+// the paths when the initial state has a potential other than One() or
+// Zero(), this adds a new initial state, ID 0, that has the arcs and final
+// weight of the old one times that potential, and shifts the other state IDs
+// by one.
+template <class A, class P>
+class PushFstImpl : public CacheImpl<A> {
+  friend class StateIterator<PushFst<A, P>>;
+
+ public:
+  using FstImpl<A>::SetType;
+  using FstImpl<A>::SetProperties;
+  using FstImpl<A>::SetInputSymbols;
+  using FstImpl<A>::SetOutputSymbols;
+
+  using CacheImpl<A>::PushArc;
+  using CacheImpl<A>::HasArcs;
+  using CacheImpl<A>::HasFinal;
+  using CacheImpl<A>::HasStart;
+  using CacheImpl<A>::SetArcs;
+  using CacheImpl<A>::SetFinal;
+  using CacheImpl<A>::SetStart;
+
+  typedef A Arc;
+  typedef typename A::Weight Weight;
+  typedef typename A::StateId StateId;
+  typedef DefaultCacheStore<A> Store;
+  typedef typename Store::State State;
+
+  PushFstImpl(const Fst<A> &fst, ReweightType type, const P &potential,
+              const PushFstOptions &opts)
+      : CacheImpl<A>(opts),
+        fst_(fst.Copy()),
+        type_(type),
+        potential_(potential),
+        start_weight_(Weight::One()),
+        offset_(0) {
+    SetType("push");
+    uint64 props = ReweightProperties(fst.Properties(kCopyProperties, false));
+    if (type == REWEIGHT_TO_FINAL && !(Weight::Properties() & kRightSemiring)) {
+      FSTERROR() << "PushFst: Reweighting to the final states requires "
+                 << "Weight to be right distributive: " << Weight::Type();
+      props |= kError;
+    }
+    if (type == REWEIGHT_TO_INITIAL &&
+        !(Weight::Properties() & kLeftSemiring)) {
+      FSTERROR() << "PushFst: Reweighting to the initial state requires "
+                 << "Weight to be left distributive: " << Weight::Type();
+      props |= kError;
+    }
+    const StateId start = fst_->Start();
+    if (start != kNoStateId) {
+      const Weight weight = potential_(start);
+      if (weight != Weight::One() && weight != Weight::Zero()) {
+        start_weight_ = type_ == REWEIGHT_TO_INITIAL
+                            ? weight
+                            : Divide(Weight::One(), weight, DIVIDE_RIGHT);
+        offset_ = 1;
+        props &= ~(kAccessible | kNotAccessible | kInitialCyclic |
+                   kInitialAcyclic | kString | kNotString);
+        props |= kInitialAcyclic;
+      }
+    }
+    SetProperties(props, kCopyProperties);
+    SetInputSymbols(fst.InputSymbols());
+    SetOutputSymbols(fst.OutputSymbols());
+  }
+
+  PushFstImpl(const PushFstImpl<A, P> &impl)
+      : CacheImpl<A>(impl),
+        fst_(impl.fst_->Copy(true)),
+        type_(impl.type_),
+        potential_(impl.potential_),
+        start_weight_(impl.start_weight_),
+        offset_(impl.offset_) {
+    SetType("push");
+    SetProperties(impl.Properties(), kCopyProperties);
+    SetInputSymbols(impl.InputSymbols());
+    SetOutputSymbols(impl.OutputSymbols());
+  }
+
+  StateId Start() {
+    if (!HasStart()) SetStart(offset_ ? 0 : fst_->Start());
+    return CacheImpl<A>::Start();
+  }
+
+  Weight Final(StateId s) {
+    if (!HasFinal(s)) {
+      if (offset_ && s == 0) {
+        SetFinal(s, Times(start_weight_, PushedFinal(fst_->Start())));
+      } else {
+        SetFinal(s, PushedFinal(s - offset_));
+      }
+    }
+    return CacheImpl<A>::Final(s);
+  }
+
+  size_t NumArcs(StateId s) {
+    if (!HasArcs(s)) Expand(s);
+    return CacheImpl<A>::NumArcs(s);
+  }
+
+  size_t NumInputEpsilons(StateId s) {
+    if (!HasArcs(s)) Expand(s);
+    return CacheImpl<A>::NumInputEpsilons(s);
+  }
+
+  size_t NumOutputEpsilons(StateId s) {
+    if (!HasArcs(s)) Expand(s);
+    return CacheImpl<A>::NumOutputEpsilons(s);
+  }
+
+  uint64 Properties() const override { return Properties(kFstProperties); }
+
+  // Set error if found; return FST impl properties.
+  uint64 Properties(uint64 mask) const override {
+    if ((mask & kError) && fst_->Properties(kError, false)) {
+      SetProperties(kError, kError);
+    }
+    return FstImpl<Arc>::Properties(mask);
+  }
+
+  void InitArcIterator(StateId s, ArcIteratorData<A> *data) {
+    if (!HasArcs(s)) Expand(s);
+    CacheImpl<A>::InitArcIterator(s, data);
+  }
+
+  void Expand(StateId s) {
+    const bool initial = offset_ && s == 0;
+    const StateId t = initial ? fst_->Start() : s - offset_;
+    const Weight weight = potential_(t);
+    for (ArcIterator<Fst<A>> aiter(*fst_, t); !aiter.Done(); aiter.Next()) {
+      A arc = aiter.Value();
+      if (weight != Weight::Zero()) {
+        const Weight nextweight = potential_(arc.nextstate);
+        if (nextweight != Weight::Zero()) {
+          arc.weight =
+              type_ == REWEIGHT_TO_INITIAL
+                  ? Divide(Times(arc.weight, nextweight), weight, DIVIDE_LEFT)
+                  : Divide(Times(weight, arc.weight), nextweight,
+                           DIVIDE_RIGHT);
+        }
+      }
+      if (initial) arc.weight = Times(start_weight_, arc.weight);
+      arc.nextstate += offset_;
+      PushArc(s, arc);
+    }
+    SetArcs(s);
+  }
+
+ private:
+  // Final weight of state 't' of 'fst_' reweighted by its potential.
+  Weight PushedFinal(StateId t) {
+    const Weight weight = potential_(t);
+    if (type_ == REWEIGHT_TO_FINAL) return Times(weight, fst_->Final(t));
+    if (weight == Weight::Zero()) return fst_->Final(t);
+    return Divide(fst_->Final(t), weight, DIVIDE_LEFT);
+  }
+
+  std::unique_ptr<const Fst<A>> fst_;
+  ReweightType type_;
+  P potential_;
+  Weight start_weight_;  // Times'ed to the new initial state, if any
+  StateId offset_;       // 1 if there is a new initial state, 0 otherwise
+};
+
+// Delayed version of Push() for weights: pushes the weights of an FST
+// towards the initial state (REWEIGHT_TO_INITIAL) or the final states
+// (REWEIGHT_TO_FINAL) as its states are expanded, keeping the weight of
+// every path (see PushFstImpl for the initial state). The potentials come
+// either from the shortest distances to the final states (from the initial
+// state), computed on construction like Push() does, or from a potential
+// functor P with 'Weight operator()(StateId)', which may compute them lazily
+// for an FST that is not expanded. This lets pushing take place inside a
+// chain of delayed FSTs, e.g., before a lookahead composition.
+//
+// Complexity: as ShortestDistance() if computing the potentials, plus
+// - Time: O(d) to expand a state
+// - Space: O(e)
+// where d = # of arcs of the state and e = # of arcs visited.
+//
+// This class attaches interface to implementation and handles
+// reference counting, delegating most methods to ImplToFst.
+template <class A, class P = VectorPotential<A>>
+class PushFst : public ImplToFst<PushFstImpl<A, P>> {
+ public:
+  friend class ArcIterator<PushFst<A, P>>;
+  friend class StateIterator<PushFst<A, P>>;
+
+  typedef A Arc;
+  typedef typename A::Weight Weight;
+  typedef typename A::StateId StateId;
+  typedef DefaultCacheStore<A> Store;
+  typedef typename Store::State State;
+  typedef PushFstImpl<A, P> Impl;
+
+  // Computes the potentials of 'fst' with ShortestDistance(); P must be
+  // VectorPotential<A>. Weight needs to be left distributive when pushing
+  // towards the initial state and right distributive when pushing towards
+  // the final states.
+  PushFst(const Fst<A> &fst, ReweightType type,
+          const PushFstOptions &opts = PushFstOptions())
+      : ImplToFst<Impl>(std::make_shared<Impl>(
+            fst, type, Potentials(fst, type, opts.delta), opts)) {}
+
+  PushFst(const Fst<A> &fst, ReweightType type, const P &potential,
+          const PushFstOptions &opts = PushFstOptions())
+      : ImplToFst<Impl>(std::make_shared<Impl>(fst, type, potential, opts)) {}
+
+  // See Fst<>::Copy() for doc.
+  PushFst(const PushFst<A, P> &fst, bool safe = false)
+      : ImplToFst<Impl>(fst, safe) {}
+
+  // Get a copy of this PushFst. See Fst<>::Copy() for further doc.
+  PushFst<A, P> *Copy(bool safe = false) const override {
+    return new PushFst<A, P>(*this, safe);
+  }
+
+  inline void InitStateIterator(StateIteratorData<A> *data) const override;
+
+  void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) const override {
+    GetMutableImpl()->InitArcIterator(s, data);
+  }
+
+ private:
+  using ImplToFst<Impl>::GetImpl;
+  using ImplToFst<Impl>::GetMutableImpl;
+
+  static P Potentials(const Fst<A> &fst, ReweightType type, float delta) {
+    std::shared_ptr<std::vector<Weight>> distance =
+        std::make_shared<std::vector<Weight>>();
+    ShortestDistance(fst, distance.get(), type == REWEIGHT_TO_INITIAL, delta);
+    return P(std::move(distance));
+  }
+
+  PushFst &operator=(const PushFst &fst) = delete;
+};
+
+// Specialization for PushFst; visits the states of the underlying FST.
+template <class A, class P>
+class StateIterator<PushFst<A, P>> : public StateIteratorBase<A> {
+ public:
+  typedef typename A::StateId StateId;
+
+  explicit StateIterator(const PushFst<A, P> &fst)
+      : siter_(*fst.GetImpl()->fst_),
+        offset_(fst.GetImpl()->offset_),
+        initial_(offset_ != 0) {}
+
+  bool Done() const { return !initial_ && siter_.Done(); }
+
+  StateId Value() const { return initial_ ? 0 : siter_.Value() + offset_; }
+
+  void Next() {
+    if (initial_) {
+      initial_ = false;
+    } else {
+      siter_.Next();
+    }
+  }
+
+  void Reset() {
+    initial_ = offset_ != 0;
+    siter_.Reset();
+  }
+
+ private:
+  bool Done_() const override { return Done(); }
+  StateId Value_() const override { return Value(); }
+  void Next_() override { Next(); }
+  void Reset_() override { Reset(); }
+
+  StateIterator<Fst<A>> siter_;
+  StateId offset_;
+  bool initial_;  // At the new initial state?
+
+  StateIterator(const StateIterator &) = delete;
+  StateIterator &operator=(const StateIterator &) = delete;
+};
+
+// Specialization for PushFst.
+template <class A, class P>
+class ArcIterator<PushFst<A, P>> : public CacheArcIterator<PushFst<A, P>> {
+ public:
+  typedef typename A::StateId StateId;
+
+  ArcIterator(const PushFst<A, P> &fst, StateId s)
+      : CacheArcIterator<PushFst<A, P>>(fst.GetMutableImpl(), s) {
+    if (!fst.GetImpl()->HasArcs(s)) fst.GetMutableImpl()->Expand(s);
+  }
+};
+
+template <class A, class P>
+inline void PushFst<A, P>::InitStateIterator(StateIteratorData<A> *data) const {
+  data->base = new StateIterator<PushFst<A, P>>(*this);
+}
+
+// Useful alias when using StdArc.
+typedef PushFst<StdArc> StdPushFst;
+
 }  // namespace fst
 
 #endif /* FST_LIB_PUSH_H_ */
@@ -535,9 +535,12 @@ class AutoQueue : public QueueBase<S> {
   // This constructor takes a state distance vector that, if non-null and if
   // the Weight type has the path property, will entertain the
   // shortest-first queue using the natural order w.r.t to the distance.
+  // If 'num_threads' is not 1 and the FST is expanded, its strongly connected
+  // components are found by ParallelScc() on that many threads.
   template <class Arc, class ArcFilter>
   AutoQueue(const Fst<Arc> &fst,
-            const std::vector<typename Arc::Weight> *distance, ArcFilter filter)
+            const std::vector<typename Arc::Weight> *distance, ArcFilter filter,
+            int num_threads = 1)
       : QueueBase<S>(AUTO_QUEUE) {
     typedef typename Arc::Weight Weight;
     typedef StateWeightCompare<StateId, NaturalLess<Weight>> Compare;
@@ -555,11 +558,17 @@ class AutoQueue : public QueueBase<S> {
       queue_.reset(new LifoQueue<StateId>());
       VLOG(2) << "AutoQueue: using LIFO discipline";
     } else {
-      uint64 properties;
       // Decompose into strongly-connected components.
-      SccVisitor<Arc> scc_visitor(&scc_, nullptr, nullptr, &properties);
-      DfsVisit(fst, &scc_visitor, filter);
-      StateId nscc = *std::max_element(scc_.begin(), scc_.end()) + 1;
+      StateId nscc;
+      if (num_threads != 1 && fst.Properties(kExpanded, false)) {
+        nscc = ParallelScc(static_cast<const ExpandedFst<Arc> &>(fst), &scc_,
+                           filter, num_threads);
+      } else {
+        uint64 properties;
+        SccVisitor<Arc> scc_visitor(&scc_, nullptr, nullptr, &properties);
+        DfsVisit(fst, &scc_visitor, filter);
+        nscc = *std::max_element(scc_.begin(), scc_.end()) + 1;
+      }
       std::vector<QueueType> queue_types(nscc);
       std::unique_ptr<NaturalLess<Weight>> less;
       std::unique_ptr<Compare> comp;
@@ -6,6 +6,7 @@
 #ifndef FST_LIB_REPLACE_UTIL_H_
 #define FST_LIB_REPLACE_UTIL_H_
 
+#include <algorithm>
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
@@ -13,6 +14,7 @@
 
 #include <fst/connect.h>
 #include <fst/mutable-fst.h>
+#include <fst/thread-pool.h>
 #include <fst/topsort.h>
 #include <fst/vector-fst.h>
 
@@ -32,6 +34,18 @@ enum ReplaceLabelType {
   REPLACE_LABEL_BOTH = 4
 };
 
+// Returns true if label type on arc results in epsilon input label.
+inline bool EpsilonOnInput(ReplaceLabelType label_type) {
+  return label_type == REPLACE_LABEL_NEITHER ||
+         label_type == REPLACE_LABEL_OUTPUT;
+}
+
+// Returns true if label type on arc results in epsilon input label.
+inline bool EpsilonOnOutput(ReplaceLabelType label_type) {
+  return label_type == REPLACE_LABEL_NEITHER ||
+         label_type == REPLACE_LABEL_INPUT;
+}
+
 // By default ReplaceUtil will copy the input label of the 'replace arc'.
 // The call_label_type and return_label_type options specify how to manage
 // the labels of the call arc and the return arc of the replace FST
@@ -40,32 +54,39 @@ struct ReplaceUtilOptions {
   ReplaceLabelType call_label_type;    // how to label call arc
   ReplaceLabelType return_label_type;  // how to label return arc
   int64 return_label;                  // specifies label to put on return arc
+  // Number of threads used to expand independent Fsts in ReplaceLabels() and
+  // the methods built on it; all hardware threads if <= 0.
+  int num_threads;
 
   ReplaceUtilOptions(int64 r, ReplaceLabelType call_label_type,
                      ReplaceLabelType return_label_type, int64 return_label)
       : root(r),
         call_label_type(call_label_type),
         return_label_type(return_label_type),
-        return_label(return_label) {}
+        return_label(return_label),
+        num_threads(1) {}
 
   explicit ReplaceUtilOptions(int64 r)
       : root(r),
         call_label_type(REPLACE_LABEL_INPUT),
         return_label_type(REPLACE_LABEL_NEITHER),
-        return_label(0) {}
+        return_label(0),
+        num_threads(1) {}
 
   ReplaceUtilOptions(int64 r, bool epsilon_replace_arc)  // b/w compatibility
       : root(r),
         call_label_type((epsilon_replace_arc) ? REPLACE_LABEL_NEITHER
                                               : REPLACE_LABEL_INPUT),
         return_label_type(REPLACE_LABEL_NEITHER),
-        return_label(0) {}
+        return_label(0),
+        num_threads(1) {}
 
   ReplaceUtilOptions()
       : root(kNoLabel),
         call_label_type(REPLACE_LABEL_INPUT),
         return_label_type(REPLACE_LABEL_NEITHER),
-        return_label(0) {}
+        return_label(0),
+        num_threads(1) {}
 };
 
 //
@@ -168,7 +189,10 @@ class ReplaceUtil {
   // Removes useless Fsts, states and transitions.
   void Connect();
 
-  // Replaces Fsts specified by labels.
+  // Replaces Fsts specified by labels. The Fsts are expanded in rounds: an
+  // Fst is expanded once all Fsts it refers to are, and the Fsts of a round
+  // are expanded concurrently with up to ReplaceUtilOptions::num_threads
+  // threads. Each round only reads the Fsts expanded in earlier rounds.
   // Does nothing if there are cyclic dependencies.
   void ReplaceLabels(const std::vector<Label> &labels);
 
@@ -190,6 +214,12 @@ class ReplaceUtil {
   // Does nothing if there are cyclic dependencies.
   void ReplaceUnique() { ReplaceByInstances(1); }
 
+  // Replaces all non-terminals, expanding each Fst once (in reverse
+  // dependency order) and splicing copies of it in place of the arcs that
+  // refer to it. Afterwards, the root Fst contains the full replacement.
+  // Does nothing if there are cyclic dependencies.
+  void ReplaceAll() { ReplaceLabels(nonterminal_array_); }
+
   // Returns Label, Fst pairs; Fst ownership retained by ReplaceUtil.
   void GetFstPairs(std::vector<FstPair> *fst_pairs);
 
@@ -238,11 +268,19 @@ class ReplaceUtil {
   // dependency graph of the replace FSTs.
   void GetSCCProperties() const;
 
+  // Replaces the arcs of the sth Fst labeled with the non-terminals of the
+  // Fst IDs in 'ids' by copies of those Fsts, which must not themselves
+  // contain any of these non-terminals. As in the delayed replacement, only
+  // states accessible from the start state are kept. Only the sth Fst is
+  // modified, so Fsts with disjoint dependencies can be spliced concurrently.
+  void Splice(Label s, const std::unordered_set<Label> &ids) const;
+
   Label root_label_;                             // root non-terminal
   Label root_fst_;                               // root Fst ID
   ReplaceLabelType call_label_type_;             // see Replace()
   ReplaceLabelType return_label_type_;           // see Replace()
   int64 return_label_;                           // see Replace()
+  int num_threads_;                              // see ReplaceLabels()
   std::vector<const Fst<Arc> *> fst_array_;           // Fst per ID
   std::vector<MutableFst<Arc> *> mutable_fst_array_;  // MutableFst per ID
   std::vector<Label> nonterminal_array_;              // Fst ID to non-terminal
@@ -265,6 +303,7 @@ ReplaceUtil<Arc>::ReplaceUtil(const std::vector<MutableFstPair> &fst_pairs,
       call_label_type_(opts.call_label_type),
       return_label_type_(opts.return_label_type),
       return_label_(opts.return_label),
+      num_threads_(opts.num_threads),
       depprops_(0),
       have_stats_(false) {
   fst_array_.push_back(nullptr);
@@ -291,6 +330,7 @@ ReplaceUtil<Arc>::ReplaceUtil(const std::vector<FstPair> &fst_pairs,
       call_label_type_(opts.call_label_type),
       return_label_type_(opts.return_label_type),
       return_label_(opts.return_label),
+      num_threads_(opts.num_threads),
       depprops_(0),
       have_stats_(false) {
   fst_array_.push_back(nullptr);
@@ -316,6 +356,7 @@ ReplaceUtil<Arc>::ReplaceUtil(
       call_label_type_(opts.call_label_type),
       return_label_type_(opts.return_label_type),
       return_label_(opts.return_label),
+      num_threads_(opts.num_threads),
       nonterminal_array_(fst_array.size()),
       nonterminal_hash_(nonterminal_hash),
       depprops_(0),
@@ -446,10 +487,11 @@ template <class Arc>
 void ReplaceUtil<Arc>::Connect() {
   CheckMutableFsts();
   uint64 props = kAccessible | kCoAccessible;
+  DfsScratch<Arc> scratch;  // Shared by the DFS of each FST.
   for (Label i = 0; i < mutable_fst_array_.size(); ++i) {
     if (!mutable_fst_array_[i]) continue;
     if (mutable_fst_array_[i]->Properties(props, false) != props) {
-      fst::Connect(mutable_fst_array_[i]);
+      fst::Connect(mutable_fst_array_[i], &scratch);
     }
   }
   GetDependencies(false);
@@ -515,30 +557,149 @@ void ReplaceUtil<Arc>::ReplaceLabels(const std::vector<Label> &labels) {
     return;
   }
 
-  // Visits Fsts in reverse topological order of dependencies and
-  // performs replacements.
+  // Visits Fsts in reverse topological order of dependencies, assigning
+  // each Fst to the round after those of the Fsts it refers to. Each Fst is
+  // thus fully expanded (w.r.t. the requested labels) once, before copies of
+  // it are spliced into the Fsts that refer to it.
+  std::vector<std::vector<Label>> rounds;
+  std::vector<std::unordered_set<Label>> ids(pfst.NumStates());
+  std::vector<size_t> round(pfst.NumStates(), 0);
   for (Label o = toporder.size() - 1; o >= 0; --o) {
-    std::vector<FstPair> fst_pairs;
     StateId s = toporder[o];
+    if (!mutable_fst_array_[s]) continue;
     for (ArcIterator<VectorFst<Arc>> aiter(pfst, s); !aiter.Done();
          aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      Label label = nonterminal_array_[arc.nextstate];
-      const Fst<Arc> *fst = fst_array_[arc.nextstate];
-      fst_pairs.push_back(std::make_pair(label, fst));
+      const Label id = aiter.Value().nextstate;
+      if (!mutable_fst_array_[id]) continue;
+      ids[s].insert(id);
+      round[s] = std::max(round[s], round[id] + 1);
+    }
+    if (ids[s].empty()) continue;
+    if (rounds.size() < round[s]) rounds.resize(round[s]);
+    rounds[round[s] - 1].push_back(s);
+  }
+  if (!rounds.empty()) {
+    ThreadPool pool(num_threads_);
+    for (const auto &fsts : rounds) {
+      pool.ParallelFor(fsts.size(), [&](size_t i, int) {
+        Splice(fsts[i], ids[fsts[i]]);
+      });
     }
-    if (fst_pairs.empty()) continue;
-    Label label = nonterminal_array_[s];
-    const Fst<Arc> *fst = fst_array_[s];
-    fst_pairs.push_back(std::make_pair(label, fst));
-
-    Replace(fst_pairs, mutable_fst_array_[s],
-            ReplaceUtilOptions(label, call_label_type_, return_label_type_,
-                               return_label_));
   }
   ClearDependencies();
 }
 
+template <class Arc>
+void ReplaceUtil<Arc>::Splice(Label s,
+                              const std::unordered_set<Label> &ids) const {
+  MutableFst<Arc> *fst = mutable_fst_array_[s];
+  const Label return_ilabel =
+      EpsilonOnInput(return_label_type_) ? 0 : return_label_;
+  const Label return_olabel =
+      EpsilonOnOutput(return_label_type_) ? 0 : return_label_;
+  const StateId nstates = fst->NumStates();
+  // The states of each spliced Fst accessible from its start state, in
+  // order of discovery; maps Fst ID to the states and their copy indices.
+  std::unordered_map<Label, std::vector<StateId>> accessible;
+  std::unordered_map<Label, std::vector<StateId>> index;
+  // As in ReplaceFst, calls to the same Fst which return to the same state
+  // share a single copy; maps (Fst ID, return state) to the copy's offset.
+  std::map<std::pair<Label, StateId>, StateId> copies;
+  std::vector<Arc> arcs;
+  for (StateId p = 0; p < nstates; ++p) {
+    arcs.clear();
+    bool replace = false;
+    for (ArcIterator<MutableFst<Arc>> aiter(*fst, p); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      auto it = nonterminal_hash_.find(arc.olabel);
+      if (arc.olabel != 0 && it != nonterminal_hash_.end() &&
+          ids.count(it->second) > 0) {
+        replace = true;
+      }
+      arcs.push_back(arc);
+    }
+    if (!replace) continue;
+    fst->DeleteArcs(p);
+    for (const Arc &arc : arcs) {
+      auto it = nonterminal_hash_.find(arc.olabel);
+      if (arc.olabel == 0 || it == nonterminal_hash_.end() ||
+          ids.count(it->second) == 0) {
+        fst->AddArc(p, arc);
+        continue;
+      }
+      // As in ReplaceFst, the arc is deleted when the replacing Fst is empty.
+      const Label id = it->second;
+      const Fst<Arc> &rfst = *fst_array_[id];
+      const StateId rstart = rfst.Start();
+      if (rstart == kNoStateId) continue;
+      std::vector<StateId> &rstates = accessible[id];
+      std::vector<StateId> &rindex = index[id];
+      if (rstates.empty()) {
+        rindex.assign(CountStates(rfst), kNoStateId);
+        rindex[rstart] = 0;
+        rstates.push_back(rstart);
+        for (size_t i = 0; i < rstates.size(); ++i) {
+          for (ArcIterator<Fst<Arc>> raiter(rfst, rstates[i]); !raiter.Done();
+               raiter.Next()) {
+            const StateId nextstate = raiter.Value().nextstate;
+            if (rindex[nextstate] != kNoStateId) continue;
+            rindex[nextstate] = rstates.size();
+            rstates.push_back(nextstate);
+          }
+        }
+      }
+      const auto key = std::make_pair(id, arc.nextstate);
+      auto cit = copies.find(key);
+      const StateId offset =
+          cit == copies.end() ? fst->NumStates() : cit->second;
+      const Label ilabel = EpsilonOnInput(call_label_type_) ? 0 : arc.ilabel;
+      const Label olabel = EpsilonOnOutput(call_label_type_) ? 0 : arc.olabel;
+      fst->AddArc(p, Arc(ilabel, olabel, arc.weight, offset));
+      if (cit != copies.end()) continue;
+      copies[key] = offset;
+      for (size_t i = 0; i < rstates.size(); ++i) fst->AddState();
+      for (size_t i = 0; i < rstates.size(); ++i) {
+        const Weight final = rfst.Final(rstates[i]);
+        if (final != Weight::Zero()) {
+          fst->AddArc(offset + i, Arc(return_ilabel, return_olabel, final,
+                                      arc.nextstate));
+        }
+        for (ArcIterator<Fst<Arc>> raiter(rfst, rstates[i]); !raiter.Done();
+             raiter.Next()) {
+          const Arc &rarc = raiter.Value();
+          fst->AddArc(offset + i, Arc(rarc.ilabel, rarc.olabel, rarc.weight,
+                                      offset + rindex[rarc.nextstate]));
+        }
+      }
+    }
+  }
+  // Removes the states of the calling Fst that are not accessible, which may
+  // only be reached through a return from a spliced Fst.
+  std::vector<bool> access(fst->NumStates(), false);
+  std::vector<StateId> queue;
+  if (fst->Start() != kNoStateId) {
+    access[fst->Start()] = true;
+    queue.push_back(fst->Start());
+  }
+  while (!queue.empty()) {
+    const StateId q = queue.back();
+    queue.pop_back();
+    for (ArcIterator<MutableFst<Arc>> aiter(*fst, q); !aiter.Done();
+         aiter.Next()) {
+      const StateId nextstate = aiter.Value().nextstate;
+      if (access[nextstate]) continue;
+      access[nextstate] = true;
+      queue.push_back(nextstate);
+    }
+  }
+  std::vector<StateId> dstates;
+  for (size_t q = 0; q < access.size(); ++q) {
+    if (!access[q]) dstates.push_back(q);
+  }
+  if (!dstates.empty()) fst->DeleteStates(dstates);
+}
+
 template <class Arc>
 void ReplaceUtil<Arc>::ReplaceBySize(size_t nstates, size_t narcs,
                                      size_t nnonterms) {
@@ -636,6 +797,7 @@ void ReplaceUtil<Arc>::GetSCCProperties() const {
   }
 
   std::vector<bool> depscc_visited(depscc_.size(), false);
+  DfsScratch<Arc> scratch;  // Shared by the DFS of each FST.
   for (Label i = 0; i < fst_array_.size(); ++i) {
     const Fst<Arc> *fst = fst_array_[i];
     if (!fst) {
@@ -651,7 +813,7 @@ void ReplaceUtil<Arc>::GetSCCProperties() const {
     std::vector<StateId> fstscc;  // SCCs of the current FST
     uint64 fstprops;
     SccVisitor<Arc> scc_visitor(&fstscc, nullptr, nullptr, &fstprops);
-    DfsVisit(*fst, &scc_visitor);
+    DfsVisit(*fst, &scc_visitor, AnyArcFilter<Arc>(), false, &scratch);
 
     for (StateIterator<Fst<Arc> > siter(*fst); !siter.Done(); siter.Next()) {
       StateId s = siter.Value();
@@ -449,18 +449,6 @@ class ReplaceFstMatcher;
 template <class Arc>
 using FstList = std::vector<std::pair<typename Arc::Label, const Fst<Arc>*>>;
 
-// Returns true if label type on arc results in epsilon input label.
-inline bool EpsilonOnInput(ReplaceLabelType label_type) {
-  return label_type == REPLACE_LABEL_NEITHER ||
-         label_type == REPLACE_LABEL_OUTPUT;
-}
-
-// Returns true if label type on arc results in epsilon input label.
-inline bool EpsilonOnOutput(ReplaceLabelType label_type) {
-  return label_type == REPLACE_LABEL_NEITHER ||
-         label_type == REPLACE_LABEL_INPUT;
-}
-
 // Returns true if for either the call or return arc ilabel != olabel.
 template <class Label>
 bool ReplaceTransducer(ReplaceLabelType call_label_type,
@@ -1589,6 +1577,37 @@ void Replace(const std::vector<std::pair<typename Arc::Label, const Fst<Arc>*>>&
   Replace(ifst_array, ofst, ReplaceFstOptions<Arc>(root));
 }
 
+// Eager recursive replacement which, rather than copying the delayed
+// ReplaceFst state by state, expands each non-terminal Fst once, in reverse
+// order of the non-terminal dependencies, and splices copies of the expansion
+// in place of the arcs referring to it (see ReplaceUtil::ReplaceAll()).
+// Fsts whose dependencies are expanded are spliced concurrently, using up to
+// opts.num_threads threads. The result has the same states as that of
+// Replace(), though they may be numbered differently. With cyclic
+// dependencies, this falls back on Replace().
+template <class Arc>
+void SpliceReplace(
+    const std::vector<std::pair<typename Arc::Label, const Fst<Arc>*>>&
+        ifst_array,
+    MutableFst<Arc>* ofst, const ReplaceUtilOptions& opts) {
+  ReplaceUtil<Arc> replace_util(ifst_array, opts);
+  if (replace_util.CyclicDependencies()) {
+    Replace(ifst_array, ofst, opts);
+    return;
+  }
+  replace_util.ReplaceAll();
+  std::vector<std::pair<typename Arc::Label, const Fst<Arc>*>> fst_pairs;
+  replace_util.GetFstPairs(&fst_pairs);
+  for (const auto& fst_pair : fst_pairs) {
+    if (fst_pair.first == opts.root) {
+      *ofst = *fst_pair.second;
+      return;
+    }
+  }
+  ofst->DeleteStates();
+  ofst->SetProperties(kError, kError);
+}
+
 }  // namespace fst
 
 #endif  // FST_LIB_REPLACE_H_
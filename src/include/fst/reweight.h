@@ -15,6 +15,39 @@ namespace fst {
 
 enum ReweightType { REWEIGHT_TO_INITIAL, REWEIGHT_TO_FINAL };
 
+namespace internal {
+
+// Returns true if the initial state is on no cycle, by searching the states
+// reachable from it for an arc back to it; cheaper than computing the
+// kInitialAcyclic property, which visits the whole FST and finds its SCCs.
+template <class Arc>
+bool InitialAcyclic(const Fst<Arc> &fst) {
+  typedef typename Arc::StateId StateId;
+
+  const uint64 props = fst.Properties(kInitialAcyclic | kInitialCyclic, false);
+  if (props) return props & kInitialAcyclic;
+  const StateId start = fst.Start();
+  std::vector<bool> visited;
+  std::vector<StateId> stack(1, start);
+  while (!stack.empty()) {
+    const StateId s = stack.back();
+    stack.pop_back();
+    for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const StateId nextstate = aiter.Value().nextstate;
+      if (nextstate == start) return false;
+      if (static_cast<size_t>(nextstate) >= visited.size()) {
+        visited.resize(nextstate + 1, false);
+      }
+      if (visited[nextstate]) continue;
+      visited[nextstate] = true;
+      stack.push_back(nextstate);
+    }
+  }
+  return true;
+}
+
+}  // namespace internal
+
 // Reweight FST according to the potentials defined by the POTENTIAL
 // vector in the direction defined by TYPE. Weight needs to be left
 // distributive when reweighting towards the initial state and right
@@ -89,7 +122,7 @@ void Reweight(MutableFst<Arc> *fst,
                                          ? potential[fst->Start()]
                                          : Weight::Zero();
   if ((startweight != Weight::One()) && (startweight != Weight::Zero())) {
-    if (fst->Properties(kInitialAcyclic, true) & kInitialAcyclic) {
+    if (internal::InitialAcyclic(*fst)) {
       typename Arc::StateId state = fst->Start();
       for (MutableArcIterator<MutableFst<Arc>> ait(fst, state); !ait.Done();
            ait.Next()) {
@@ -6,8 +6,8 @@
 #ifndef FST_LIB_RMEPSILON_H_
 #define FST_LIB_RMEPSILON_H_
 
-#include <forward_list>
-#include <stack>
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -21,6 +21,7 @@
 #include <fst/prune.h>
 #include <fst/queue.h>
 #include <fst/shortest-distance.h>
+#include <fst/thread-pool.h>
 #include <fst/topsort.h>
 
 
@@ -57,12 +58,17 @@ class RmEpsilonState {
   typedef typename Arc::StateId StateId;
   typedef typename Arc::Weight Weight;
 
+  // If 'closure_cache_limit' is positive, the epsilon-closures of states
+  // expanded more than once are memoized, using up to that many bytes.
   RmEpsilonState(const Fst<Arc> &fst, std::vector<Weight> *distance,
-                 const RmEpsilonOptions<Arc, Queue> &opts)
+                 const RmEpsilonOptions<Arc, Queue> &opts,
+                 size_t closure_cache_limit = 0)
       : fst_(fst),
         distance_(distance),
         sd_state_(fst_, distance, opts, true),
-        expand_id_(0) {}
+        expand_id_(0),
+        closure_cache_limit_(closure_cache_limit),
+        closure_cache_size_(0) {}
 
   // Compute arcs and final weight for state 's'
   void Expand(StateId s);
@@ -100,34 +106,53 @@ class RmEpsilonState {
    private:
   };
 
-  class ElementEqual {
-   public:
-    bool operator()(const Element &e1, const Element &e2) const {
-      return (e1.ilabel == e2.ilabel) && (e1.olabel == e2.olabel) &&
-             (e1.nextstate == e2.nextstate);
-    }
-  };
+  // Adds 'arc' to 'arcs_', summing its weight into an arc with the same
+  // labels and destination if there is one.
+  void AddArc(const Arc &arc);
+
+  // Adds the non-epsilon arcs and final weight of the states of a memoized
+  // epsilon-closure.
+  void ExpandClosure(const std::vector<std::pair<StateId, Weight>> &closure);
+
+  // Memoizes the epsilon-closure of 'source', given by 'visited_states_' and
+  // 'distance_', if it fits in the closure cache.
+  void CacheClosure(StateId source);
 
-  typedef std::unordered_map<Element, std::pair<StateId, size_t>, ElementKey,
-                             ElementEqual> ElementMap;
+  // Resizes 'element_table_' to 'size' slots and re-enters 'arcs_'.
+  void ResizeElementTable(size_t size);
+
+  // Returns the index of the slot for 'arc' in 'element_table_': the slot
+  // holding the equal arc of 'arcs_' or else the first one not in use.
+  size_t FindElement(const Arc &arc) const;
 
   const Fst<Arc> &fst_;
   // Distance from state being expanded in epsilon-closure.
   std::vector<Weight> *distance_;
   // Shortest distance algorithm computation state.
   ShortestDistanceState<Arc, Queue, EpsilonArcFilter<Arc>> sd_state_;
-  // Maps an element 'e' to a pair 'p' corresponding to a position
-  // in the arcs vector of the state being expanded. 'e' corresponds
-  // to the position 'p.second' in the 'arcs_' vector if 'p.first' is
-  // equal to the state being expanded.
-  ElementMap element_map_;
+  // Open-addressing hash table of the arcs of the state being expanded. A
+  // slot 'p' holds the position 'p.second' in the 'arcs_' vector if
+  // 'p.first' is equal to the current expansion ID and is unused otherwise,
+  // so the table never needs to be cleared and its size is bounded by the
+  // largest expansion rather than by the whole FST.
+  std::vector<std::pair<StateId, size_t>> element_table_;
   EpsilonArcFilter<Arc> eps_filter_;
-  std::stack<StateId> eps_queue_;  // Queue used to visit the epsilon-closure
+  // Stack used to visit the epsilon-closure and list of visited states; kept
+  // across calls to Expand() to reuse their storage.
+  std::vector<StateId> eps_queue_;
   std::vector<bool> visited_;      // '[i] = true' if state 'i' has been visited
-  std::forward_list<StateId> visited_states_;  // List of visited states
+  std::vector<StateId> visited_states_;
   std::vector<Arc> arcs_;                      // Arcs of state being expanded
   Weight final_;       // Final weight of state being expanded
   StateId expand_id_;  // Unique ID for each call to Expand
+  // Closure cache: the epsilon-closures, as (state, distance) pairs in visit
+  // order, of states expanded more than once. It is dropped as a whole when
+  // its size in bytes would exceed the limit.
+  size_t closure_cache_limit_;
+  size_t closure_cache_size_;
+  std::unordered_map<StateId, std::vector<std::pair<StateId, Weight>>>
+      closures_;
+  std::vector<bool> expanded_;  // '[i] = true' if state 'i' has been expanded
 
   RmEpsilonState(const RmEpsilonState &) = delete;
   RmEpsilonState &operator=(const RmEpsilonState &) = delete;
@@ -142,18 +167,26 @@ template <class Arc, class Queue>
 void RmEpsilonState<Arc, Queue>::Expand(typename Arc::StateId source) {
   final_ = Weight::Zero();
   arcs_.clear();
+  if (closure_cache_limit_ > 0) {
+    auto it = closures_.find(source);
+    if (it != closures_.end()) {
+      ExpandClosure(it->second);
+      ++expand_id_;
+      return;
+    }
+  }
   sd_state_.ShortestDistance(source);
   if (sd_state_.Error()) return;
-  eps_queue_.push(source);
+  eps_queue_.push_back(source);
 
   while (!eps_queue_.empty()) {
-    StateId state = eps_queue_.top();
-    eps_queue_.pop();
+    StateId state = eps_queue_.back();
+    eps_queue_.pop_back();
 
     while (visited_.size() <= state) visited_.push_back(false);
     if (visited_[state]) continue;
     visited_[state] = true;
-    visited_states_.push_front(state);
+    visited_states_.push_back(state);
 
     for (ArcIterator<Fst<Arc>> ait(fst_, state); !ait.Done(); ait.Next()) {
       Arc arc = ait.Value();
@@ -161,105 +194,244 @@ void RmEpsilonState<Arc, Queue>::Expand(typename Arc::StateId source) {
 
       if (eps_filter_(arc)) {
         while (visited_.size() <= arc.nextstate) visited_.push_back(false);
-        if (!visited_[arc.nextstate]) eps_queue_.push(arc.nextstate);
+        if (!visited_[arc.nextstate]) eps_queue_.push_back(arc.nextstate);
       } else {
-        Element element(arc.ilabel, arc.olabel, arc.nextstate);
-        auto insert_result = element_map_.insert(
-            std::make_pair(element, std::make_pair(expand_id_, arcs_.size())));
-        if (insert_result.second) {
-          arcs_.push_back(arc);
-        } else {
-          if (insert_result.first->second.first == expand_id_) {
-            Weight &w = arcs_[insert_result.first->second.second].weight;
-            w = Plus(w, arc.weight);
-          } else {
-            insert_result.first->second.first = expand_id_;
-            insert_result.first->second.second = arcs_.size();
-            arcs_.push_back(arc);
-          }
-        }
+        AddArc(arc);
       }
     }
     final_ = Plus(final_, Times((*distance_)[state], fst_.Final(state)));
   }
 
-  while (!visited_states_.empty()) {
-    visited_[visited_states_.front()] = false;
-    visited_states_.pop_front();
-  }
+  if (closure_cache_limit_ > 0) CacheClosure(source);
+  for (StateId state : visited_states_) visited_[state] = false;
+  visited_states_.clear();
   ++expand_id_;
 }
 
-// Removes epsilon-transitions (when both the input and output label
-// are an epsilon) from a transducer. The result will be an equivalent
-// FST that has no such epsilon transitions.  This version modifies
-// its input. It allows fine control via the options argument; see
-// below for a simpler interface.
-//
-// The vector 'distance' will be used to hold the shortest distances
-// during the epsilon-closure computation. The state queue discipline
-// and convergence delta are taken in the options argument.
 template <class Arc, class Queue>
-void RmEpsilon(MutableFst<Arc> *fst,
-               std::vector<typename Arc::Weight> *distance,
-               const RmEpsilonOptions<Arc, Queue> &opts) {
-  typedef typename Arc::StateId StateId;
-  typedef typename Arc::Weight Weight;
-  typedef typename Arc::Label Label;
+void RmEpsilonState<Arc, Queue>::ExpandClosure(
+    const std::vector<std::pair<StateId, Weight>> &closure) {
+  // Visits the same states and arcs in the same order as Expand().
+  for (const auto &element : closure) {
+    for (ArcIterator<Fst<Arc>> ait(fst_, element.first); !ait.Done();
+         ait.Next()) {
+      if (eps_filter_(ait.Value())) continue;
+      Arc arc = ait.Value();
+      arc.weight = Times(element.second, arc.weight);
+      AddArc(arc);
+    }
+    final_ = Plus(final_, Times(element.second, fst_.Final(element.first)));
+  }
+}
 
-  if (fst->Start() == kNoStateId) {
+template <class Arc, class Queue>
+void RmEpsilonState<Arc, Queue>::CacheClosure(StateId source) {
+  while (expanded_.size() <= static_cast<size_t>(source)) {
+    expanded_.push_back(false);
+  }
+  if (!expanded_[source]) {
+    expanded_[source] = true;
     return;
   }
+  typedef std::pair<StateId, Weight> Entry;
+  const size_t size = sizeof(std::vector<Entry>) +
+                      visited_states_.size() * sizeof(Entry);
+  if (size > closure_cache_limit_) return;
+  if (closure_cache_size_ + size > closure_cache_limit_) {
+    closures_.clear();
+    closure_cache_size_ = 0;
+  }
+  std::vector<Entry> &closure = closures_[source];
+  closure.reserve(visited_states_.size());
+  for (StateId state : visited_states_)
+    closure.push_back(std::make_pair(state, (*distance_)[state]));
+  closure_cache_size_ += size;
+}
 
-  // 'noneps_in[s]' will be set to true iff 's' admits a non-epsilon
-  // incoming transition or is the start state.
-  std::vector<bool> noneps_in(fst->NumStates(), false);
-  noneps_in[fst->Start()] = true;
-  for (StateId i = 0; i < fst->NumStates(); ++i) {
-    for (ArcIterator<Fst<Arc>> aiter(*fst, i); !aiter.Done(); aiter.Next()) {
+template <class Arc, class Queue>
+void RmEpsilonState<Arc, Queue>::AddArc(const Arc &arc) {
+  // Keeps the table at most half full.
+  if (2 * (arcs_.size() + 1) > element_table_.size())
+    ResizeElementTable(std::max<size_t>(16, 2 * element_table_.size()));
+  std::pair<StateId, size_t> &slot = element_table_[FindElement(arc)];
+  if (slot.first == expand_id_) {
+    Weight &w = arcs_[slot.second].weight;
+    w = Plus(w, arc.weight);
+  } else {
+    slot.first = expand_id_;
+    slot.second = arcs_.size();
+    arcs_.push_back(arc);
+  }
+}
+
+template <class Arc, class Queue>
+void RmEpsilonState<Arc, Queue>::ResizeElementTable(size_t size) {
+  element_table_.assign(size, std::make_pair(kNoStateId, 0));
+  for (size_t i = 0; i < arcs_.size(); ++i)
+    element_table_[FindElement(arcs_[i])] = std::make_pair(expand_id_, i);
+}
+
+template <class Arc, class Queue>
+size_t RmEpsilonState<Arc, Queue>::FindElement(const Arc &arc) const {
+  // Table size is a power of two, so the key is passed through a 64-bit
+  // finalizer (that of MurmurHash3) mixing all its bits into the low ones;
+  // the low bits of ElementKey alone cluster on consecutive destinations.
+  const size_t mask = element_table_.size() - 1;
+  uint64 h = ElementKey()(Element(arc.ilabel, arc.olabel, arc.nextstate));
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    const std::pair<StateId, size_t> &slot = element_table_[i];
+    if (slot.first != expand_id_) return i;
+    const Arc &element = arcs_[slot.second];
+    if (element.ilabel == arc.ilabel && element.olabel == arc.olabel &&
+        element.nextstate == arc.nextstate) {
+      return i;
+    }
+  }
+}
+
+namespace internal {
+
+// Sets 'noneps_in[s]' to true iff 's' admits a non-epsilon incoming
+// transition or is the start state.
+template <class Arc>
+void RmEpsilonNonEpsilonIn(const ExpandedFst<Arc> &fst,
+                           std::vector<bool> *noneps_in) {
+  typedef typename Arc::StateId StateId;
+
+  noneps_in->assign(fst.NumStates(), false);
+  (*noneps_in)[fst.Start()] = true;
+  for (StateId i = 0; i < fst.NumStates(); ++i) {
+    for (ArcIterator<Fst<Arc>> aiter(fst, i); !aiter.Done(); aiter.Next()) {
       if (aiter.Value().ilabel != 0 || aiter.Value().olabel != 0) {
-        noneps_in[aiter.Value().nextstate] = true;
+        (*noneps_in)[aiter.Value().nextstate] = true;
       }
     }
   }
+}
 
-  // States sorted in topological order when (acyclic) or generic
-  // topological order (cyclic).
-  std::vector<StateId> states;
-  states.reserve(fst->NumStates());
+// Sets 'states' to the states in topological order (acyclic) or generic
+// topological order (cyclic) of the epsilon subgraph. Returns false on error.
+template <class Arc>
+bool RmEpsilonStateOrder(const ExpandedFst<Arc> &fst,
+                         std::vector<typename Arc::StateId> *states) {
+  typedef typename Arc::StateId StateId;
 
-  if (fst->Properties(kTopSorted, false) & kTopSorted) {
-    for (StateId i = 0; i < fst->NumStates(); i++) states.push_back(i);
-  } else if (fst->Properties(kAcyclic, false) & kAcyclic) {
+  const StateId num_states = fst.NumStates();
+  states->clear();
+  states->reserve(num_states);
+  if (fst.Properties(kTopSorted, false) & kTopSorted) {
+    for (StateId i = 0; i < num_states; i++) states->push_back(i);
+  } else if (fst.Properties(kAcyclic, false) & kAcyclic) {
     std::vector<StateId> order;
     bool acyclic;
     TopOrderVisitor<Arc> top_order_visitor(&order, &acyclic);
-    DfsVisit(*fst, &top_order_visitor, EpsilonArcFilter<Arc>());
+    DfsVisit(fst, &top_order_visitor, EpsilonArcFilter<Arc>());
     // Sanity check: should be acyclic if property bit is set.
     if (!acyclic) {
       FSTERROR() << "RmEpsilon: Inconsistent acyclic property bit";
-      fst->SetProperties(kError, kError);
-      return;
+      return false;
     }
-    states.resize(order.size());
-    for (StateId i = 0; i < order.size(); i++) states[order[i]] = i;
+    states->resize(order.size());
+    for (size_t i = 0; i < order.size(); i++) (*states)[order[i]] = i;
   } else {
     uint64 props;
     std::vector<StateId> scc;
     SccVisitor<Arc> scc_visitor(&scc, nullptr, nullptr, &props);
-    DfsVisit(*fst, &scc_visitor, EpsilonArcFilter<Arc>());
+    DfsVisit(fst, &scc_visitor, EpsilonArcFilter<Arc>());
     std::vector<StateId> first(scc.size(), kNoStateId);
     std::vector<StateId> next(scc.size(), kNoStateId);
-    for (StateId i = 0; i < scc.size(); i++) {
+    for (size_t i = 0; i < scc.size(); i++) {
       if (first[scc[i]] != kNoStateId) next[i] = first[scc[i]];
       first[scc[i]] = i;
     }
-    for (StateId i = 0; i < first.size(); i++) {
+    for (size_t i = 0; i < first.size(); i++) {
       for (StateId j = first[i]; j != kNoStateId; j = next[j]) {
-        states.push_back(j);
+        states->push_back(j);
       }
     }
   }
+  return true;
+}
+
+// Replaces the arcs and final weight of 'state' by those of its expansion.
+template <class Arc>
+void RmEpsilonSetState(MutableFst<Arc> *fst, typename Arc::StateId state,
+                       const typename Arc::Weight &final,
+                       std::vector<Arc> *arcs) {
+  fst->SetFinal(state, final);
+  fst->DeleteArcs(state);
+  fst->ReserveArcs(state, arcs->size());
+  while (!arcs->empty()) {
+    fst->AddArc(state, arcs->back());
+    arcs->pop_back();
+  }
+}
+
+// Completes RmEpsilon() once the states have been expanded: removes the arcs
+// of the states that are no longer accessible, then prunes or trims.
+template <class Arc>
+void RmEpsilonFinish(MutableFst<Arc> *fst, const std::vector<bool> &noneps_in,
+                     bool error, bool connect,
+                     const typename Arc::Weight &weight_threshold,
+                     typename Arc::StateId state_threshold) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+
+  if (connect || weight_threshold != Weight::Zero() ||
+      state_threshold != kNoStateId) {
+    for (StateId s = 0; s < fst->NumStates(); ++s) {
+      if (!noneps_in[s]) fst->DeleteArcs(s);
+    }
+  }
+
+  if (error) fst->SetProperties(kError, kError);
+  fst->SetProperties(
+      RmEpsilonProperties(fst->Properties(kFstProperties, false)),
+      kFstProperties);
+
+  if (weight_threshold != Weight::Zero() || state_threshold != kNoStateId) {
+    Prune(fst, weight_threshold, state_threshold);
+  }
+  if (connect && weight_threshold == Weight::Zero() &&
+      state_threshold == kNoStateId) {
+    Connect(fst);
+  }
+}
+
+}  // namespace internal
+
+// Removes epsilon-transitions (when both the input and output label
+// are an epsilon) from a transducer. The result will be an equivalent
+// FST that has no such epsilon transitions.  This version modifies
+// its input. It allows fine control via the options argument; see
+// below for a simpler interface.
+//
+// The vector 'distance' will be used to hold the shortest distances
+// during the epsilon-closure computation. The state queue discipline
+// and convergence delta are taken in the options argument.
+template <class Arc, class Queue>
+void RmEpsilon(MutableFst<Arc> *fst,
+               std::vector<typename Arc::Weight> *distance,
+               const RmEpsilonOptions<Arc, Queue> &opts) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+
+  if (fst->Start() == kNoStateId) {
+    return;
+  }
+
+  std::vector<StateId> states;
+  if (!internal::RmEpsilonStateOrder(*fst, &states)) {
+    fst->SetProperties(kError, kError);
+    return;
+  }
+  std::vector<bool> noneps_in;
+  internal::RmEpsilonNonEpsilonIn(*fst, &noneps_in);
 
   RmEpsilonState<Arc, Queue> rmeps_state(*fst, distance, opts);
 
@@ -272,36 +444,122 @@ void RmEpsilon(MutableFst<Arc> *fst,
       continue;
     }
     rmeps_state.Expand(state);
-    fst->SetFinal(state, rmeps_state.Final());
-    fst->DeleteArcs(state);
-    std::vector<Arc> &arcs = rmeps_state.Arcs();
-    fst->ReserveArcs(state, arcs.size());
-    while (!arcs.empty()) {
-      fst->AddArc(state, arcs.back());
-      arcs.pop_back();
-    }
+    internal::RmEpsilonSetState(fst, state, rmeps_state.Final(),
+                                &rmeps_state.Arcs());
   }
 
-  if (opts.connect || opts.weight_threshold != Weight::Zero() ||
-      opts.state_threshold != kNoStateId) {
-    for (StateId s = 0; s < fst->NumStates(); ++s) {
-      if (!noneps_in[s]) fst->DeleteArcs(s);
-    }
-  }
+  internal::RmEpsilonFinish(fst, noneps_in, rmeps_state.Error(), opts.connect,
+                            opts.weight_threshold, opts.state_threshold);
+}
 
-  if (rmeps_state.Error()) fst->SetProperties(kError, kError);
-  fst->SetProperties(
-      RmEpsilonProperties(fst->Properties(kFstProperties, false)),
-      kFstProperties);
+// Removes epsilon-transitions as above, computing the epsilon-closures on
+// 'num_threads' threads (all hardware threads if num_threads <= 0), each
+// with its own state queue and distance vector. The states are grouped into
+// levels of the condensation of the epsilon subgraph, a strongly connected
+// component being one level above the highest component it has an epsilon
+// transition to, and the levels are expanded in increasing order. No
+// epsilon path joins two components of the same level, so their closures
+// are computed concurrently while the FST is only read, after which the
+// states are replaced on the calling thread. As in the serial version, a
+// closure thus stops at the states of lower levels, already replaced by
+// their own closures; the results are equivalent up to arc order and
+// convergence delta.
+template <class Arc>
+void ParallelRmEpsilon(MutableFst<Arc> *fst, bool connect,
+                       typename Arc::Weight weight_threshold,
+                       typename Arc::StateId state_threshold, float delta,
+                       int num_threads) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  typedef AutoQueue<StateId> Queue;
+
+  // Maximum number of states a thread expands before the results are
+  // written to the FST, bounding the memory used for them.
+  static const size_t kBlockSize = 1024;
+
+  if (fst->Start() == kNoStateId) {
+    return;
+  }
 
-  if (opts.weight_threshold != Weight::Zero() ||
-      opts.state_threshold != kNoStateId) {
-    Prune(fst, opts.weight_threshold, opts.state_threshold);
+  std::vector<bool> noneps_in;
+  internal::RmEpsilonNonEpsilonIn(*fst, &noneps_in);
+  // Component IDs are numbered in topological order, so each component only
+  // has epsilon transitions to itself and to components with higher IDs.
+  std::vector<StateId> scc;
+  ParallelScc(*fst, &scc, EpsilonArcFilter<Arc>(), num_threads);
+  std::vector<StateId> first(scc.size(), kNoStateId);
+  std::vector<StateId> next(scc.size(), kNoStateId);
+  for (size_t s = 0; s < scc.size(); ++s) {
+    if (first[scc[s]] != kNoStateId) next[s] = first[scc[s]];
+    first[scc[s]] = s;
   }
-  if (opts.connect && opts.weight_threshold == Weight::Zero() &&
-      opts.state_threshold == kNoStateId) {
-    Connect(fst);
+  std::vector<StateId> level(scc.size(), 0);
+  StateId num_levels = 0;
+  for (StateId c = scc.size() - 1; c >= 0; --c) {
+    for (StateId s = first[c]; s != kNoStateId; s = next[s]) {
+      for (ArcIterator<Fst<Arc>> aiter(*fst, s); !aiter.Done();
+           aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        if (arc.ilabel == 0 && arc.olabel == 0 && scc[arc.nextstate] != c) {
+          level[c] = std::max(level[c], level[scc[arc.nextstate]] + 1);
+        }
+      }
+    }
+    num_levels = std::max(num_levels, level[c] + 1);
   }
+  // Lists the states to expand level by level; 'begin[l]' is the position
+  // of the first state of level 'l' in 'order'.
+  const bool skip = connect || weight_threshold != Weight::Zero() ||
+                    state_threshold != kNoStateId;
+  std::vector<size_t> begin(num_levels + 1, 0);
+  for (size_t s = 0; s < scc.size(); ++s) {
+    if (noneps_in[s] || !skip) ++begin[level[scc[s]] + 1];
+  }
+  for (StateId l = 0; l < num_levels; ++l) begin[l + 1] += begin[l];
+  std::vector<StateId> order(begin[num_levels]);
+  {
+    std::vector<size_t> end(begin.begin(), begin.end() - 1);
+    for (size_t s = 0; s < scc.size(); ++s) {
+      if (noneps_in[s] || !skip) order[end[level[scc[s]]]++] = s;
+    }
+  }
+
+  ThreadPool pool(num_threads);
+  const size_t num_workers = pool.NumThreads();
+  std::vector<std::vector<Weight>> distance(num_workers);
+  std::vector<std::unique_ptr<Queue>> queue(num_workers);
+  std::vector<std::unique_ptr<RmEpsilonState<Arc, Queue>>> rmeps_state(
+      num_workers);
+  pool.ParallelFor(num_workers, [&](size_t i, int) {
+    queue[i].reset(new Queue(*fst, &distance[i], EpsilonArcFilter<Arc>()));
+    RmEpsilonOptions<Arc, Queue> opts(queue[i].get(), delta, connect,
+                                      weight_threshold, state_threshold);
+    rmeps_state[i].reset(
+        new RmEpsilonState<Arc, Queue>(*fst, &distance[i], opts));
+  });
+
+  const size_t block_size = kBlockSize * num_workers;
+  std::vector<Weight> finals(std::min(block_size, order.size()));
+  std::vector<std::vector<Arc>> arcs(finals.size());
+  for (StateId l = 0; l < num_levels; ++l) {
+    for (size_t b = begin[l]; b < begin[l + 1]; b += block_size) {
+      const size_t size = std::min(block_size, begin[l + 1] - b);
+      pool.ParallelFor(size, [&](size_t i, int thread) {
+        RmEpsilonState<Arc, Queue> &state = *rmeps_state[thread];
+        state.Expand(order[b + i]);
+        finals[i] = state.Final();
+        arcs[i].swap(state.Arcs());
+      }, 16);
+      for (size_t i = 0; i < size; ++i) {
+        internal::RmEpsilonSetState(fst, order[b + i], finals[i], &arcs[i]);
+      }
+    }
+  }
+
+  bool error = false;
+  for (const auto &state : rmeps_state) error = error || state->Error();
+  internal::RmEpsilonFinish(fst, noneps_in, error, connect, weight_threshold,
+                            state_threshold);
 }
 
 // Removes epsilon-transitions (when both the input and output label
@@ -342,11 +600,24 @@ void RmEpsilon(MutableFst<Arc> *fst, bool connect = true,
 
 struct RmEpsilonFstOptions : CacheOptions {
   float delta;
-
-  explicit RmEpsilonFstOptions(const CacheOptions &opts, float delta = kDelta)
-      : CacheOptions(opts), delta(delta) {}
-
-  explicit RmEpsilonFstOptions(float delta = kDelta) : delta(delta) {}
+  // # of bytes allowed for memoizing the epsilon-closures of states expanded
+  // again after being garbage-collected from the cache; 0 disables it. A
+  // closure is memoized only for the state it was computed from, so this
+  // helps only when a small 'gc_limit' makes states be expanded repeatedly;
+  // with the default caching each state is expanded once and it has no
+  // effect. When the memoized closures exceed the limit they are all
+  // dropped.
+  size_t closure_cache_limit;
+
+  explicit RmEpsilonFstOptions(const CacheOptions &opts, float delta = kDelta,
+                               size_t closure_cache_limit = 0)
+      : CacheOptions(opts),
+        delta(delta),
+        closure_cache_limit(closure_cache_limit) {}
+
+  explicit RmEpsilonFstOptions(float delta = kDelta,
+                               size_t closure_cache_limit = 0)
+      : delta(delta), closure_cache_limit(closure_cache_limit) {}
 };
 
 // Implementation of delayed RmEpsilonFst.
@@ -376,9 +647,11 @@ class RmEpsilonFstImpl : public CacheImpl<A> {
       : CacheImpl<A>(opts),
         fst_(fst.Copy()),
         delta_(opts.delta),
+        closure_cache_limit_(opts.closure_cache_limit),
         rmeps_state_(
             *fst_, &distance_,
-            RmEpsilonOptions<A, FifoQueue<StateId>>(&queue_, delta_, false)) {
+            RmEpsilonOptions<A, FifoQueue<StateId>>(&queue_, delta_, false),
+            closure_cache_limit_) {
     SetType("rmepsilon");
     uint64 props = fst.Properties(kFstProperties, false);
     SetProperties(RmEpsilonProperties(props, true), kCopyProperties);
@@ -390,9 +663,11 @@ class RmEpsilonFstImpl : public CacheImpl<A> {
       : CacheImpl<A>(impl),
         fst_(impl.fst_->Copy(true)),
         delta_(impl.delta_),
+        closure_cache_limit_(impl.closure_cache_limit_),
         rmeps_state_(
             *fst_, &distance_,
-            RmEpsilonOptions<A, FifoQueue<StateId>>(&queue_, delta_, false)) {
+            RmEpsilonOptions<A, FifoQueue<StateId>>(&queue_, delta_, false),
+            closure_cache_limit_) {
     SetType("rmepsilon");
     SetProperties(impl.Properties(), kCopyProperties);
     SetInputSymbols(impl.InputSymbols());
@@ -458,6 +733,7 @@ class RmEpsilonFstImpl : public CacheImpl<A> {
  private:
   std::unique_ptr<const Fst<A>> fst_;
   float delta_;
+  size_t closure_cache_limit_;
   std::vector<Weight> distance_;
   FifoQueue<StateId> queue_;
   RmEpsilonState<A, FifoQueue<StateId>> rmeps_state_;
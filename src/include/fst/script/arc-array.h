@@ -0,0 +1,127 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Describes the arc storage of FSTs whose arcs are held in a single array in
+// state order (e.g., ConstFst), so that scripting clients can view the labels,
+// weights and destination states in place without copying the arcs.
+
+#ifndef FST_SCRIPT_ARC_ARRAY_H_
+#define FST_SCRIPT_ARC_ARRAY_H_
+
+#include <type_traits>
+#include <vector>
+
+#include <fst/expanded-fst.h>
+#include <fst/float-weight.h>
+#include <fst/script/arg-packs.h>
+#include <fst/script/fst-class.h>
+
+namespace fst {
+namespace script {
+
+// Layout of a contiguous arc array. The arc fields are found at the given
+// byte offsets from the start of each arc, with consecutive arcs arc_size
+// bytes apart. The array is owned by the FST and remains valid as long as
+// it does.
+struct ArcArray {
+  const char *data;             // Address of the first arc.
+  size_t num_arcs;              // Total number of arcs.
+  size_t arc_size;              // Stride between consecutive arcs in bytes.
+  size_t ilabel_offset;         // Byte offsets of the arc fields.
+  size_t olabel_offset;
+  size_t weight_offset;
+  size_t nextstate_offset;
+  size_t label_size;            // Byte sizes of the arc fields.
+  size_t weight_size;
+  size_t stateid_size;
+  // Whether the weight is a single floating-point value of weight_size bytes
+  // (e.g., TropicalWeight or LogWeight), and so can be viewed as such.
+  bool float_weight;
+  // Index of the first arc of each state, followed by num_arcs.
+  std::vector<size_t> state_offsets;
+
+  ArcArray()
+      : data(nullptr),
+        num_arcs(0),
+        arc_size(0),
+        ilabel_offset(0),
+        olabel_offset(0),
+        weight_offset(0),
+        nextstate_offset(0),
+        label_size(0),
+        weight_size(0),
+        stateid_size(0),
+        float_weight(false) {}
+};
+
+// Whether W is a FloatWeightTpl<T>, stored as a single float or double.
+template <class W>
+struct IsFloatWeight {
+  static const bool value =
+      (std::is_base_of<FloatWeightTpl<float>, W>::value ||
+       std::is_base_of<FloatWeightTpl<double>, W>::value) &&
+      (sizeof(W) == sizeof(float) || sizeof(W) == sizeof(double));
+};
+
+// Fills in the arc array layout of an expanded FST. Returns false if the arcs
+// are not stored in a single array in state order.
+template <class Arc>
+bool GetArcArray(const Fst<Arc> &fst, ArcArray *array) {
+  typedef typename Arc::StateId StateId;
+  if (!fst.Properties(kExpanded, false)) return false;
+  const StateId num_states = CountStates(fst);
+  array->state_offsets.clear();
+  array->state_offsets.reserve(num_states + 1);
+  const Arc *begin = nullptr;
+  const Arc *end = nullptr;
+  for (StateId s = 0; s < num_states; ++s) {
+    ArcIteratorData<Arc> data;
+    fst.InitArcIterator(s, &data);
+    if (data.base) {
+      // Arcs are only reachable through an iterator object.
+      delete data.base;
+      return false;
+    }
+    if (data.ref_count) {
+      // Arcs are cached, so need not outlive the iterator.
+      --(*data.ref_count);
+      return false;
+    }
+    if (s == 0) begin = end = data.arcs;
+    if (data.narcs > 0 && data.arcs != end) return false;
+    array->state_offsets.push_back(end - begin);
+    end += data.narcs;
+  }
+  array->state_offsets.push_back(end - begin);
+  const Arc arc;
+  const char *base = reinterpret_cast<const char *>(&arc);
+  array->data = reinterpret_cast<const char *>(begin);
+  array->num_arcs = end - begin;
+  array->arc_size = sizeof(Arc);
+  array->ilabel_offset = reinterpret_cast<const char *>(&arc.ilabel) - base;
+  array->olabel_offset = reinterpret_cast<const char *>(&arc.olabel) - base;
+  array->weight_offset = reinterpret_cast<const char *>(&arc.weight) - base;
+  array->nextstate_offset =
+      reinterpret_cast<const char *>(&arc.nextstate) - base;
+  array->label_size = sizeof(arc.ilabel);
+  array->weight_size = sizeof(arc.weight);
+  array->stateid_size = sizeof(arc.nextstate);
+  array->float_weight = IsFloatWeight<typename Arc::Weight>::value;
+  return true;
+}
+
+typedef args::Package<const FstClass &, ArcArray *> GetArcArrayInnerArgs;
+typedef args::WithReturnValue<bool, GetArcArrayInnerArgs> GetArcArrayArgs;
+
+template <class Arc>
+void GetArcArray(GetArcArrayArgs *args) {
+  const Fst<Arc> &fst = *(args->args.arg1.GetFst<Arc>());
+  args->retval = GetArcArray(fst, args->args.arg2);
+}
+
+bool GetArcArray(const FstClass &fst, ArcArray *array);
+
+}  // namespace script
+}  // namespace fst
+
+#endif  // FST_SCRIPT_ARC_ARRAY_H_
@@ -4,7 +4,13 @@
 #ifndef FST_SCRIPT_COMPOSE_H_
 #define FST_SCRIPT_COMPOSE_H_
 
+#include <memory>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
 #include <fst/compose.h>
+#include <fst/thread-pool.h>
 #include <fst/script/arg-packs.h>
 #include <fst/script/fst-class.h>
 
@@ -42,6 +48,48 @@ void Compose(const FstClass &ifst1, const FstClass &ifst2,
 void Compose(const FstClass &ifst1, const FstClass &ifst2,
              MutableFstClass *ofst, ComposeFilter compose_filter);
 
+typedef std::pair<const FstClass *, const FstClass *> FstClassPair;
+
+typedef args::Package<const std::vector<FstClassPair> &,
+                      const std::vector<MutableFstClass *> &,
+                      const ComposeOptions &, ThreadPool *> ComposeArgs3;
+
+template <class Arc>
+void Compose(ComposeArgs3 *args) {
+  const std::vector<FstClassPair> &ifsts = args->arg1;
+  const std::vector<MutableFstClass *> &ofsts = args->arg2;
+  // Tests all properties of each input FST once, before any thread reads it,
+  // so that the compositions below find those they need already known and do
+  // not store them into an FST shared with other threads.
+  std::unordered_set<const FstClass *> tested;
+  for (const auto &pair : ifsts) {
+    if (tested.insert(pair.first).second)
+      pair.first->GetFst<Arc>()->Properties(kFstProperties, true);
+    if (tested.insert(pair.second).second)
+      pair.second->GetFst<Arc>()->Properties(kFstProperties, true);
+  }
+  args->arg4->ParallelFor(ifsts.size(), [&](size_t i, int) {
+    // Thread-safe copies, so that FSTs with caches are not shared.
+    std::unique_ptr<const Fst<Arc>> ifst1(
+        ifsts[i].first->GetFst<Arc>()->Copy(true));
+    std::unique_ptr<const Fst<Arc>> ifst2(
+        ifsts[i].second->GetFst<Arc>()->Copy(true));
+    Compose(*ifst1, *ifst2, ofsts[i]->GetMutableFst<Arc>(), args->arg3);
+  });
+}
+
+// Composes each pair of input FSTs into the corresponding output FST, using
+// up to num_threads threads (all hardware threads if num_threads <= 0); ifsts
+// and ofsts must have the same size and the output FSTs must be distinct. An
+// input FST may appear in any number of pairs, e.g., a grammar composed with
+// each of a batch of inputs: the compositions only read the input FSTs, which
+// must not be used by other threads until this returns. The operation is
+// looked up once per arc type rather than once per composition.
+void Compose(const std::vector<FstClassPair> &ifsts,
+             const std::vector<MutableFstClass *> &ofsts,
+             const ComposeOptions &opts = fst::script::ComposeOptions(),
+             int num_threads = 1);
+
 }  // namespace script
 }  // namespace fst
 
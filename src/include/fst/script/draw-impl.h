@@ -49,10 +49,13 @@ class FstDrawer {
         precision_(precision),
         show_weight_one_(show_weight_one) {}
 
-  // Draw Fst to an output buffer (or stdout if buf = 0)
+  // Draw Fst to an output buffer (or stdout if buf = 0). Output is formatted
+  // into an internal buffer which is written to the stream in large blocks.
   void Draw(std::ostream *strm, const string &dest) {
     ostrm_ = strm;
     ostrm_->precision(precision_);
+    vstrm_.copyfmt(*ostrm_);
+    buf_.clear();
     dest_ = dest;
     StateId start = fst_.Start();
     if (start == kNoStateId) return;
@@ -84,15 +87,27 @@ class FstDrawer {
     for (StateIterator<Fst<A>> siter(fst_); !siter.Done(); siter.Next()) {
       StateId s = siter.Value();
       if (s != start) DrawState(s);
+      if (buf_.size() >= kBufferSize) Flush();
     }
     PrintString("}\n");
+    Flush();
   }
 
  private:
   // Maximum line length in text file.
   static const int kLineLen = 8096;
 
-  void PrintString(const string &s) const { *ostrm_ << s; }
+  // Buffered output size at which formatted text is written to the stream.
+  static const size_t kBufferSize = 1 << 16;
+
+  void Flush() {
+    ostrm_->write(buf_.data(), buf_.size());
+    buf_.clear();
+  }
+
+  void PrintString(const string &s) { buf_.append(s); }
+
+  void PrintString(const char *s) { buf_.append(s); }
 
   // Escapes backslash and double quote if these occur in the string. Dot will
   // not deal gracefully with these if they are not escaped.
@@ -105,7 +120,7 @@ class FstDrawer {
     }
   }
 
-  void PrintId(StateId id, const SymbolTable *syms, const char *name) const {
+  void PrintId(StateId id, const SymbolTable *syms, const char *name) {
     if (syms) {
       string symbol = syms->Find(id);
       if (symbol == "") {
@@ -115,26 +130,30 @@ class FstDrawer {
                    << ", destination = " << dest_;
         symbol = "?";
       }
-      string nsymbol;
-      EscapeChars(symbol, &nsymbol);
-      PrintString(nsymbol);
+      EscapeChars(symbol, &buf_);
     } else {
-      string idstr;
-      Int64ToStr(id, &idstr);
-      PrintString(idstr);
+      Int64ToStr(id, &buf_);
     }
   }
 
-  void PrintStateId(StateId s) const { PrintId(s, ssyms_, "state ID"); }
+  void PrintStateId(StateId s) { PrintId(s, ssyms_, "state ID"); }
 
-  void PrintILabel(Label l) const { PrintId(l, isyms_, "arc input label"); }
+  void PrintILabel(Label l) { PrintId(l, isyms_, "arc input label"); }
 
-  void PrintOLabel(Label l) const { PrintId(l, osyms_, "arc output label"); }
+  void PrintOLabel(Label l) { PrintId(l, osyms_, "arc output label"); }
 
+  // Values are formatted with a reused string stream which has the same
+  // format state (e.g., precision) as the destination stream.
   template <class T>
-  void Print(T t) const { *ostrm_ << t; }
+  void Print(const T &t) {
+    vstrm_.str(string());
+    vstrm_ << t;
+    buf_.append(vstrm_.str());
+  }
+
+  void Print(StateId s) { Int64ToStr(s, &buf_); }
 
-  void DrawState(StateId s) const {
+  void DrawState(StateId s) {
     Print(s);
     PrintString(" [label = \"");
     PrintStateId(s);
@@ -156,7 +175,7 @@ class FstDrawer {
     Print(fontsize_);
     PrintString("]\n");
     for (ArcIterator<Fst<A>> aiter(fst_, s); !aiter.Done(); aiter.Next()) {
-      Arc arc = aiter.Value();
+      const Arc &arc = aiter.Value();
       PrintString("\t");
       Print(s);
       PrintString(" -> ");
@@ -184,6 +203,8 @@ class FstDrawer {
   bool accep_;                // print as acceptor when possible
   std::ostream *ostrm_;       // drawn FST destination
   string dest_;               // drawn FST destination name
+  string buf_;                // formatted text not yet written to ostrm_
+  std::ostringstream vstrm_;  // value formatting stream
 
   string title_;
   float width_;
@@ -29,6 +29,7 @@
 #include <fst/script/script-impl.h>
 
 // Operations
+#include <fst/script/arc-array.h>
 #include <fst/script/arcsort.h>
 #include <fst/script/closure.h>
 #include <fst/script/compile.h>
@@ -64,6 +65,7 @@
 #include <fst/script/rmepsilon.h>
 #include <fst/script/shortest-distance.h>
 #include <fst/script/shortest-path.h>
+#include <fst/script/statesort.h>
 #include <fst/script/synchronize.h>
 #include <fst/script/topsort.h>
 #include <fst/script/union.h>
@@ -87,6 +89,7 @@ class AllFstOperationsRegisterer {
  private:
   void RegisterBatch1() {
     REGISTER_FST_OPERATION(ArcSort, Arc, ArcSortArgs);
+    REGISTER_FST_OPERATION(GetArcArray, Arc, GetArcArrayArgs);
     REGISTER_FST_OPERATION(Closure, Arc, ClosureArgs);
     REGISTER_FST_OPERATION(CompileFstInternal, Arc, CompileFstArgs);
     REGISTER_FST_OPERATION(Compose, Arc, ComposeArgs1);
@@ -20,6 +20,7 @@
 #include <fst/script/arcsort.h>       // For ArcSortType.
 #include <fst/script/map.h>           // For MapType.
 #include <fst/script/script-impl.h>   // For RandArcSelection.
+#include <fst/script/statesort.h>     // For StateOrderType.
 
 #include <fst/types.h>
 
@@ -66,6 +67,8 @@ bool GetRandArcSelection(const string &str, RandArcSelection *ras);
 bool GetReplaceLabelType(const string &str, bool epsilon_on_replace,
                          ReplaceLabelType *rlt);
 
+bool GetStateOrderType(const string &str, StateOrderType *order_type);
+
 inline ReweightType GetReweightType(bool to_final) {
   return to_final ? REWEIGHT_TO_FINAL : REWEIGHT_TO_INITIAL;
 }
@@ -43,10 +43,13 @@ class FstPrinter {
         sep_(field_separator),
         missing_symbol_(missing_symbol) {}
 
-  // Print Fst to an output stream
+  // Print Fst to an output stream. Output is formatted into an internal
+  // buffer which is written to the stream in large blocks.
   void Print(std::ostream *ostrm, const string &dest) {
     ostrm_ = ostrm;
     dest_ = dest;
+    wstrm_.copyfmt(*ostrm_);
+    buf_.clear();
     StateId start = fst_.Start();
     if (start == kNoStateId) return;
     // initial state first
@@ -54,14 +57,24 @@ class FstPrinter {
     for (StateIterator<Fst<A>> siter(fst_); !siter.Done(); siter.Next()) {
       StateId s = siter.Value();
       if (s != start) PrintState(s);
+      if (buf_.size() >= kBufferSize) Flush();
     }
+    Flush();
   }
 
  private:
   // Maximum line length in text file.
   static const int kLineLen = 8096;
 
-  void PrintId(StateId id, const SymbolTable *syms, const char *name) const {
+  // Buffered output size at which formatted text is written to the stream.
+  static const size_t kBufferSize = 1 << 16;
+
+  void Flush() {
+    ostrm_->write(buf_.data(), buf_.size());
+    buf_.clear();
+  }
+
+  void PrintId(StateId id, const SymbolTable *syms, const char *name) {
     if (syms) {
       string symbol = syms->Find(id);
       if (symbol == "") {
@@ -75,43 +88,54 @@ class FstPrinter {
           symbol = missing_symbol_;
         }
       }
-      *ostrm_ << symbol;
+      buf_.append(symbol);
     } else {
-      *ostrm_ << id;
+      Int64ToStr(id, &buf_);
     }
   }
 
-  void PrintStateId(StateId s) const { PrintId(s, ssyms_, "state ID"); }
+  void PrintStateId(StateId s) { PrintId(s, ssyms_, "state ID"); }
 
-  void PrintILabel(Label l) const { PrintId(l, isyms_, "arc input label"); }
+  void PrintILabel(Label l) { PrintId(l, isyms_, "arc input label"); }
 
-  void PrintOLabel(Label l) const { PrintId(l, osyms_, "arc output label"); }
+  void PrintOLabel(Label l) { PrintId(l, osyms_, "arc output label"); }
 
-  void PrintState(StateId s) const {
+  // Weights are formatted with a reused string stream which has the same
+  // format state (e.g., precision) as the destination stream.
+  void PrintWeight(const Weight &w) {
+    wstrm_.str(string());
+    wstrm_ << w;
+    buf_.append(wstrm_.str());
+  }
+
+  void PrintState(StateId s) {
     bool output = false;
     for (ArcIterator<Fst<A>> aiter(fst_, s); !aiter.Done(); aiter.Next()) {
-      Arc arc = aiter.Value();
+      const Arc &arc = aiter.Value();
       PrintStateId(s);
-      *ostrm_ << sep_;
+      buf_.append(sep_);
       PrintStateId(arc.nextstate);
-      *ostrm_ << sep_;
+      buf_.append(sep_);
       PrintILabel(arc.ilabel);
       if (!accep_) {
-        *ostrm_ << sep_;
+        buf_.append(sep_);
         PrintOLabel(arc.olabel);
       }
-      if (show_weight_one_ || arc.weight != Weight::One())
-        *ostrm_ << sep_ << arc.weight;
-      *ostrm_ << "\n";
+      if (show_weight_one_ || arc.weight != Weight::One()) {
+        buf_.append(sep_);
+        PrintWeight(arc.weight);
+      }
+      buf_.push_back('\n');
       output = true;
     }
     Weight final = fst_.Final(s);
     if (final != Weight::Zero() || !output) {
       PrintStateId(s);
       if (show_weight_one_ || final != Weight::One()) {
-        *ostrm_ << sep_ << final;
+        buf_.append(sep_);
+        PrintWeight(final);
       }
-      *ostrm_ << "\n";
+      buf_.push_back('\n');
     }
   }
 
@@ -122,6 +146,8 @@ class FstPrinter {
   bool accep_;                // print as acceptor when possible
   std::ostream *ostrm_;       // text FST destination
   string dest_;               // text FST destination name
+  string buf_;                // formatted text not yet written to ostrm_
+  std::ostringstream wstrm_;  // weight formatting stream
   bool show_weight_one_;      // print weights equal to Weight::One()
   string sep_;                // separator character between fields.
   string missing_symbol_;     // symbol to print when lookup fails (default
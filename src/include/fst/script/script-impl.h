@@ -172,6 +172,50 @@ void Apply(const string &op_name, const string &arc_type,
   op(args);
 }
 
+// Handle to an operation resolved once by name and arc type. Applying the
+// handle avoids repeating the register lookup done by Apply<>, which is
+// useful when the same operation is applied to many FSTs of one arc type.
+//
+//   OperationHandle<Operation<FooArgs>> foo("Foo", ifst.ArcType());
+//   for (...) {
+//     FooArgs args(...);
+//     foo(&args);
+//   }
+
+template <class OpReg>
+class OperationHandle {
+ public:
+  typedef typename OpReg::Args Args;
+  typedef typename OpReg::OpType OpType;
+
+  OperationHandle(const string &op_name, const string &arc_type)
+      : op_name_(op_name),
+        arc_type_(arc_type),
+        op_(OpReg::Register::GetRegister()->GetOperation(op_name, arc_type)) {
+  }
+
+  const string &OpName() const { return op_name_; }
+
+  const string &ArcType() const { return arc_type_; }
+
+  // Returns true if an operation was registered for the name and arc type.
+  bool Found() const { return op_ != nullptr; }
+
+  void operator()(Args *args) const {
+    if (!op_) {
+      FSTERROR() << "No operation found for " << op_name_ << " on "
+                 << "arc type " << arc_type_;
+      return;
+    }
+    op_(args);
+  }
+
+ private:
+  const string op_name_;
+  const string arc_type_;
+  const OpType op_;
+};
+
 // Helper that logs to ERROR if the arc types of m and n don't match. The
 // op_name is used to construct the error message.
 template <class M, class N>
@@ -188,6 +188,29 @@ void ShortestDistance(ShortestDistanceArgs3 *args) {
   args->retval = WeightClass(ShortestDistance(fst));
 }
 
+// 4
+typedef args::Package<const FstClass &, std::vector<double> *, bool, double>
+    ShortestDistanceInnerArgs4;
+
+typedef args::WithReturnValue<bool, ShortestDistanceInnerArgs4>
+    ShortestDistanceArgs4;
+
+// Stores the distances as plain values rather than WeightClass instances; this
+// requires a weight type with a numeric Value(), e.g., TropicalWeight, and so
+// is only registered for such arc types.
+template <class Arc>
+void ShortestDistance(ShortestDistanceArgs4 *args) {
+  const Fst<Arc> &fst = *(args->args.arg1.GetFst<Arc>());
+  std::vector<typename Arc::Weight> distance;
+  ShortestDistance(fst, &distance, args->args.arg3, args->args.arg4);
+  std::vector<double> *retval = args->args.arg2;
+  retval->resize(distance.size());
+  for (size_t i = 0; i < distance.size(); ++i)
+    (*retval)[i] = distance[i].Value();
+  // An error is signaled by a single non-member distance.
+  args->retval = distance.size() != 1 || distance[0].Member();
+}
+
 // 1
 void ShortestDistance(const FstClass &fst, std::vector<WeightClass> *distance,
                       const ShortestDistanceOptions &opts);
@@ -196,6 +219,11 @@ void ShortestDistance(const FstClass &fst, std::vector<WeightClass> *distance,
 void ShortestDistance(const FstClass &ifst, std::vector<WeightClass> *distance,
                       bool reverse = false, double delta = fst::kDelta);
 
+// 4
+// Returns false if the arc type has no numeric weight values or on error.
+bool ShortestDistance(const FstClass &ifst, std::vector<double> *distance,
+                      bool reverse = false, double delta = fst::kDelta);
+
 }  // namespace script
 }  // namespace fst
 
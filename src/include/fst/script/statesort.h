@@ -0,0 +1,46 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#ifndef FST_SCRIPT_STATESORT_H_
+#define FST_SCRIPT_STATESORT_H_
+
+#include <ctime>
+
+#include <fst/randgen.h>
+#include <fst/statesort.h>
+#include <fst/script/arg-packs.h>
+#include <fst/script/fst-class.h>
+#include <fst/script/script-impl.h>
+
+namespace fst {
+namespace script {
+
+// 1: FST to sort; 2: state order; 3: arc selector, 4: number of paths,
+// 5: maximum path length and 6: random seed for STATE_ORDER_HOT_PATH.
+typedef args::Package<MutableFstClass *, StateOrderType, RandArcSelection,
+                      int32, int32, time_t> StateSortArgs;
+
+template <class Arc>
+void StateSort(StateSortArgs *args) {
+  MutableFst<Arc> *fst = args->arg1->GetMutableFst<Arc>();
+  if (args->arg3 == UNIFORM_ARC_SELECTOR) {
+    UniformArcSelector<Arc> selector(args->arg6);
+    StateSort(fst, args->arg2, selector, args->arg4, args->arg5);
+  } else if (args->arg3 == FAST_LOG_PROB_ARC_SELECTOR) {
+    FastLogProbArcSelector<Arc> selector(args->arg6);
+    StateSort(fst, args->arg2, selector, args->arg4, args->arg5);
+  } else {
+    LogProbArcSelector<Arc> selector(args->arg6);
+    StateSort(fst, args->arg2, selector, args->arg4, args->arg5);
+  }
+}
+
+void StateSort(MutableFstClass *fst, StateOrderType order_type,
+               RandArcSelection selection = UNIFORM_ARC_SELECTOR,
+               int32 npath = 1000, int32 max_length = 1000,
+               time_t seed = time(nullptr));
+
+}  // namespace script
+}  // namespace fst
+
+#endif  // FST_SCRIPT_STATESORT_H_
@@ -14,6 +14,7 @@
 #include <fst/queue.h>
 #include <fst/reverse.h>
 #include <fst/test-properties.h>
+#include <fst/topsort.h>
 
 
 namespace fst {
@@ -232,6 +233,51 @@ void ShortestDistance(
   }
 }
 
+namespace internal {
+
+// Computes the shortest distance from each state of an acyclic FST to the
+// final states, summing over the arcs of each state in reverse topological
+// order; this avoids building the reversed FST. Returns false, leaving
+// 'distance' unchanged, if the FST is cyclic. The weights must be left
+// distributive.
+template <class Arc>
+bool AcyclicReverseShortestDistance(
+    const Fst<Arc> &fst, std::vector<typename Arc::Weight> *distance) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+
+  // The DFS stops at the first back arc if the FST is cyclic.
+  std::vector<StateId> order;
+  bool acyclic;
+  TopOrderVisitor<Arc> top_order_visitor(&order, &acyclic);
+  DfsVisit(fst, &top_order_visitor);
+  if (!acyclic) return false;
+  std::vector<StateId> states(order.size());
+  for (size_t s = 0; s < order.size(); ++s) states[order[s]] = s;
+  distance->assign(order.size(), Weight::Zero());
+  for (auto it = states.rbegin(); it != states.rend(); ++it) {
+    const StateId s = *it;
+    Weight d = fst.Final(s);
+    for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      d = Plus(d, Times(arc.weight, (*distance)[arc.nextstate]));
+    }
+    if (!d.Member()) {
+      distance->clear();
+      distance->resize(1, Weight::NoWeight());
+      return true;
+    }
+    (*distance)[s] = d;
+  }
+  if (fst.Properties(kError, false)) {
+    distance->clear();
+    distance->resize(1, Weight::NoWeight());
+  }
+  return true;
+}
+
+}  // namespace internal
+
 // Shortest-distance algorithm: simplified interface. See above for a
 // version that allows finer control.
 //
@@ -257,7 +303,9 @@ void ShortestDistance(
 // Shortest-Distance Problems", Journal of Automata, Languages and
 // Combinatorics 7(3):321-350, 2002. The complexity of algorithm
 // depends on the properties of the semiring and the queue discipline
-// used. Refer to the paper for more details.
+// used. Refer to the paper for more details. If 'reverse' is true and the
+// FST is acyclic, the distances are instead computed exactly in a single
+// pass over the states in reverse topological order.
 template <class Arc>
 void ShortestDistance(const Fst<Arc> &fst,
                       std::vector<typename Arc::Weight> *distance,
@@ -273,6 +321,11 @@ void ShortestDistance(const Fst<Arc> &fst,
     opts.delta = delta;
     ShortestDistance(fst, distance, opts);
   } else {
+    if ((Weight::Properties() & kLeftSemiring) && fst.Start() != kNoStateId &&
+        fst.Properties(kCyclic, false) != kCyclic &&
+        internal::AcyclicReverseShortestDistance(fst, distance)) {
+      return;
+    }
     typedef ReverseArc<Arc> ReverseArc;
     typedef typename ReverseArc::Weight ReverseWeight;
     AnyArcFilter<ReverseArc> rarc_filter;
@@ -7,6 +7,7 @@
 #define FST_LIB_STATESORT_H_
 
 #include <algorithm>
+#include <numeric>
 #include <vector>
 
 #include <fst/mutable-fst.h>
@@ -73,6 +74,269 @@ void StateSort(MutableFst<Arc> *fst,
   fst->SetProperties(props, kFstProperties);
 }
 
+// Built-in state orders for StateSort(), meant to place states that are
+// visited together close to each other in memory.
+enum StateOrderType {
+  STATE_ORDER_BFS,      // Breadth-first from the initial state
+  STATE_ORDER_DFS,      // Depth-first preorder from the initial state
+  STATE_ORDER_RCM,      // Reverse Cuthill-McKee on the undirected graph
+  STATE_ORDER_HOT_PATH  // Depth-first, taking the most sampled arcs first
+};
+
+namespace internal {
+
+// The successors of the states of an FST, in arc order: the arcs of state s
+// lead to targets[offsets[s]] ... targets[offsets[s + 1] - 1]. If
+// 'undirected', the predecessors of each state are appended to its
+// successors.
+template <class Arc>
+struct StateGraph {
+  typedef typename Arc::StateId StateId;
+
+  explicit StateGraph(const Fst<Arc> &fst, bool undirected = false)
+      : start(fst.Start()) {
+    const StateId nstates = CountStates(fst);
+    offsets.assign(nstates + 1, 0);
+    for (StateIterator<Fst<Arc>> siter(fst); !siter.Done(); siter.Next()) {
+      const StateId s = siter.Value();
+      for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        ++offsets[s + 1];
+        if (undirected) ++offsets[aiter.Value().nextstate + 1];
+      }
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    targets.resize(offsets.back());
+    std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (StateIterator<Fst<Arc>> siter(fst); !siter.Done(); siter.Next()) {
+      const StateId s = siter.Value();
+      for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        targets[next[s]++] = aiter.Value().nextstate;
+      }
+    }
+    if (undirected) {
+      for (StateId s = 0; s < nstates; ++s) {
+        for (size_t i = offsets[s]; i < offsets[s] + fst.NumArcs(s); ++i) {
+          targets[next[targets[i]]++] = s;
+        }
+      }
+    }
+  }
+
+  StateId NumStates() const { return offsets.size() - 1; }
+
+  size_t Degree(StateId s) const { return offsets[s + 1] - offsets[s]; }
+
+  StateId start;
+  std::vector<size_t> offsets;
+  std::vector<StateId> targets;
+};
+
+// Visits the states breadth-first from the initial state, then from each
+// unvisited state in turn, and numbers them in visit order.
+template <class Arc>
+void BreadthFirstOrder(const StateGraph<Arc> &graph,
+                       std::vector<typename Arc::StateId> *order) {
+  typedef typename Arc::StateId StateId;
+
+  const StateId nstates = graph.NumStates();
+  order->assign(nstates, kNoStateId);
+  // States in visit order; those after 'head' still have to be expanded.
+  std::vector<StateId> queue;
+  queue.reserve(nstates);
+  StateId root = graph.start == kNoStateId ? 0 : graph.start;
+  for (StateId next_root = 0; queue.size() < static_cast<size_t>(nstates);) {
+    if (root == kNoStateId) {
+      while ((*order)[next_root] != kNoStateId) ++next_root;
+      root = next_root;
+    }
+    size_t head = queue.size();
+    (*order)[root] = head;
+    queue.push_back(root);
+    for (; head < queue.size(); ++head) {
+      const StateId s = queue[head];
+      for (size_t i = graph.offsets[s]; i < graph.offsets[s + 1]; ++i) {
+        const StateId t = graph.targets[i];
+        if ((*order)[t] != kNoStateId) continue;
+        (*order)[t] = queue.size();
+        queue.push_back(t);
+      }
+    }
+    root = kNoStateId;
+  }
+}
+
+// Visits the states depth-first from the initial state, then from each
+// unvisited state in turn, and numbers them in preorder.
+template <class Arc>
+void DepthFirstOrder(const StateGraph<Arc> &graph,
+                     std::vector<typename Arc::StateId> *order) {
+  typedef typename Arc::StateId StateId;
+
+  const StateId nstates = graph.NumStates();
+  order->assign(nstates, kNoStateId);
+  // Pairs of a state and the position of its next successor to visit.
+  std::vector<std::pair<StateId, size_t>> stack;
+  StateId count = 0;
+  StateId root = graph.start == kNoStateId ? 0 : graph.start;
+  for (StateId next_root = 0; count < nstates;) {
+    if (root == kNoStateId) {
+      while ((*order)[next_root] != kNoStateId) ++next_root;
+      root = next_root;
+    }
+    (*order)[root] = count++;
+    stack.emplace_back(root, graph.offsets[root]);
+    while (!stack.empty()) {
+      auto &top = stack.back();
+      if (top.second == graph.offsets[top.first + 1]) {
+        stack.pop_back();
+        continue;
+      }
+      const StateId t = graph.targets[top.second++];
+      if ((*order)[t] != kNoStateId) continue;
+      (*order)[t] = count++;
+      stack.emplace_back(t, graph.offsets[t]);
+    }
+    root = kNoStateId;
+  }
+}
+
+}  // namespace internal
+
+// The following compute in 'order' a renumbering of the states of 'fst' to
+// pass to StateSort(): order[s] is the new ID of state s. Except in
+// RcmStateOrder(), states not reachable from the initial state are numbered
+// after those that are.
+
+// Numbers the states in breadth-first order from the initial state, so
+// that the destinations of the arcs of a state are numbered close together.
+//
+// Complexity:
+// - Time: O(V + E)
+// - Space: O(V + E)
+// where V = # of states and E = # of arcs.
+template <class Arc>
+void BfsStateOrder(const Fst<Arc> &fst,
+                   std::vector<typename Arc::StateId> *order) {
+  internal::BreadthFirstOrder(internal::StateGraph<Arc>(fst), order);
+}
+
+// Numbers the states in depth-first preorder from the initial state, so
+// that the first arc of a state usually leads to the next state.
+//
+// Complexity:
+// - Time: O(V + E)
+// - Space: O(V + E)
+// where V = # of states and E = # of arcs.
+template <class Arc>
+void DfsStateOrder(const Fst<Arc> &fst,
+                   std::vector<typename Arc::StateId> *order) {
+  internal::DepthFirstOrder(internal::StateGraph<Arc>(fst), order);
+}
+
+// Numbers the states in reverse Cuthill-McKee order: breadth-first on the
+// undirected graph of the FST from its initial state, visiting the
+// neighbors of a state by increasing degree, and reversed. This keeps the
+// difference between the IDs of the source and destination of an arc (the
+// bandwidth) small. The initial state gets the last ID, and states not
+// connected to it, ignoring arc direction, get the first IDs.
+//
+// Complexity:
+// - Time: O(V + E log D)
+// - Space: O(V + E)
+// where V = # of states, E = # of arcs and D = maximum degree.
+template <class Arc>
+void RcmStateOrder(const Fst<Arc> &fst,
+                   std::vector<typename Arc::StateId> *order) {
+  typedef typename Arc::StateId StateId;
+
+  internal::StateGraph<Arc> graph(fst, true);
+  for (StateId s = 0; s < graph.NumStates(); ++s) {
+    std::stable_sort(graph.targets.begin() + graph.offsets[s],
+                     graph.targets.begin() + graph.offsets[s + 1],
+                     [&graph](StateId t1, StateId t2) {
+                       return graph.Degree(t1) < graph.Degree(t2);
+                     });
+  }
+  internal::BreadthFirstOrder(graph, order);
+  for (auto &id : *order) id = graph.NumStates() - 1 - id;
+}
+
+// Numbers the states in depth-first preorder from the initial state, taking
+// the arcs of each state in decreasing order of how often they were chosen
+// in 'npath' random paths from the initial state, so that frequently
+// followed paths get consecutive state IDs. Arcs are chosen by 'selector'
+// (see randgen.h) and paths stop at 'max_length' arcs or when the
+// super-final transition is chosen.
+//
+// Complexity:
+// - Time: O(V + E log D + npath * max_length * T)
+// - Space: O(V + E)
+// where V = # of states, E = # of arcs, D = maximum out-degree and T is the
+// time to select an arc.
+template <class Arc, class Selector>
+void HotPathStateOrder(const Fst<Arc> &fst, const Selector &selector,
+                       size_t npath, size_t max_length,
+                       std::vector<typename Arc::StateId> *order) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+
+  internal::StateGraph<Arc> graph(fst);
+  std::vector<size_t> counts(graph.targets.size(), 0);
+  if (graph.start != kNoStateId) {
+    for (size_t path = 0; path < npath; ++path) {
+      StateId s = graph.start;
+      for (size_t length = 0; length < max_length; ++length) {
+        if (graph.Degree(s) == 0 && fst.Final(s) == Weight::Zero()) break;
+        const size_t n = selector(fst, s);
+        if (n >= graph.Degree(s)) break;
+        ++counts[graph.offsets[s] + n];
+        s = graph.targets[graph.offsets[s] + n];
+      }
+    }
+  }
+  std::vector<size_t> positions;
+  std::vector<StateId> targets;
+  for (StateId s = 0; s < graph.NumStates(); ++s) {
+    positions.resize(graph.Degree(s));
+    std::iota(positions.begin(), positions.end(), graph.offsets[s]);
+    std::stable_sort(positions.begin(), positions.end(),
+                     [&counts](size_t i, size_t j) {
+                       return counts[i] > counts[j];
+                     });
+    targets.clear();
+    for (const size_t i : positions) targets.push_back(graph.targets[i]);
+    std::copy(targets.begin(), targets.end(),
+              graph.targets.begin() + graph.offsets[s]);
+  }
+  internal::DepthFirstOrder(graph, order);
+}
+
+// Sorts the states of an FST in one of the built-in orders, modifying it.
+// STATE_ORDER_HOT_PATH samples 'npath' paths of at most 'max_length' arcs
+// with 'selector' (e.g., a UniformArcSelector, see randgen.h); the other
+// orders ignore these arguments.
+template <class Arc, class Selector>
+void StateSort(MutableFst<Arc> *fst, StateOrderType order_type,
+               const Selector &selector, size_t npath = 1000,
+               size_t max_length = 1000) {
+  std::vector<typename Arc::StateId> order;
+  switch (order_type) {
+    case STATE_ORDER_BFS:
+      BfsStateOrder(*fst, &order);
+      break;
+    case STATE_ORDER_DFS:
+      DfsStateOrder(*fst, &order);
+      break;
+    case STATE_ORDER_RCM:
+      RcmStateOrder(*fst, &order);
+      break;
+    case STATE_ORDER_HOT_PATH:
+      HotPathStateOrder(*fst, selector, npath, max_length, &order);
+      break;
+  }
+  StateSort(fst, order);
+}
+
 }  // namespace fst
 
 #endif  // FST_LIB_STATESORT_H_
@@ -91,7 +91,11 @@ uint64 ComputeProperties(const Fst<Arc> &fst, uint64 mask, uint64 *known,
                      kNotCoAccessible;
   std::vector<StateId> scc;
   if (mask & (dfs_props | kWeightedCycles | kUnweightedCycles)) {
-    SccVisitor<Arc> scc_visitor(&scc, nullptr, nullptr, &comp_props);
+    // SCC numbers are only needed for the weighted cycles, found in the arc
+    // iteration below.
+    SccVisitor<Arc> scc_visitor(
+        mask & ~(kBinaryProperties | dfs_props) ? &scc : nullptr, nullptr,
+        nullptr, &comp_props);
     DfsVisit(fst, &scc_visitor);
   }
 
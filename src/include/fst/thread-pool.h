@@ -0,0 +1,156 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// A fixed-size pool of worker threads for the multithreaded variants of the
+// FST algorithms.
+//
+// The rest of the library is single-threaded (see lock.h), so the algorithms
+// using this pool partition their work such that each task writes only to
+// data it owns and otherwise only reads shared data; see the documentation of
+// each algorithm for the conditions this places on its arguments.
+
+#ifndef FST_LIB_THREAD_POOL_H_
+#define FST_LIB_THREAD_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fst {
+
+// Runs loops of independent tasks on a fixed set of threads. The calling
+// thread participates in each loop, so a pool of n threads starts n - 1
+// workers, and a pool of one thread runs everything on the caller without
+// any synchronization. A pool runs one loop at a time: it must not be used
+// concurrently from several threads nor from within one of its own tasks.
+class ThreadPool {
+ public:
+  // Returns the number of threads used when zero is requested.
+  static int DefaultNumThreads() {
+    const int num_threads = std::thread::hardware_concurrency();
+    return num_threads > 0 ? num_threads : 1;
+  }
+
+  // Starts a pool of num_threads threads, or of DefaultNumThreads() threads
+  // when num_threads <= 0.
+  explicit ThreadPool(int num_threads = 0)
+      : num_threads_(num_threads > 0 ? num_threads : DefaultNumThreads()),
+        job_(nullptr),
+        size_(0),
+        grain_(1),
+        generation_(0),
+        active_(0),
+        shutdown_(false),
+        next_(0) {
+    for (int i = 1; i < num_threads_; ++i) {
+      workers_.emplace_back([this, i]() { Work(i); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      shutdown_ = true;
+    }
+    start_.notify_all();
+    for (auto &worker : workers_) worker.join();
+  }
+
+  int NumThreads() const { return num_threads_; }
+
+  // Calls task(i, thread) for each i in [0, size), where thread in
+  // [0, NumThreads()) identifies the thread making the call, so that tasks
+  // can use per-thread scratch storage. Indices are handed out in chunks of
+  // grain consecutive values. Returns once all calls have returned.
+  void ParallelFor(size_t size, const std::function<void(size_t, int)> &task,
+                   size_t grain = 1) {
+    if (size == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    if (workers_.empty() || size <= grain) {
+      for (size_t i = 0; i < size; ++i) task(i, 0);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = &task;
+      size_ = size;
+      grain_ = grain;
+      next_.store(0, std::memory_order_relaxed);
+      active_ = workers_.size();
+      ++generation_;
+    }
+    start_.notify_all();
+    RunChunks(task, 0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return active_ == 0; });
+    job_ = nullptr;
+  }
+
+  // Calls task(begin, end, thread) once per thread on a partition of
+  // [0, size) into at most NumThreads() contiguous ranges.
+  void ParallelForRange(
+      size_t size, const std::function<void(size_t, size_t, int)> &task) {
+    const size_t num_ranges =
+        std::min<size_t>(size, static_cast<size_t>(num_threads_));
+    ParallelFor(num_ranges, [&](size_t r, int thread) {
+      task(r * size / num_ranges, (r + 1) * size / num_ranges, thread);
+    });
+  }
+
+ private:
+  void RunChunks(const std::function<void(size_t, int)> &task, int thread) {
+    for (;;) {
+      const size_t begin = next_.fetch_add(grain_, std::memory_order_relaxed);
+      if (begin >= size_) return;
+      const size_t end = std::min(begin + grain_, size_);
+      for (size_t i = begin; i < end; ++i) task(i, thread);
+    }
+  }
+
+  void Work(int thread) {
+    size_t generation = 0;
+    for (;;) {
+      const std::function<void(size_t, int)> *job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [this, generation]() {
+          return shutdown_ || generation_ != generation;
+        });
+        if (shutdown_) return;
+        generation = generation_;
+        job = job_;
+      }
+      RunChunks(*job, thread);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0) done_.notify_one();
+      }
+    }
+  }
+
+  const int num_threads_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_;  // Signals a new loop or shutdown.
+  std::condition_variable done_;   // Signals that all workers have finished.
+  // The following are guarded by mutex_.
+  const std::function<void(size_t, int)> *job_;
+  size_t size_;
+  size_t grain_;
+  size_t generation_;
+  size_t active_;
+  bool shutdown_;
+  // Next index to hand out in the current loop.
+  std::atomic<size_t> next_;
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+};
+
+}  // namespace fst
+
+#endif  // FST_LIB_THREAD_POOL_H_
@@ -110,6 +110,17 @@ void StlReserve(std::vector<S, T> *c, int64 n) {
   c->reserve(n);
 }
 
+// Specializations for hash tables.
+template <typename S, typename T, typename U>
+void StlReserve(std::unordered_set<S, T, U> *c, int64 n) {
+  c->reserve(n);
+}
+
+template <typename S, typename T, typename U, typename V>
+void StlReserve(std::unordered_map<S, T, U, V> *c, int64 n) {
+  c->reserve(n);
+}
+
 // STL sequence container.
 #define READ_STL_SEQ_TYPE(C)                                      \
   template <typename S, typename T>                               \
@@ -121,7 +132,7 @@ void StlReserve(std::vector<S, T> *c, int64 n) {
     for (ssize_t i = 0; i < n; ++i) {                             \
       typename C<S, T>::value_type value;                         \
       ReadType(strm, &value);                                     \
-      c->insert(c->end(), value);                                 \
+      c->insert(c->end(), std::move(value));                      \
     }                                                             \
     return strm;                                                  \
   }
@@ -136,10 +147,11 @@ READ_STL_SEQ_TYPE(list);
     c->clear();                                                      \
     int64 n = 0;                                                     \
     strm.read(reinterpret_cast<char *>(&n), sizeof(n));              \
+    StlReserve(c, n);                                                \
     for (ssize_t i = 0; i < n; ++i) {                                \
       typename C<S, T, U>::value_type value;                         \
       ReadType(strm, &value);                                        \
-      c->insert(value);                                              \
+      c->insert(std::move(value));                                   \
     }                                                                \
     return strm;                                                     \
   }
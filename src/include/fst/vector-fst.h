@@ -287,7 +287,9 @@ class VectorFstImpl : public VectorFstBaseImpl<S> {
   void SetFinal(StateId s, Weight w) {
     Weight ow = BaseImpl::Final(s);
     BaseImpl::SetFinal(s, w);
-    SetProperties(SetFinalProperties(Properties(), ow, w));
+    counts_.CountWeight(ow, -1);
+    counts_.CountWeight(w, 1);
+    SetProperties(CountedProperties(SetFinalProperties(Properties(), ow, w)));
   }
 
   StateId AddState() {
@@ -301,43 +303,236 @@ class VectorFstImpl : public VectorFstBaseImpl<S> {
     const A *parc = state->NumArcs() == 0
                         ? nullptr
                         : &(state->GetArc(state->NumArcs() - 1));
-    SetProperties(AddArcProperties(Properties(), s, arc, parc));
+    counts_.CountArc(s, arc, 1);
+    if (parc) counts_.CountArcPair(*parc, arc, 1);
+    // The counts determine all the properties AddArcProperties() would set.
+    SetProperties(CountedProperties(Properties() & kAddArcProperties));
     BaseImpl::AddArc(s, arc);
   }
 
   void DeleteStates(const std::vector<StateId> &dstates) {
     BaseImpl::DeleteStates(dstates);
-    SetProperties(DeleteStatesProperties(Properties()));
+    // Renumbering the states changes which arcs are top-sorted.
+    Recount();
+    SetProperties(CountedProperties(DeleteStatesProperties(Properties())));
   }
 
   void DeleteStates() {
     BaseImpl::DeleteStates();
+    counts_ = PropertyCounts();
     SetProperties(DeleteAllStatesProperties(Properties(), kStaticProperties));
   }
 
   void DeleteArcs(StateId s, size_t n) {
+    UncountArcs(s, GetState(s)->NumArcs() - n);
     BaseImpl::DeleteArcs(s, n);
-    SetProperties(DeleteArcsProperties(Properties()));
+    SetProperties(CountedProperties(DeleteArcsProperties(Properties())));
   }
 
   void DeleteArcs(StateId s) {
+    UncountArcs(s, 0);
     BaseImpl::DeleteArcs(s);
-    SetProperties(DeleteArcsProperties(Properties()));
+    SetProperties(CountedProperties(DeleteArcsProperties(Properties())));
+  }
+
+  // Calls 'sort' with the range of the arcs of state 's', which it may only
+  // permute.
+  template <class Sort>
+  void SortArcs(StateId s, Sort sort) {
+    State *state = GetState(s);
+    const size_t narcs = state->NumArcs();
+    if (narcs < 2) return;
+    A *arcs = state->MutableArcs();
+    for (size_t i = 1; i < narcs; ++i) {
+      counts_.CountArcPair(arcs[i - 1], arcs[i], -1);
+    }
+    sort(arcs, arcs + narcs);
+    for (size_t i = 1; i < narcs; ++i) {
+      counts_.CountArcPair(arcs[i - 1], arcs[i], 1);
+    }
+    SetProperties(CountedProperties(Properties() & kArcSortProperties));
+  }
+
+  // Calls 'map(s, begin, end, thread)' for each state 's' with the range of
+  // its arcs, which it may modify in place, concurrently on the threads of
+  // 'pool' (a ThreadPool); 'thread' identifies the calling thread. Each
+  // thread counts the properties of the arcs before and after it maps them,
+  // and the counts are combined once all states are mapped. The properties
+  // are then 'props' with the counted ones recomputed.
+  template <class Pool, class Map>
+  void MapArcs(Pool *pool, Map map, uint64 props) {
+    std::vector<PropertyCounts> before(pool->NumThreads());
+    std::vector<PropertyCounts> after(pool->NumThreads());
+    pool->ParallelFor(NumStates(), [&](size_t i, int thread) {
+      const StateId s = i;
+      State *state = GetState(s);
+      const size_t narcs = state->NumArcs();
+      if (narcs == 0) return;
+      A *arcs = state->MutableArcs();
+      CountArcs(s, arcs, narcs, &before[thread]);
+      map(s, arcs, arcs + narcs, thread);
+      CountArcs(s, arcs, narcs, &after[thread]);
+      size_t niepsilons = 0;
+      size_t noepsilons = 0;
+      for (size_t j = 0; j < narcs; ++j) {
+        niepsilons += arcs[j].ilabel == 0;
+        noepsilons += arcs[j].olabel == 0;
+      }
+      state->SetNumInputEpsilons(niepsilons);
+      state->SetNumOutputEpsilons(noepsilons);
+    }, 1024);
+    for (size_t i = 0; i < before.size(); ++i) {
+      counts_.Add(after[i], 1);
+      counts_.Add(before[i], -1);
+    }
+    SetProperties(CountedProperties(props), kFstProperties);
   }
 
   // Properties always true of this Fst class
   static const uint64 kStaticProperties = kExpanded | kMutable;
 
  private:
+  // Properties determined exactly by the PropertyCounts below.
+  static const uint64 kCountedProperties =
+      kAcceptor | kNotAcceptor | kEpsilons | kNoEpsilons | kIEpsilons |
+      kNoIEpsilons | kOEpsilons | kNoOEpsilons | kILabelSorted |
+      kNotILabelSorted | kOLabelSorted | kNotOLabelSorted | kWeighted |
+      kUnweighted | kTopSorted | kNotTopSorted;
+
+  // Counts of the arcs and final weights violating each of the counted
+  // properties. Kept up to date by every mutation, so that these properties
+  // stay known, rather than being cleared by deletions and changed final
+  // weights and arcs. Cyclicity, accessibility and determinism are not
+  // tracked and still require ComputeProperties().
+  struct PropertyCounts {
+    int64 nonacceptor_arcs;  // # of arcs with ilabel != olabel
+    int64 epsilon_arcs;      // # of arcs with ilabel == olabel == 0
+    int64 iepsilon_arcs;     // # of arcs with ilabel == 0
+    int64 oepsilon_arcs;     // # of arcs with olabel == 0
+    int64 weights;           // # of arc and final weights not Zero or One
+    int64 unsorted_ilabels;  // # of consecutive arcs out of ilabel order
+    int64 unsorted_olabels;  // # of consecutive arcs out of olabel order
+    int64 backward_arcs;     // # of arcs to the same or an earlier state
+
+    PropertyCounts()
+        : nonacceptor_arcs(0),
+          epsilon_arcs(0),
+          iepsilon_arcs(0),
+          oepsilon_arcs(0),
+          weights(0),
+          unsorted_ilabels(0),
+          unsorted_olabels(0),
+          backward_arcs(0) {}
+
+    // Adds 'n' (1 or -1) times the counts for an arc leaving state 's'.
+    // The counts are updated without branching on the (often unpredictable)
+    // arc labels and weights.
+    void CountArc(StateId s, const A &arc, int64 n) {
+      nonacceptor_arcs += n * (arc.ilabel != arc.olabel);
+      epsilon_arcs += n * ((arc.ilabel == 0) & (arc.olabel == 0));
+      iepsilon_arcs += n * (arc.ilabel == 0);
+      oepsilon_arcs += n * (arc.olabel == 0);
+      backward_arcs += n * (arc.nextstate <= s);
+      CountWeight(arc.weight, n);
+    }
+
+    // Adds 'n' times the counts for consecutive arcs 'arc1' and 'arc2'.
+    void CountArcPair(const A &arc1, const A &arc2, int64 n) {
+      unsorted_ilabels += n * (arc1.ilabel > arc2.ilabel);
+      unsorted_olabels += n * (arc1.olabel > arc2.olabel);
+    }
+
+    void CountWeight(const Weight &weight, int64 n) {
+      // Nothing to subtract if no weight was counted; saves the comparisons.
+      if (n < 0 && weights == 0) return;
+      weights += n * ((weight != Weight::Zero()) & (weight != Weight::One()));
+    }
+
+    // Adds 'n' times the counts in 'counts'.
+    void Add(const PropertyCounts &counts, int64 n) {
+      nonacceptor_arcs += n * counts.nonacceptor_arcs;
+      epsilon_arcs += n * counts.epsilon_arcs;
+      iepsilon_arcs += n * counts.iepsilon_arcs;
+      oepsilon_arcs += n * counts.oepsilon_arcs;
+      weights += n * counts.weights;
+      unsorted_ilabels += n * counts.unsorted_ilabels;
+      unsorted_olabels += n * counts.unsorted_olabels;
+      backward_arcs += n * counts.backward_arcs;
+    }
+  };
+
+  // Sets the counted properties in 'props' from the counts.
+  uint64 CountedProperties(uint64 props) const {
+    props &= ~kCountedProperties;
+    props |= counts_.nonacceptor_arcs ? kNotAcceptor : kAcceptor;
+    props |= counts_.epsilon_arcs ? kEpsilons : kNoEpsilons;
+    props |= counts_.iepsilon_arcs ? kIEpsilons : kNoIEpsilons;
+    props |= counts_.oepsilon_arcs ? kOEpsilons : kNoOEpsilons;
+    props |= counts_.weights ? kWeighted : kUnweighted;
+    props |= counts_.unsorted_ilabels ? kNotILabelSorted : kILabelSorted;
+    props |= counts_.unsorted_olabels ? kNotOLabelSorted : kOLabelSorted;
+    if (counts_.backward_arcs) {
+      props |= kNotTopSorted;
+    } else {
+      props |= kTopSorted | kAcyclic | kInitialAcyclic;
+      props &= ~(kCyclic | kInitialCyclic);
+    }
+    return props;
+  }
+
+  // Adds the counts for the arcs of state 's'.
+  void CountArcs(StateId s) {
+    const State *state = GetState(s);
+    for (size_t i = 0; i < state->NumArcs(); ++i) {
+      counts_.CountArc(s, state->GetArc(i), 1);
+      if (i > 0) {
+        counts_.CountArcPair(state->GetArc(i - 1), state->GetArc(i), 1);
+      }
+    }
+  }
+
+  // Adds to 'counts' the counts for the 'narcs' arcs of state 's' at 'arcs'.
+  static void CountArcs(StateId s, const A *arcs, size_t narcs,
+                        PropertyCounts *counts) {
+    for (size_t i = 0; i < narcs; ++i) {
+      counts->CountArc(s, arcs[i], 1);
+      if (i > 0) counts->CountArcPair(arcs[i - 1], arcs[i], 1);
+    }
+  }
+
+  // Subtracts the counts for the arcs of state 's' from position 'n' on.
+  void UncountArcs(StateId s, size_t n) {
+    const State *state = GetState(s);
+    for (size_t i = n; i < state->NumArcs(); ++i) {
+      counts_.CountArc(s, state->GetArc(i), -1);
+      if (i > 0) {
+        counts_.CountArcPair(state->GetArc(i - 1), state->GetArc(i), -1);
+      }
+    }
+  }
+
+  // Recomputes the counts from all states.
+  void Recount() {
+    counts_ = PropertyCounts();
+    for (StateId s = 0; s < NumStates(); ++s) {
+      counts_.CountWeight(GetState(s)->Final(), 1);
+      CountArcs(s);
+    }
+  }
+
   // Current file format version
   static const int kFileVersion = 2;
   // Minimum file format version supported
   static const int kMinFileVersion = 1;
+
+  PropertyCounts counts_;
 };
 
 template <class S>
 const uint64 VectorFstImpl<S>::kStaticProperties;
 template <class S>
+const uint64 VectorFstImpl<S>::kCountedProperties;
+template <class S>
 const int VectorFstImpl<S>::kFileVersion;
 template <class S>
 const int VectorFstImpl<S>::kMinFileVersion;
@@ -361,8 +556,11 @@ VectorFstImpl<S>::VectorFstImpl(const Fst<A> &fst) {
       const A &arc = aiter.Value();
       BaseImpl::AddArc(s, arc);
     }
+    counts_.CountWeight(BaseImpl::Final(s), 1);
+    CountArcs(s);
   }
-  SetProperties(fst.Properties(kCopyProperties, false) | kStaticProperties);
+  SetProperties(CountedProperties(fst.Properties(kCopyProperties, false) |
+                                  kStaticProperties));
 }
 
 template <class S>
@@ -404,11 +602,14 @@ VectorFstImpl<S> *VectorFstImpl<S>::Read(std::istream &strm,
       }
       impl->BaseImpl::AddArc(s, arc);
     }
+    impl->counts_.CountWeight(final, 1);
+    impl->CountArcs(s);
   }
   if (hdr.NumStates() != kNoStateId && s != hdr.NumStates()) {
     LOG(ERROR) << "VectorFst::Read: Unexpected end of file: " << opts.source;
     return nullptr;
   }
+  impl->SetProperties(impl->CountedProperties(impl->Properties()));
   return impl.release();
 }
 
@@ -446,7 +647,8 @@ inline LogWeight WeightFromString<LogWeight>::operator()(const string &s) {
 // Simple concrete, mutable FST. This class attaches interface to
 // implementation and handles reference counting, delegating most
 // methods to ImplToMutableFst. Supports additional operations:
-// ReserveStates and ReserveArcs (cf. STL vectors). The second
+// ReserveStates and ReserveArcs (cf. STL vectors), and SortArcs to
+// reorder the arcs of a state in place (see ArcSort()). The second
 // optional template argument gives the State definition (default
 // declared in fst-decl.h).
 template <class A, class S /* = VectorState<A> */>
@@ -525,7 +727,29 @@ class VectorFst : public ImplToMutableFst<VectorFstImpl<S>> {
   using ImplToMutableFst<Impl, MutableFst<A>>::ReserveArcs;
   using ImplToMutableFst<Impl, MutableFst<A>>::ReserveStates;
 
+  // Calls 'sort' with the range of the arcs of state 's' (a pair of Arc
+  // pointers), which it may only permute.
+  template <class Sort>
+  void SortArcs(StateId s, Sort sort) {
+    MutateCheck();
+    GetMutableImpl()->SortArcs(s, sort);
+  }
+
+  // Calls 'map(s, begin, end, thread)' for each state 's' with the range of
+  // its arcs (a pair of Arc pointers), which it may modify in place,
+  // concurrently on the threads of 'pool' (a ThreadPool); 'thread' in
+  // [0, pool->NumThreads()) identifies the calling thread. Calls for
+  // different states must not access the same data other than read-only.
+  // The properties are then 'props', with those determined by the arc labels,
+  // weights and destinations (e.g., kAcceptor, kILabelSorted) recomputed.
+  template <class Pool, class Map>
+  void MapArcs(Pool *pool, Map map, uint64 props) {
+    MutateCheck();
+    GetMutableImpl()->MapArcs(pool, map, props);
+  }
+
  private:
+  using ImplToMutableFst<Impl, MutableFst<A>>::GetMutableImpl;
   using ImplToMutableFst<Impl, MutableFst<A>>::GetImpl;
   using ImplToMutableFst<Impl, MutableFst<A>>::MutateCheck;
   using ImplToMutableFst<Impl, MutableFst<A>>::SetImpl;
@@ -657,10 +881,11 @@ class MutableArcIterator<VectorFst<A, S>> : public MutableArcIteratorBase<A> {
   typedef typename A::StateId StateId;
   typedef typename A::Weight Weight;
 
-  MutableArcIterator(VectorFst<A, S> *fst, StateId s) : i_(0) {
+  MutableArcIterator(VectorFst<A, S> *fst, StateId s) : s_(s), i_(0) {
     fst->MutateCheck();
-    state_ = fst->GetMutableImpl()->GetState(s);
-    properties_ = &fst->GetImpl()->properties_;
+    impl_ = fst->GetMutableImpl();
+    state_ = impl_->GetState(s);
+    properties_ = &impl_->properties_;
   }
 
   bool Done() const { return i_ >= state_->NumArcs(); }
@@ -676,44 +901,10 @@ class MutableArcIterator<VectorFst<A, S>> : public MutableArcIteratorBase<A> {
   void Seek(size_t a) { i_ = a; }
 
   void SetValue(const A &arc) {
-    const A &oarc = state_->GetArc(i_);
-    if (oarc.ilabel != oarc.olabel) *properties_ &= ~kNotAcceptor;
-    if (oarc.ilabel == 0) {
-      *properties_ &= ~kIEpsilons;
-      if (oarc.olabel == 0) *properties_ &= ~kEpsilons;
-    }
-    if (oarc.olabel == 0) {
-      *properties_ &= ~kOEpsilons;
-    }
-    if (oarc.weight != Weight::Zero() && oarc.weight != Weight::One()) {
-      *properties_ &= ~kWeighted;
-    }
-
+    CountArc(-1);
     state_->SetArc(arc, i_);
-
-    if (arc.ilabel != arc.olabel) {
-      *properties_ |= kNotAcceptor;
-      *properties_ &= ~kAcceptor;
-    }
-    if (arc.ilabel == 0) {
-      *properties_ |= kIEpsilons;
-      *properties_ &= ~kNoIEpsilons;
-      if (arc.olabel == 0) {
-        *properties_ |= kEpsilons;
-        *properties_ &= ~kNoEpsilons;
-      }
-    }
-    if (arc.olabel == 0) {
-      *properties_ |= kOEpsilons;
-      *properties_ &= ~kNoOEpsilons;
-    }
-    if (arc.weight != Weight::Zero() && arc.weight != Weight::One()) {
-      *properties_ |= kWeighted;
-      *properties_ &= ~kUnweighted;
-    }
-    *properties_ &= kSetArcProperties | kAcceptor | kNotAcceptor | kEpsilons |
-                    kNoEpsilons | kIEpsilons | kNoIEpsilons | kOEpsilons |
-                    kNoOEpsilons | kWeighted | kUnweighted;
+    CountArc(1);
+    *properties_ = impl_->CountedProperties(*properties_ & kSetArcProperties);
   }
 
   uint32 Flags() const { return kArcValueFlags; }
@@ -734,8 +925,22 @@ class MutableArcIterator<VectorFst<A, S>> : public MutableArcIteratorBase<A> {
   uint32 Flags_() const override { return Flags(); }
   void SetFlags_(uint32 f, uint32 m) override { SetFlags(f, m); }
 
+  // Adds 'n' times the counts for the current arc and its neighbors.
+  void CountArc(int64 n) {
+    auto &counts = impl_->counts_;
+    counts.CountArc(s_, state_->GetArc(i_), n);
+    if (i_ > 0) {
+      counts.CountArcPair(state_->GetArc(i_ - 1), state_->GetArc(i_), n);
+    }
+    if (i_ + 1 < state_->NumArcs()) {
+      counts.CountArcPair(state_->GetArc(i_), state_->GetArc(i_ + 1), n);
+    }
+  }
+
+  VectorFstImpl<S> *impl_;
   State *state_;
   uint64 *properties_;
+  StateId s_;
   size_t i_;
 };
 
@@ -46,9 +46,18 @@ int64 StrToInt64(const string &s, const string &src, size_t nline,
 }
 
 void Int64ToStr(int64 n, string *s) {
-  std::ostringstream nstr;
-  nstr << n;
-  s->append(nstr.str().data(), nstr.str().size());
+  // Formats directly into a local buffer; this is called per field by the
+  // text printers and drawers, where stream formatting dominates.
+  char buf[24];
+  char *end = buf + sizeof(buf);
+  char *p = end;
+  uint64 u = n < 0 ? -static_cast<uint64>(n) : static_cast<uint64>(n);
+  do {
+    *--p = '0' + static_cast<char>(u % 10);
+    u /= 10;
+  } while (u != 0);
+  if (n < 0) *--p = '-';
+  s->append(p, end - p);
 }
 
 void ConvertToLegalCSymbol(string *s) {
@@ -0,0 +1,23 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#include <fst/script/arc-array.h>
+#include <fst/script/fst-class.h>
+#include <fst/script/script-impl.h>
+
+namespace fst {
+namespace script {
+
+bool GetArcArray(const FstClass &fst, ArcArray *array) {
+  GetArcArrayInnerArgs iargs(fst, array);
+  GetArcArrayArgs args(iargs);
+  Apply<Operation<GetArcArrayArgs>>("GetArcArray", fst.ArcType(), &args);
+  return args.retval;
+}
+
+REGISTER_FST_OPERATION(GetArcArray, StdArc, GetArcArrayArgs);
+REGISTER_FST_OPERATION(GetArcArray, LogArc, GetArcArrayArgs);
+REGISTER_FST_OPERATION(GetArcArray, Log64Arc, GetArcArrayArgs);
+
+}  // namespace script
+}  // namespace fst
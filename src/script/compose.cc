@@ -1,6 +1,9 @@
 // See www.openfst.org for extensive documentation on this weighted
 // finite-state transducer library.
 
+#include <string>
+#include <vector>
+
 #include <fst/script/fst-class.h>
 #include <fst/script/compose.h>
 #include <fst/script/script-impl.h>
@@ -32,6 +35,47 @@ void Compose(const FstClass &ifst1, const FstClass &ifst2,
   Apply<Operation<ComposeArgs2>>("Compose", ifst1.ArcType(), &args);
 }
 
+// 3
+void Compose(const std::vector<FstClassPair> &ifsts,
+             const std::vector<MutableFstClass *> &ofsts,
+             const ComposeOptions &copts, int num_threads) {
+  if (ifsts.size() != ofsts.size()) {
+    FSTERROR() << "Compose: Number of input pairs (" << ifsts.size()
+               << ") and output FSTs (" << ofsts.size() << ") differ";
+    for (auto *ofst : ofsts) ofst->SetProperties(kError, kError);
+    return;
+  }
+  // Groups the pairs by arc type, in order of first appearance.
+  std::vector<string> arc_types;
+  std::vector<std::vector<FstClassPair>> group_ifsts;
+  std::vector<std::vector<MutableFstClass *>> group_ofsts;
+  for (size_t i = 0; i < ifsts.size(); ++i) {
+    const FstClass &ifst1 = *ifsts[i].first;
+    const FstClass &ifst2 = *ifsts[i].second;
+    MutableFstClass *ofst = ofsts[i];
+    if (!ArcTypesMatch(ifst1, ifst2, "Compose") ||
+        !ArcTypesMatch(*ofst, ifst1, "Compose")) {
+      ofst->SetProperties(kError, kError);
+      continue;
+    }
+    size_t group = 0;
+    while (group < arc_types.size() && arc_types[group] != ifst1.ArcType())
+      ++group;
+    if (group == arc_types.size()) {
+      arc_types.push_back(ifst1.ArcType());
+      group_ifsts.emplace_back();
+      group_ofsts.emplace_back();
+    }
+    group_ifsts[group].push_back(ifsts[i]);
+    group_ofsts[group].push_back(ofst);
+  }
+  ThreadPool pool(num_threads);
+  for (size_t group = 0; group < arc_types.size(); ++group) {
+    ComposeArgs3 args(group_ifsts[group], group_ofsts[group], copts, &pool);
+    Apply<Operation<ComposeArgs3>>("Compose", arc_types[group], &args);
+  }
+}
+
 REGISTER_FST_OPERATION(Compose, StdArc, ComposeArgs1);
 REGISTER_FST_OPERATION(Compose, LogArc, ComposeArgs1);
 REGISTER_FST_OPERATION(Compose, Log64Arc, ComposeArgs1);
@@ -40,5 +84,9 @@ REGISTER_FST_OPERATION(Compose, StdArc, ComposeArgs2);
 REGISTER_FST_OPERATION(Compose, LogArc, ComposeArgs2);
 REGISTER_FST_OPERATION(Compose, Log64Arc, ComposeArgs2);
 
+REGISTER_FST_OPERATION(Compose, StdArc, ComposeArgs3);
+REGISTER_FST_OPERATION(Compose, LogArc, ComposeArgs3);
+REGISTER_FST_OPERATION(Compose, Log64Arc, ComposeArgs3);
+
 }  // namespace script
 }  // namespace fst
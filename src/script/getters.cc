@@ -127,5 +127,20 @@ bool GetReplaceLabelType(const string &str, bool epsilon_on_replace,
   return true;
 }
 
+bool GetStateOrderType(const string &str, StateOrderType *order_type) {
+  if (str == "bfs") {
+    *order_type = STATE_ORDER_BFS;
+  } else if (str == "dfs") {
+    *order_type = STATE_ORDER_DFS;
+  } else if (str == "rcm") {
+    *order_type = STATE_ORDER_RCM;
+  } else if (str == "hot_path") {
+    *order_type = STATE_ORDER_HOT_PATH;
+  } else {
+    return false;
+  }
+  return true;
+}
+
 }  // namespace script
 }  // namespace fst
@@ -24,6 +24,17 @@ void ShortestDistance(const FstClass &ifst, std::vector<WeightClass> *distance,
                                           &args);
 }
 
+// 4
+bool ShortestDistance(const FstClass &ifst, std::vector<double> *distance,
+                      bool reverse, double delta) {
+  ShortestDistanceInnerArgs4 iargs(ifst, distance, reverse, delta);
+  ShortestDistanceArgs4 args(iargs);
+  args.retval = false;
+  Apply<Operation<ShortestDistanceArgs4>>("ShortestDistance", ifst.ArcType(),
+                                          &args);
+  return args.retval;
+}
+
 REGISTER_FST_OPERATION(ShortestDistance, StdArc, ShortestDistanceArgs1);
 REGISTER_FST_OPERATION(ShortestDistance, LogArc, ShortestDistanceArgs1);
 REGISTER_FST_OPERATION(ShortestDistance, Log64Arc, ShortestDistanceArgs1);
@@ -32,5 +43,9 @@ REGISTER_FST_OPERATION(ShortestDistance, StdArc, ShortestDistanceArgs2);
 REGISTER_FST_OPERATION(ShortestDistance, LogArc, ShortestDistanceArgs2);
 REGISTER_FST_OPERATION(ShortestDistance, Log64Arc, ShortestDistanceArgs2);
 
+REGISTER_FST_OPERATION(ShortestDistance, StdArc, ShortestDistanceArgs4);
+REGISTER_FST_OPERATION(ShortestDistance, LogArc, ShortestDistanceArgs4);
+REGISTER_FST_OPERATION(ShortestDistance, Log64Arc, ShortestDistanceArgs4);
+
 }  // namespace script
 }  // namespace fst
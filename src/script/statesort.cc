@@ -0,0 +1,23 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#include <fst/script/fst-class.h>
+#include <fst/script/script-impl.h>
+#include <fst/script/statesort.h>
+
+namespace fst {
+namespace script {
+
+void StateSort(MutableFstClass *fst, StateOrderType order_type,
+               RandArcSelection selection, int32 npath, int32 max_length,
+               time_t seed) {
+  StateSortArgs args(fst, order_type, selection, npath, max_length, seed);
+  Apply<Operation<StateSortArgs>>("StateSort", fst->ArcType(), &args);
+}
+
+REGISTER_FST_OPERATION(StateSort, StdArc, StateSortArgs);
+REGISTER_FST_OPERATION(StateSort, LogArc, StateSortArgs);
+REGISTER_FST_OPERATION(StateSort, Log64Arc, StateSortArgs);
+
+}  // namespace script
+}  // namespace fst
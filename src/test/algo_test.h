@@ -87,6 +87,7 @@ class WeightedTester {
     TestMap(T1);
     TestCompose(T1, T2, T3);
     TestSort(T1);
+    TestMutate(T1);
     TestOptimize(T1);
     TestSearch(T1);
   }
@@ -299,6 +300,64 @@ class WeightedTester {
       CHECK(Equiv(C, P));
     }
 
+    {
+      VLOG(1) << "Check eager spliced and delayed replacement are "
+              << "equivalent.";
+      // The root calls T1 and T2, and T2 calls T1.
+      const Label kRoot = 100, kNonTerminal1 = 101, kNonTerminal2 = 102;
+      // Each Fst also has an inaccessible state calling the others, which
+      // the replacement drops.
+      VectorFst<Arc> R;
+      R.AddState();
+      R.AddState();
+      R.AddState();
+      R.AddState();
+      R.SetStart(0);
+      R.SetFinal(2, Weight::One());
+      R.AddArc(0, Arc(1, kNonTerminal1, Weight::One(), 1));
+      R.AddArc(1, Arc(2, kNonTerminal2, Weight::One(), 2));
+      R.AddArc(0, Arc(3, kNonTerminal2, Weight::One(), 2));
+      R.AddArc(3, Arc(4, kNonTerminal1, Weight::One(), 2));
+      VectorFst<Arc> N1(T1);
+      N1.AddArc(N1.AddState(), Arc(5, 6, Weight::One(), 0));
+      VectorFst<Arc> N2(T2);
+      if (N2.Start() != kNoStateId) {
+        const StateId s = N2.AddState();
+        N2.AddArc(N2.Start(), Arc(0, kNonTerminal1, Weight::One(), s));
+        N2.SetFinal(s, Weight::One());
+      }
+      N2.AddArc(N2.AddState(), Arc(0, kNonTerminal1, Weight::One(), 0));
+      std::vector<std::pair<Label, const Fst<Arc> *>> fst_pairs;
+      fst_pairs.push_back(std::make_pair(kRoot, &R));
+      fst_pairs.push_back(std::make_pair(kNonTerminal1, &N1));
+      fst_pairs.push_back(std::make_pair(kNonTerminal2, &N2));
+      ReplaceUtilOptions opts(kRoot);
+      opts.num_threads = 2;
+      VectorFst<Arc> S1, S2;
+      SpliceReplace(fst_pairs, &S1, opts);
+      Replace(fst_pairs, &S2, opts);
+      CHECK_EQ(S1.NumStates(), S2.NumStates());
+      CHECK(Equiv(S1, S2));
+
+      // Replacing only T1 gives, for each Fst calling it, the delayed
+      // replacement of T1 into that Fst.
+      ReplaceUtil<Arc> replace_util(fst_pairs, opts);
+      replace_util.ReplaceLabels(std::vector<Label>(1, kNonTerminal1));
+      std::vector<std::pair<Label, const Fst<Arc> *>> replaced_pairs;
+      replace_util.GetFstPairs(&replaced_pairs);
+      for (const auto &replaced_pair : replaced_pairs) {
+        if (replaced_pair.first == kNonTerminal1) continue;
+        std::vector<std::pair<Label, const Fst<Arc> *>> delayed_pairs;
+        delayed_pairs.push_back(std::make_pair(
+            replaced_pair.first, replaced_pair.first == kRoot ? &R : &N2));
+        delayed_pairs.push_back(std::make_pair(kNonTerminal1, &N1));
+        VectorFst<Arc> D;
+        Replace(delayed_pairs, &D, ReplaceUtilOptions(replaced_pair.first));
+        CHECK_EQ(CountStates(*replaced_pair.second), D.NumStates());
+        CHECK(Equiv(*replaced_pair.second, D));
+      }
+    }
+
     if (Weight::Properties() & kRightSemiring) {
       VLOG(1) << "Check T* T == T+ (delayed).";
       ClosureFst<Arc> S(T1, CLOSURE_STAR);
@@ -575,6 +634,60 @@ class WeightedTester {
       CHECK(Equiv(S1, S2));
     }
 
+    {
+      VLOG(1) << "Check radix arc sorting is a stable sort.";
+      // Enough arcs, with labels spanning several bytes, to be radix sorted.
+      static const int kNumSortArcs = 1000;
+      VectorFst<Arc> S1;
+      S1.SetStart(S1.AddState());
+      S1.SetFinal(0, Weight::One());
+      for (int i = 0; i < kNumSortArcs; ++i) {
+        S1.AddArc(0, Arc(rand() % 100000, rand() % 3, (*weight_generator_)(),
+                         0));
+      }
+      std::vector<Arc> arcs;
+      for (ArcIterator<VectorFst<Arc>> aiter(S1, 0); !aiter.Done();
+           aiter.Next()) {
+        arcs.push_back(aiter.Value());
+      }
+      std::stable_sort(arcs.begin(), arcs.end(), icomp);
+      // Sorts in place and through the generic MutableFst interface.
+      VectorFst<Arc, VectorState<Arc, PoolAllocator<Arc>>> S2(S1);
+      ArcSort(&S1, icomp);
+      ArcSort(static_cast<MutableFst<Arc> *>(&S2), icomp);
+      CHECK(S1.Properties(kILabelSorted, true));
+      CHECK(S2.Properties(kILabelSorted, true));
+      ArcIterator<VectorFst<Arc>> aiter1(S1, 0);
+      ArcIterator<VectorFst<Arc, VectorState<Arc, PoolAllocator<Arc>>>> aiter2(
+          S2, 0);
+      for (const Arc &arc : arcs) {
+        CHECK_EQ(aiter1.Value().ilabel, arc.ilabel);
+        CHECK_EQ(aiter1.Value().olabel, arc.olabel);
+        CHECK(aiter1.Value().weight == arc.weight);
+        CHECK_EQ(aiter2.Value().ilabel, arc.ilabel);
+        CHECK_EQ(aiter2.Value().olabel, arc.olabel);
+        CHECK(aiter2.Value().weight == arc.weight);
+        aiter1.Next();
+        aiter2.Next();
+      }
+    }
+
+    {
+      VLOG(1) << "Check relabeling while sorting equals relabeling, "
+              << "then sorting.";
+      std::vector<std::pair<Label, Label>> ipairs, opairs;
+      ipairs.push_back(std::make_pair(1, 4));
+      ipairs.push_back(std::make_pair(4, 1));
+      opairs.push_back(std::make_pair(0, 3));
+      VectorFst<Arc> S1(T);
+      VectorFst<Arc> S2(T);
+      ArcSort(&S1, ocomp, ipairs, opairs);
+      Relabel(&S2, ipairs, opairs);
+      ArcSort(&S2, ocomp);
+      CHECK(S1.Properties(kOLabelSorted, true));
+      CHECK(Equiv(S1, S2));
+    }
+
     {
       VLOG(1) << "Check topologically sorted Fst is equivalent to its input.";
       VectorFst<Arc> S1(T);
@@ -582,6 +695,26 @@ class WeightedTester {
       CHECK(Equiv(T, S1));
     }
 
+    {
+      VLOG(1) << "Check state sorted Fsts are equivalent to their input.";
+      const StateOrderType order_types[] = {
+          STATE_ORDER_BFS, STATE_ORDER_DFS, STATE_ORDER_RCM,
+          STATE_ORDER_HOT_PATH};
+      UniformArcSelector<Arc> selector(seed_);
+      for (const StateOrderType order_type : order_types) {
+        VectorFst<Arc> S1(T);
+        StateSort(&S1, order_type, selector, 100, 25);
+        CHECK_EQ(S1.NumStates(), CountStates(T));
+        CHECK(Equiv(T, S1));
+        if (S1.Start() == kNoStateId) continue;
+        // Only the reverse Cuthill-McKee order does not number the initial
+        // state first.
+        CHECK_EQ(S1.Start(), order_type == STATE_ORDER_RCM
+                                 ? S1.NumStates() - 1
+                                 : 0);
+      }
+    }
+
     {
       VLOG(1) << "Check reverse(reverse(T)) = T";
       for (int i = 0; i < 2; ++i) {
@@ -595,6 +728,136 @@ class WeightedTester {
     }
   }
 
+  // Tests that the properties a VectorFst keeps as it is mutated agree with
+  // those computed from scratch.
+  void TestMutate(const Fst<Arc> &T) {
+    VLOG(1) << "Check properties of a mutated VectorFst.";
+    static const int kNumMutations = 50;
+    static const int kNumMutateLabels = 3;
+    ILabelCompare<Arc> icomp;
+    OLabelCompare<Arc> ocomp;
+    VectorFst<Arc> V(T);
+    if (V.Start() == kNoStateId) {
+      V.SetStart(V.NumStates() > 0 ? 0 : V.AddState());
+    }
+    CheckMutatedProperties(V);
+    for (int i = 0; i < kNumMutations; ++i) {
+      const StateId s = rand() % V.NumStates();
+      const size_t narcs = V.NumArcs(s);
+      Weight w = Weight::Zero();
+      switch (rand() % 3) {
+        case 0:
+          w = Weight::One();
+          break;
+        case 1:
+          w = (*weight_generator_)();
+          break;
+      }
+      switch (rand() % 9) {
+        case 0:
+          V.AddArc(s, Arc(rand() % kNumMutateLabels, rand() % kNumMutateLabels,
+                          w, rand() % V.NumStates()));
+          break;
+        case 1:
+          V.DeleteArcs(s, rand() % (narcs + 1));
+          break;
+        case 2:
+          V.DeleteArcs(s);
+          break;
+        case 3:
+          if (narcs > 0) {
+            MutableArcIterator<VectorFst<Arc>> aiter(&V, s);
+            aiter.Seek(rand() % narcs);
+            Arc arc = aiter.Value();
+            arc.ilabel = rand() % kNumMutateLabels;
+            arc.weight = w;
+            aiter.SetValue(arc);
+          }
+          break;
+        case 4:
+          V.SetFinal(s, w);
+          break;
+        case 5: {
+          std::vector<StateId> dstates;
+          // Keeps the initial state, without which the FST is ill-formed.
+          for (StateId d = 0; d < V.NumStates(); ++d) {
+            if (d != V.Start() && rand() % 4 == 0) dstates.push_back(d);
+          }
+          V.DeleteStates(dstates);
+          break;
+        }
+        case 6:
+          if (rand() % 2) {
+            V.SortArcs(s, [&icomp](Arc *begin, Arc *end) {
+              std::sort(begin, end, icomp);
+            });
+          } else {
+            V.SortArcs(s, [&ocomp](Arc *begin, Arc *end) {
+              std::sort(begin, end, ocomp);
+            });
+          }
+          break;
+        case 7:
+          V.AddState();
+          break;
+        case 8:
+          if (rand() % 2) {
+            ArcSort(&V, icomp);
+          } else {
+            ArcSort(&V, ocomp);
+          }
+          break;
+      }
+      CheckMutatedProperties(V);
+    }
+  }
+
+  // Checks that the stored properties of 'fst' are compatible with the
+  // computed ones and that those a VectorFst counts are all known.
+  void CheckMutatedProperties(const VectorFst<Arc> &fst) {
+    static const uint64 kCountedProperties =
+        kAcceptor | kNotAcceptor | kEpsilons | kNoEpsilons | kIEpsilons |
+        kNoIEpsilons | kOEpsilons | kNoOEpsilons | kILabelSorted |
+        kNotILabelSorted | kOLabelSorted | kNotOLabelSorted | kWeighted |
+        kUnweighted | kTopSorted | kNotTopSorted;
+    const uint64 stored_props = fst.Properties(kFstProperties, false);
+    uint64 known;
+    const uint64 props =
+        ComputeProperties(fst, kFstProperties, &known, false);
+    CHECK(CompatProperties(stored_props, props));
+    CHECK_EQ(KnownProperties(stored_props) & kCountedProperties,
+             kCountedProperties);
+  }
+
+  // Checks that ParallelScc() finds the components found by SccVisitor, in
+  // topological order, and that ParallelConnect() trims as Connect() does.
+  void CheckParallelScc(const VectorFst<Arc> &fst) {
+    std::vector<StateId> scc1, scc2;
+    uint64 props = 0;
+    SccVisitor<Arc> visitor(&scc1, nullptr, nullptr, &props);
+    DfsVisit(fst, &visitor);
+    const StateId nscc = ParallelScc(fst, &scc2, AnyArcFilter<Arc>(), 4);
+    CHECK_EQ(scc1.size(), scc2.size());
+    std::vector<StateId> map1(nscc, kNoStateId), map2(nscc, kNoStateId);
+    for (size_t s = 0; s < scc1.size(); ++s) {
+      CHECK_LT(scc1[s], nscc);
+      CHECK_LT(scc2[s], nscc);
+      if (map1[scc1[s]] == kNoStateId) map1[scc1[s]] = scc2[s];
+      if (map2[scc2[s]] == kNoStateId) map2[scc2[s]] = scc1[s];
+      CHECK_EQ(map1[scc1[s]], scc2[s]);
+      CHECK_EQ(map2[scc2[s]], scc1[s]);
+      for (ArcIterator<VectorFst<Arc>> aiter(fst, s); !aiter.Done();
+           aiter.Next()) {
+        CHECK_LE(scc2[s], scc2[aiter.Value().nextstate]);
+      }
+    }
+    VectorFst<Arc> C1(fst);
+    VectorFst<Arc> C2(fst);
+    Connect(&C1);
+    ParallelConnect(&C2, 4);
+    CHECK(Equal(C1, C2));
+  }
+
   // Tests optimization operations
   void TestOptimize(const Fst<Arc> &T) {
     uint64 tprops = T.Properties(kFstProperties, true);
@@ -607,6 +870,38 @@ class WeightedTester {
       VectorFst<Arc> C1(T);
       Connect(&C1);
       CHECK(Equiv(T, C1));
+
+      VLOG(1) << "Check SCCs of a delayed FST, visited with its arc iterator,"
+              << " match those of its expansion.";
+      const ArcSortFst<Arc, ILabelCompare<Arc>> S(T, ILabelCompare<Arc>());
+      const VectorFst<Arc> E(S);
+      std::vector<StateId> scc1, scc2;
+      uint64 props1 = 0, props2 = 0;
+      SccVisitor<Arc> visitor1(&scc1, nullptr, nullptr, &props1);
+      SccVisitor<Arc> visitor2(&scc2, nullptr, nullptr, &props2);
+      DfsVisit(S, &visitor1, AnyArcFilter<Arc>());
+      DfsVisit(E, &visitor2, AnyArcFilter<Arc>());
+      CHECK(scc1 == scc2);
+      CHECK_EQ(props1, props2);
+
+      VLOG(1) << "Check multithreaded and serial SCCs and trimming agree.";
+      CheckParallelScc(E);
+      // Random arcs between nearby states give enough states and components
+      // that they are trimmed, searched and colored in parallel.
+      const StateId kNumSccStates = 10000;
+      VectorFst<Arc> G;
+      for (StateId s = 0; s < kNumSccStates; ++s) G.AddState();
+      G.SetStart(0);
+      for (StateId s = 0; s < kNumSccStates; ++s) {
+        if (rand() % 8 == 0) G.SetFinal(s, Weight::One());
+        for (int i = 0; i < 2; ++i) {
+          const StateId t = s + rand() % 11 - 5;
+          if (t >= 0 && t < kNumSccStates) {
+            G.AddArc(s, Arc(1, 1, Weight::One(), t));
+          }
+        }
+      }
+      CheckParallelScc(G);
     }
 
     if ((wprops & kSemiring) == kSemiring &&
@@ -621,6 +916,26 @@ class WeightedTester {
       RmEpsilonFst<Arc> R2(T);
       CHECK(Equiv(R1, R2));
 
+      VLOG(1) << "Check multithreaded and serial epsilon removal"
+              << " are equivalent.";
+      VectorFst<Arc> R3(T);
+      ParallelRmEpsilon(&R3, true, Weight::Zero(), kNoStateId, kDelta, 4);
+      CHECK(Equiv(R1, R3));
+
+      VLOG(1) << "Check delayed epsilon removal with and without"
+              << " memoized closures are equal.";
+      const VectorFst<Arc> R4(RmEpsilonFst<Arc>(T, RmEpsilonFstOptions()));
+      // With a zero 'gc_limit', the second copy expands the states again
+      // from the memoized closures, or recomputes those that were dropped.
+      for (const size_t limit : {size_t(1) << 20, size_t(64)}) {
+        RmEpsilonFst<Arc> R5(
+            T, RmEpsilonFstOptions(CacheOptions(true, 0), kDelta, limit));
+        const VectorFst<Arc> R6(R5);
+        const VectorFst<Arc> R7(R5);
+        CHECK(Equal(R4, R6));
+        CHECK(Equal(R4, R7));
+      }
+
       VLOG(1) << "Check an FST with a large proportion"
               << " of epsilon transitions:";
       // Maps all transitions of T to epsilon-transitions and append
@@ -647,6 +962,13 @@ class WeightedTester {
       ShortestDistance(U2, &d, true);
       Weight w2 = U2.Start() < d.size() ? d[U2.Start()] : Weight::Zero();
       CHECK(ApproxEqual(w, w2, kTestDelta));
+      // Unions enough copies that the closures are spread over threads.
+      VectorFst<Arc> U3(U);
+      for (int i = 0; i < 32; ++i) Union(&U3, U);
+      VectorFst<Arc> U4(U3);
+      RmEpsilon(&U3);
+      ParallelRmEpsilon(&U4, true, Weight::Zero(), kNoStateId, kDelta, 4);
+      CHECK(Equiv(U3, U4));
     }
 
     if ((wprops & kSemiring) == kSemiring && tprops & kAcyclic) {
@@ -776,6 +1098,10 @@ class WeightedTester {
         VectorFst<Arc> P3;
         Push<Arc, REWEIGHT_TO_FINAL>(T, &P3, kPushLabels | kPushWeights);
         CHECK(Equiv(T, P3));
+
+        VLOG(1) << "Check destructive and delayed pushing are equivalent.";
+        PushFst<Arc> P4(T, REWEIGHT_TO_FINAL);
+        CHECK(Equiv(P2, P4));
       }
 
       // Pushing towards the initial state.
@@ -790,6 +1116,10 @@ class WeightedTester {
         VectorFst<Arc> P3;
         Push<Arc, REWEIGHT_TO_INITIAL>(T, &P3, kPushLabels | kPushWeights);
         CHECK(Equiv(T, P3));
+
+        VLOG(1) << "Check destructive and delayed pushing are equivalent.";
+        PushFst<Arc> P4(T, REWEIGHT_TO_INITIAL);
+        CHECK(Equiv(P2, P4));
       }
     }
 
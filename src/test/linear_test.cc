@@ -0,0 +1,231 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Regression test for the linear FST extension.
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <fst/extensions/linear/linear-decoder.h>
+#include <fst/extensions/linear/linear-fst-data-builder.h>
+#include <fst/extensions/linear/linear-fst.h>
+#include <fst/extensions/linear/trie.h>
+#include <fst/compose.h>
+#include <fst/shortest-path.h>
+#include <fst/vector-fst.h>
+
+namespace fst {
+namespace {
+
+typedef StdArc::Label Label;
+typedef StdArc::StateId StateId;
+typedef StdArc::Weight Weight;
+
+typedef SortedTrieTopology<int, std::hash<int>> Topology;
+typedef MutableTrie<int, int, Topology> Trie;
+
+// Writes a trie with the given edges and node values in the format read by
+// MutableTrie<..., SortedTrieTopology>::Read().
+void WriteTrie(const std::vector<std::pair<ParentLabel<int>, int>> &edges,
+               const std::vector<int> &values, std::ostream &strm) {
+  const int64 n = edges.size();
+  strm.write(reinterpret_cast<const char *>(&n), sizeof(n));
+  for (const auto &edge : edges) WriteType(strm, edge);
+  WriteType(strm, values);
+}
+
+bool ReadTrie(const std::vector<std::pair<ParentLabel<int>, int>> &edges,
+              const std::vector<int> &values, Trie *trie) {
+  std::stringstream strm;
+  WriteTrie(edges, values, strm);
+  return static_cast<bool>(trie->Read(strm));
+}
+
+void TestTrieRead() {
+  typedef std::pair<ParentLabel<int>, int> Edge;
+  MutableTrie<int, int, NestedTrieTopology<int, std::hash<int>>> nested;
+  const int a = nested.Insert(nested.Root(), 1);
+  nested.Insert(a, 2);
+  nested.Insert(nested.Root(), 3);
+  for (size_t i = 0; i < nested.NumNodes(); ++i) nested[i] = 10 * i;
+  const Trie trie(nested);
+  std::stringstream strm;
+  trie.Write(strm);
+  Trie copy;
+  CHECK(copy.Read(strm));
+  CHECK(copy == trie);
+
+  // Parents and children must be nodes of the trie, and each node has a value.
+  CHECK(ReadTrie({Edge(ParentLabel<int>(0, 1), 1)}, {0, 1}, &copy));
+  CHECK(!ReadTrie({Edge(ParentLabel<int>(2, 1), 1)}, {0, 1}, &copy));
+  CHECK(!ReadTrie({Edge(ParentLabel<int>(-1, 1), 1)}, {0, 1}, &copy));
+  CHECK(!ReadTrie({Edge(ParentLabel<int>(0, 1), 2)}, {0, 1}, &copy));
+  CHECK(!ReadTrie({Edge(ParentLabel<int>(0, 1), 0)}, {0, 1}, &copy));
+  CHECK(!ReadTrie({Edge(ParentLabel<int>(0, 1), 1)}, {0}, &copy));
+  std::stringstream negative;
+  const int64 n = -1;
+  negative.write(reinterpret_cast<const char *>(&n), sizeof(n));
+  CHECK(!copy.Read(negative));
+}
+
+// Returns a weight in [0, 1) from rand().
+Weight RandomWeight() { return Weight(rand() / (RAND_MAX + 1.0)); }
+
+// Finds the best output of fst for words by composition and shortest path,
+// writing its non-epsilon output labels to olabels.
+Weight ComposeShortestPath(const Fst<StdArc> &fst,
+                           const std::vector<Label> &words,
+                           std::vector<Label> *olabels) {
+  VectorFst<StdArc> sentence;
+  StateId s = sentence.AddState();
+  sentence.SetStart(s);
+  for (const Label word : words) {
+    const StateId next = sentence.AddState();
+    sentence.AddArc(s, StdArc(word, word, Weight::One(), next));
+    s = next;
+  }
+  sentence.SetFinal(s, Weight::One());
+  VectorFst<StdArc> composed;
+  Compose(sentence, fst, &composed);
+  VectorFst<StdArc> best;
+  ShortestPath(composed, &best);
+  olabels->clear();
+  s = best.Start();
+  if (s == kNoStateId) return Weight::Zero();
+  Weight weight = Weight::One();
+  while (best.Final(s) == Weight::Zero()) {
+    ArcIterator<VectorFst<StdArc>> aiter(best, s);
+    const StdArc &arc = aiter.Value();
+    if (arc.olabel != 0) olabels->push_back(arc.olabel);
+    weight = Times(weight, arc.weight);
+    s = arc.nextstate;
+  }
+  return Times(weight, best.Final(s));
+}
+
+// Appends all sequences of the labels 1 to max_label of length at most
+// max_length.
+void AllSequences(Label max_label, size_t max_length,
+                  std::vector<std::vector<Label>> *sequences) {
+  std::vector<std::vector<Label>> last(1);
+  sequences->push_back(last[0]);
+  for (size_t length = 1; length <= max_length; ++length) {
+    std::vector<std::vector<Label>> next;
+    for (const auto &sequence : last) {
+      for (Label label = 1; label <= max_label; ++label) {
+        next.push_back(sequence);
+        next.back().push_back(label);
+        sequences->push_back(next.back());
+      }
+    }
+    last.swap(next);
+  }
+}
+
+const Label kNumWords = 3;
+const Label kNumTags = 3;
+
+void TestTaggerDecoder() {
+  LinearFstDataBuilder<StdArc> builder;
+  for (Label word = 1; word <= kNumWords; ++word) {
+    CHECK(builder.AddWord(word, {word, kNumWords + 1 + word % 2}));
+  }
+  // Word identity features (1 to kNumWords) and word parity features
+  // (kNumWords + 1 and kNumWords + 2) each have their own groups.
+  const int identity = builder.AddGroup(0);
+  const int bigram = builder.AddGroup(0);
+  const int future = builder.AddGroup(1);
+  for (Label tag = 1; tag <= kNumTags; ++tag) {
+    for (Label word = 1; word <= kNumWords; ++word) {
+      CHECK(builder.AddWeight(identity, {word}, {tag}, RandomWeight()));
+    }
+    for (Label parity = kNumWords + 1; parity <= kNumWords + 2; ++parity) {
+      for (Label next = kNumWords + 1; next <= kNumWords + 2; ++next) {
+        CHECK(builder.AddWeight(future, {parity, next}, {tag},
+                                RandomWeight()));
+        for (Label prev = 1; prev <= kNumTags; ++prev) {
+          CHECK(builder.AddWeight(bigram, {parity, next}, {prev, tag},
+                                  RandomWeight()));
+        }
+      }
+    }
+  }
+  LinearTaggerFst<StdArc> fst(builder.Dump());
+  CHECK(!fst.Properties(kError, false));
+  LinearTaggerDecoder<StdArc> decoder(fst);
+
+  std::vector<std::vector<Label>> sentences;
+  AllSequences(kNumWords, 4, &sentences);
+  for (const auto &words : sentences) {
+    std::vector<Label> tags, expected_tags;
+    const Weight weight = decoder.Decode(words, &tags);
+    const Weight expected = ComposeShortestPath(fst, words, &expected_tags);
+    CHECK(ApproxEqual(weight, expected));
+    if (expected != Weight::Zero()) CHECK(tags == expected_tags);
+  }
+  // Words out of range have no tagging; the FST cannot be composed with them.
+  std::vector<Label> tags;
+  CHECK_EQ(decoder.Decode({1, kNumWords + 1}, &tags), Weight::Zero());
+  CHECK(tags.empty());
+}
+
+void TestClassifierDecoder() {
+  LinearClassifierFstDataBuilder<StdArc> builder(kNumTags);
+  for (Label word = 1; word <= kNumWords; ++word) {
+    CHECK(builder.AddWord(word, {word, kNumWords + 1 + word % 2}));
+  }
+  const int identity = builder.AddGroup();
+  const int bigram = builder.AddGroup();
+  for (Label pred = 1; pred <= kNumTags; ++pred) {
+    for (Label word = 1; word <= kNumWords; ++word) {
+      CHECK(builder.AddWeight(identity, {word}, pred, RandomWeight()));
+    }
+    for (Label parity = kNumWords + 1; parity <= kNumWords + 2; ++parity) {
+      for (Label next = kNumWords + 1; next <= kNumWords + 2; ++next) {
+        CHECK(builder.AddWeight(bigram, {parity, next}, pred,
+                                RandomWeight()));
+      }
+    }
+  }
+  LinearClassifierFst<StdArc> fst(builder.Dump(), kNumTags);
+  CHECK(!fst.Properties(kError, false));
+  LinearClassifierDecoder<StdArc> decoder(fst);
+
+  std::vector<std::vector<Label>> sentences;
+  AllSequences(kNumWords, 4, &sentences);
+  for (const auto &words : sentences) {
+    Label pred;
+    std::vector<Label> expected_pred;
+    const Weight weight = decoder.Decode(words, &pred);
+    const Weight expected = ComposeShortestPath(fst, words, &expected_pred);
+    CHECK(ApproxEqual(weight, expected));
+    if (expected != Weight::Zero()) {
+      CHECK_EQ(expected_pred.size(), 1);
+      CHECK_EQ(pred, expected_pred[0]);
+    }
+  }
+  Label pred;
+  CHECK_EQ(decoder.Decode({1, kNumWords + 1}, &pred), Weight::Zero());
+  CHECK_EQ(pred, kNoLabel);
+}
+
+}  // namespace
+}  // namespace fst
+
+int main(int argc, char **argv) {
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(argv[0], &argc, &argv, true);
+  srand(1);
+
+  fst::TestTrieRead();
+  fst::TestTaggerDecoder();
+  fst::TestClassifierDecoder();
+
+  std::cout << "PASS" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,239 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Regression test for NGramFst.
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <fst/extensions/ngram/ngram-fst.h>
+#include <fst/equal.h>
+#include <fst/lexicographic-weight.h>
+#include <fst/vector-fst.h>
+
+namespace fst {
+namespace {
+
+typedef StdArc::Label Label;
+typedef StdArc::StateId StateId;
+typedef StdArc::Weight Weight;
+
+// A small backoff language model over the labels 1 to 3 in OpenGrm format:
+// state 0 is the unigram state, 1 and 2 the bigram states of labels 1 and 2,
+// 3 the start state and 4 the trigram state of labels 1 2. Backoff arcs are
+// labeled with epsilon.
+void MakeModel(VectorFst<StdArc> *fst) {
+  for (StateId s = 0; s < 5; ++s) fst->AddState();
+  fst->SetStart(3);
+  fst->AddArc(0, StdArc(1, 1, 1.0, 1));
+  fst->AddArc(0, StdArc(2, 2, 1.5, 2));
+  fst->AddArc(0, StdArc(3, 3, 2.5, 0));
+  fst->SetFinal(0, 2.0);
+  fst->AddArc(1, StdArc(0, 0, 0.5, 0));
+  fst->AddArc(1, StdArc(2, 2, 0.3, 4));
+  fst->SetFinal(1, 1.2);
+  fst->AddArc(2, StdArc(0, 0, 0.7, 0));
+  fst->AddArc(2, StdArc(1, 1, 0.4, 1));
+  fst->AddArc(2, StdArc(3, 3, 0.9, 0));
+  fst->AddArc(3, StdArc(0, 0, 0.2, 0));
+  fst->AddArc(3, StdArc(1, 1, 0.6, 1));
+  fst->AddArc(4, StdArc(0, 0, 0.25, 2));
+  fst->AddArc(4, StdArc(3, 3, 0.35, 0));
+  fst->SetFinal(4, 0.8);
+}
+
+// Scores labels from state s of the model by following its arcs, taking the
+// backoff arc whenever a label (or a final weight) is missing.
+Weight ScoreByBackoff(const Fst<StdArc> &fst, StateId s,
+                      const std::vector<Label> &labels, bool final) {
+  Weight total = Weight::One();
+  for (const Label label : labels) {
+    while (true) {
+      StateId backoff = kNoStateId;
+      Weight backoff_weight;
+      bool found = false;
+      for (ArcIterator<Fst<StdArc>> aiter(fst, s); !aiter.Done();
+           aiter.Next()) {
+        const StdArc &arc = aiter.Value();
+        if (arc.ilabel == label) {
+          total = Times(total, arc.weight);
+          s = arc.nextstate;
+          found = true;
+          break;
+        } else if (arc.ilabel == 0) {
+          backoff = arc.nextstate;
+          backoff_weight = arc.weight;
+        }
+      }
+      if (found) break;
+      if (backoff == kNoStateId) return Weight::Zero();
+      total = Times(total, backoff_weight);
+      s = backoff;
+    }
+  }
+  if (final) {
+    while (fst.Final(s) == Weight::Zero()) {
+      ArcIterator<Fst<StdArc>> aiter(fst, s);
+      total = Times(total, aiter.Value().weight);
+      s = aiter.Value().nextstate;
+    }
+    total = Times(total, fst.Final(s));
+  }
+  return total;
+}
+
+// Appends all label sequences over the labels 1 to max_label (and the
+// out-of-model label max_label + 1) of length at most max_length.
+void AllSequences(Label max_label, size_t max_length,
+                  std::vector<std::vector<Label>> *sequences) {
+  std::vector<std::vector<Label>> last(1);
+  sequences->push_back(last[0]);
+  for (size_t length = 1; length <= max_length; ++length) {
+    std::vector<std::vector<Label>> next;
+    for (const auto &sequence : last) {
+      for (Label label = 1; label <= max_label + 1; ++label) {
+        next.push_back(sequence);
+        next.back().push_back(label);
+        sequences->push_back(next.back());
+      }
+    }
+    last.swap(next);
+  }
+}
+
+void TestScoreSequence() {
+  VectorFst<StdArc> model;
+  MakeModel(&model);
+  std::vector<StateId> order;
+  NGramFst<StdArc> ngram(model, &order);
+  CHECK(!ngram.Properties(kError, false));
+
+  std::vector<std::vector<Label>> sequences;
+  AllSequences(3, 4, &sequences);
+  for (StateId s = 0; s < model.NumStates(); ++s) {
+    for (const auto &labels : sequences) {
+      for (const bool final : {false, true}) {
+        const Weight expected = ScoreByBackoff(model, s, labels, final);
+        StateId end_state;
+        std::vector<Weight> weights;
+        const Weight score = ngram.ScoreSequence(order[s], labels, final,
+                                                 &end_state, &weights);
+        CHECK(ApproxEqual(score, expected));
+        if (expected == Weight::Zero()) {
+          CHECK_EQ(end_state, kNoStateId);
+          continue;
+        }
+        CHECK_EQ(weights.size(), labels.size() + (final ? 1 : 0));
+        Weight product = Weight::One();
+        for (const auto &weight : weights) product = Times(product, weight);
+        CHECK(ApproxEqual(product, score));
+        // The state reached scores continuations as the model does.
+        if (!final) {
+          std::vector<Label> extended(labels);
+          extended.push_back(1);
+          extended.push_back(2);
+          CHECK(ApproxEqual(
+              Times(score, ngram.ScoreSequence(end_state, {1, 2}, true)),
+              ScoreByBackoff(model, s, extended, true)));
+        }
+      }
+    }
+  }
+
+  std::vector<Weight> scores;
+  ngram.ScoreSequences(sequences, true, &scores);
+  CHECK_EQ(scores.size(), sequences.size());
+  for (size_t i = 0; i < sequences.size(); ++i) {
+    CHECK(ApproxEqual(scores[i], ScoreByBackoff(model, model.Start(),
+                                                sequences[i], true)));
+  }
+}
+
+void TestQuantize() {
+  VectorFst<StdArc> model;
+  MakeModel(&model);
+  NGramFst<StdArc> ngram(model);
+  std::vector<std::vector<Label>> sequences;
+  AllSequences(3, 4, &sequences);
+  std::vector<Weight> scores;
+  ngram.ScoreSequences(sequences, true, &scores);
+  for (const int weight_bits : {8, 16}) {
+    // The model has fewer distinct weights than codebook entries, so the
+    // quantized model scores exactly as the original one.
+    NGramFst<StdArc> quantized(model, nullptr, weight_bits);
+    CHECK(!quantized.Properties(kError, false));
+    CHECK(Equal(quantized, ngram));
+    std::vector<Weight> quantized_scores;
+    quantized.ScoreSequences(sequences, true, &quantized_scores);
+    CHECK(quantized_scores == scores);
+
+    std::stringstream strm;
+    CHECK(quantized.Write(strm, FstWriteOptions("quantized")));
+    FstHeader hdr;
+    CHECK(hdr.Read(strm, "quantized"));
+    CHECK_EQ(hdr.Version(), 6);
+    strm.seekg(0);
+    std::unique_ptr<NGramFst<StdArc>> read(
+        NGramFst<StdArc>::Read(strm, FstReadOptions("quantized")));
+    CHECK(read);
+    CHECK(!read->Properties(kError, false));
+    CHECK(Equal(*read, quantized));
+    CHECK_EQ(read->StorageSize(), quantized.StorageSize());
+    std::vector<Weight> read_scores;
+    read->ScoreSequences(sequences, true, &read_scores);
+    CHECK(read_scores == scores);
+  }
+  FLAGS_fst_error_fatal = false;
+  NGramFst<StdArc> invalid(model, nullptr, 4);
+  CHECK(invalid.Properties(kError, false));
+  FLAGS_fst_error_fatal = true;
+}
+
+// Weights without a real value can be stored but not quantized.
+void TestLexicographic() {
+  typedef LexicographicArc<TropicalWeight, TropicalWeight> LexArc;
+  VectorFst<StdArc> model;
+  MakeModel(&model);
+  VectorFst<LexArc> lex_model;
+  for (StateId s = 0; s < model.NumStates(); ++s) lex_model.AddState();
+  lex_model.SetStart(model.Start());
+  for (StateId s = 0; s < model.NumStates(); ++s) {
+    lex_model.SetFinal(s, LexArc::Weight(model.Final(s), Weight::One()));
+    for (ArcIterator<VectorFst<StdArc>> aiter(model, s); !aiter.Done();
+         aiter.Next()) {
+      const StdArc &arc = aiter.Value();
+      lex_model.AddArc(s, LexArc(arc.ilabel, arc.olabel,
+                                 LexArc::Weight(arc.weight, Weight::One()),
+                                 arc.nextstate));
+    }
+  }
+  NGramFst<LexArc> lex_ngram(lex_model);
+  CHECK(!lex_ngram.Properties(kError, false));
+  CHECK_EQ(lex_ngram.NumStates(), model.NumStates());
+  CHECK(ApproxEqual(lex_ngram.ScoreSequence(lex_ngram.Start(), {1, 2}, true)
+                        .Value1(),
+                    ScoreByBackoff(model, model.Start(), {1, 2}, true)));
+  FLAGS_fst_error_fatal = false;
+  NGramFst<LexArc> quantized(lex_model, nullptr, 8);
+  CHECK(quantized.Properties(kError, false));
+  FLAGS_fst_error_fatal = true;
+}
+
+}  // namespace
+}  // namespace fst
+
+int main(int argc, char **argv) {
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(argv[0], &argc, &argv, true);
+
+  fst::TestScoreSequence();
+  fst::TestQuantize();
+  fst::TestLexicographic();
+
+  std::cout << "PASS" << std::endl;
+
+  return 0;
+}
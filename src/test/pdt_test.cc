@@ -0,0 +1,167 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Regression test for the PDT extension.
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fst/extensions/pdt/expand.h>
+#include <fst/extensions/pdt/paren-index.h>
+#include <fst/extensions/pdt/shortest-path.h>
+#include <fst/equal.h>
+#include <fst/queue.h>
+#include <fst/vector-fst.h>
+
+namespace fst {
+namespace {
+
+typedef StdArc::Label Label;
+typedef StdArc::StateId StateId;
+typedef StdArc::Weight Weight;
+typedef FifoQueue<StateId> Queue;
+
+const Label kOpen = 10;
+const Label kClose = 11;
+
+// A PDT with a direct path of weight 3.0, a parenthesized path of weight 1.6
+// and a path with nested parentheses of weight 1.5.
+void MakePdt(VectorFst<StdArc> *fst) {
+  for (StateId s = 0; s < 9; ++s) fst->AddState();
+  fst->SetStart(0);
+  fst->AddArc(0, StdArc(1, 1, 3.0, 5));
+  fst->AddArc(0, StdArc(kOpen, kOpen, 0.5, 1));
+  fst->AddArc(1, StdArc(2, 2, 1.0, 2));
+  fst->AddArc(1, StdArc(3, 3, 0.4, 3));
+  fst->AddArc(2, StdArc(kClose, kClose, Weight::One(), 4));
+  fst->AddArc(3, StdArc(kOpen, kOpen, 0.1, 6));
+  fst->AddArc(6, StdArc(4, 4, 0.3, 7));
+  fst->AddArc(7, StdArc(kClose, kClose, Weight::One(), 8));
+  fst->AddArc(8, StdArc(kClose, kClose, 0.1, 4));
+  fst->AddArc(4, StdArc(5, 5, 0.1, 5));
+  fst->SetFinal(5, Weight::One());
+}
+
+// Returns the weight of the single path of fst, or Zero() if it has none.
+Weight PathWeight(const Fst<StdArc> &fst) {
+  StateId s = fst.Start();
+  if (s == kNoStateId) return Weight::Zero();
+  Weight weight = Weight::One();
+  while (fst.Final(s) == Weight::Zero()) {
+    ArcIterator<Fst<StdArc>> aiter(fst, s);
+    weight = Times(weight, aiter.Value().weight);
+    s = aiter.Value().nextstate;
+  }
+  return Times(weight, fst.Final(s));
+}
+
+// Compares the pruned search against the unpruned one: the estimates are
+// used only to prune, so with estimates that do not exceed the distances to
+// the final states nothing on the best path is pruned.
+void TestPrunedShortestPath() {
+  VectorFst<StdArc> pdt;
+  MakePdt(&pdt);
+  const std::vector<std::pair<Label, Label>> parens = {{kOpen, kClose}};
+
+  VectorFst<StdArc> unpruned;
+  ShortestPath(pdt, parens, &unpruned);
+  CHECK(ApproxEqual(PathWeight(unpruned), Weight(1.5)));
+
+  // Exact distances from each state to the final state, then a lower bound.
+  const std::vector<Weight> distances = {1.5, 1.0, 0.1, 0.6, 0.1,
+                                         0.0, 0.5, 0.2, 0.2};
+  const std::vector<Weight> lower_bounds(distances.size(), Weight::One());
+  for (const auto *estimates : {&distances, &lower_bounds}) {
+    for (const Weight &threshold : {Weight::One(), Weight(1.0)}) {
+      PdtShortestPathOptions<StdArc, Queue> opts(false, true, threshold,
+                                                 kNoStateId, estimates);
+      VectorFst<StdArc> pruned;
+      ShortestPath(pdt, parens, &pruned, opts);
+      CHECK(Equal(pruned, unpruned));
+    }
+  }
+
+  // An estimate exceeding the distance of the final state prunes the best
+  // path once the direct path has been found.
+  std::vector<Weight> overestimates(distances);
+  overestimates[5] = 10.0;
+  PdtShortestPathOptions<StdArc, Queue> inadmissible_opts(
+      false, true, Weight::One(), kNoStateId, &overestimates);
+  VectorFst<StdArc> inadmissible;
+  ShortestPath(pdt, parens, &inadmissible, inadmissible_opts);
+  CHECK(ApproxEqual(PathWeight(inadmissible), Weight(3.0)));
+
+  // A generous state threshold does not change the result either.
+  PdtShortestPathOptions<StdArc, Queue> opts(false, true, Weight::Zero(),
+                                             100);
+  VectorFst<StdArc> pruned;
+  ShortestPath(pdt, parens, &pruned, opts);
+  CHECK(Equal(pruned, unpruned));
+}
+
+void TestParenIndex() {
+  VectorFst<StdArc> pdt;
+  MakePdt(&pdt);
+  const std::vector<std::pair<Label, Label>> parens = {{kOpen, kClose}};
+  PdtParenIndex<StdArc> index(pdt, parens);
+  CHECK(!index.Error());
+  CHECK(index.Matches(pdt, parens));
+  std::stringstream strm;
+  CHECK(index.Write(strm, "index"));
+  const string data = strm.str();
+  std::unique_ptr<PdtParenIndex<StdArc>> read(
+      PdtParenIndex<StdArc>::Read(strm, "index"));
+  CHECK(read);
+  CHECK(read->Matches(pdt, parens));
+
+  // The pruned expansion is the same with the index read.
+  for (const Weight &threshold : {Weight(0.05), Weight(1.0), Weight(2.0)}) {
+    VectorFst<StdArc> expanded, indexed;
+    Expand(pdt, parens, &expanded,
+           PdtExpandOptions<StdArc>(true, false, threshold));
+    Expand(pdt, parens, &indexed,
+           PdtExpandOptions<StdArc>(true, false, threshold, read.get()));
+    CHECK(!indexed.Properties(kError, false));
+    CHECK(Equal(expanded, indexed));
+  }
+
+  // The index does not match a different PDT or parentheses.
+  VectorFst<StdArc> other(pdt);
+  other.SetFinal(5, 1.0);
+  CHECK(!read->Matches(other, parens));
+  CHECK(!read->Matches(pdt, {{kOpen, kClose}, {20, 21}}));
+  FLAGS_fst_error_fatal = false;
+  VectorFst<StdArc> failed;
+  Expand(other, parens, &failed,
+         PdtExpandOptions<StdArc>(true, false, 1.0, read.get()));
+  CHECK(failed.Properties(kError, false));
+  FLAGS_fst_error_fatal = true;
+
+  // An index with states out of range is not read.
+  string corrupt = data;
+  const int64 num_states = 2;
+  corrupt.replace(sizeof(int32), sizeof(num_states),
+                  reinterpret_cast<const char *>(&num_states),
+                  sizeof(num_states));
+  std::istringstream corrupt_strm(corrupt);
+  CHECK(!PdtParenIndex<StdArc>::Read(corrupt_strm, "corrupt"));
+}
+
+}  // namespace
+}  // namespace fst
+
+int main(int argc, char **argv) {
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(argv[0], &argc, &argv, true);
+
+  fst::TestPrunedShortestPath();
+  fst::TestParenIndex();
+
+  std::cout << "PASS" << std::endl;
+
+  return 0;
+}